@@ -0,0 +1,285 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Inverted file of the KeyFrameDatabase: std::list postings (as before) against KeyFramePostings.
+// Both sides run the maintenance of KeyFrameDatabase::add/erase and the word counting pass of
+// DetectBestCandidates over synthetic keyframes, without vocabulary or images.
+//
+// Usage: ./bench_keyframe_database [words_per_kf] [num_kfs ...]
+// Defaults: 300 words per keyframe, 1000 10000 100000 keyframes.
+
+#include<iostream>
+#include<iomanip>
+#include<chrono>
+#include<list>
+#include<memory>
+#include<random>
+#include<vector>
+#include<algorithm>
+#include<cstdlib>
+#include<cmath>
+
+#include"KeyFramePostings.h"
+
+using namespace std;
+using ORB_SLAM3::KeyFrame;
+using ORB_SLAM3::KeyFramePostings;
+
+namespace
+{
+
+const unsigned int VOCABULARY_SIZE = 1000000;
+const int NUM_QUERIES = 50;
+// Erased keyframes: 10% of them, at most 1000, the list erase scans whole postings
+const double ERASED_RATIO = 0.1;
+const int MAX_ERASED = 1000;
+
+// Stands for a KeyFrame in the postings, holds the fields the queries touch
+struct BenchKeyFrame
+{
+    vector<unsigned int> vWords;
+    unsigned long nQuery;
+    int nWords;
+};
+
+inline KeyFrame* AsKF(BenchKeyFrame* p) { return reinterpret_cast<KeyFrame*>(p); }
+inline BenchKeyFrame* AsBench(KeyFrame* p) { return reinterpret_cast<BenchKeyFrame*>(p); }
+
+class ListInvertedFile
+{
+public:
+    ListInvertedFile(): mvlInvertedFile(VOCABULARY_SIZE) {}
+
+    void add(BenchKeyFrame* pKF)
+    {
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+            mvlInvertedFile[pKF->vWords[i]].push_back(AsKF(pKF));
+    }
+
+    void erase(BenchKeyFrame* pKF)
+    {
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+        {
+            list<KeyFrame*> &lKFs = mvlInvertedFile[pKF->vWords[i]];
+            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend=lKFs.end(); lit!=lend; lit++)
+            {
+                if(*lit==AsKF(pKF))
+                {
+                    lKFs.erase(lit);
+                    break;
+                }
+            }
+        }
+    }
+
+    size_t query(const BenchKeyFrame* pKF, const unsigned long nQueryId)
+    {
+        size_t nSharing = 0;
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+        {
+            const list<KeyFrame*> &lKFs = mvlInvertedFile[pKF->vWords[i]];
+            for(list<KeyFrame*>::const_iterator lit=lKFs.begin(), lend=lKFs.end(); lit!=lend; lit++)
+            {
+                BenchKeyFrame* pKFi = AsBench(*lit);
+                if(pKFi->nQuery!=nQueryId)
+                {
+                    pKFi->nWords = 0;
+                    pKFi->nQuery = nQueryId;
+                    nSharing++;
+                }
+                pKFi->nWords++;
+            }
+        }
+        return nSharing;
+    }
+
+private:
+    vector<list<KeyFrame*> > mvlInvertedFile;
+};
+
+class PostingsInvertedFile
+{
+public:
+    PostingsInvertedFile(): mvInvertedFile(VOCABULARY_SIZE) {}
+
+    void add(BenchKeyFrame* pKF)
+    {
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+        {
+            const unsigned int w = pKF->vWords[i];
+            KeyFramePostings* pPostings = mvInvertedFile[w].get();
+            if(pPostings && pPostings->Append(AsKF(pKF)))
+                continue;
+
+            shared_ptr<KeyFramePostings> pGrown(pPostings ? pPostings->Compacted(1) : new KeyFramePostings(8));
+            pGrown->Append(AsKF(pKF));
+            atomic_store(&mvInvertedFile[w],pGrown);
+        }
+    }
+
+    void erase(BenchKeyFrame* pKF)
+    {
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+        {
+            const unsigned int w = pKF->vWords[i];
+            KeyFramePostings* pPostings = mvInvertedFile[w].get();
+            if(!pPostings || !pPostings->Erase(AsKF(pKF)))
+                continue;
+
+            if(pPostings->NeedsCompaction())
+                atomic_store(&mvInvertedFile[w],shared_ptr<KeyFramePostings>(pPostings->Compacted(0)));
+        }
+    }
+
+    size_t query(const BenchKeyFrame* pKF, const unsigned long nQueryId)
+    {
+        size_t nSharing = 0;
+        for(size_t i=0; i<pKF->vWords.size(); i++)
+        {
+            shared_ptr<KeyFramePostings> pPostings = atomic_load(&mvInvertedFile[pKF->vWords[i]]);
+            if(!pPostings)
+                continue;
+
+            for(size_t j=0, jend=pPostings->Size(); j<jend; j++)
+            {
+                KeyFrame* pKFj = pPostings->At(j);
+                if(!pKFj)
+                    continue;
+                BenchKeyFrame* pKFi = AsBench(pKFj);
+                if(pKFi->nQuery!=nQueryId)
+                {
+                    pKFi->nWords = 0;
+                    pKFi->nQuery = nQueryId;
+                    nSharing++;
+                }
+                pKFi->nWords++;
+            }
+        }
+        return nSharing;
+    }
+
+private:
+    vector<shared_ptr<KeyFramePostings> > mvInvertedFile;
+};
+
+// Words of a keyframe, skewed towards a small part of the vocabulary as real images are
+void CreateKeyFrames(const int nKFs, const int nWordsPerKF, vector<BenchKeyFrame> &vKFs)
+{
+    mt19937 rng(42);
+    // Log-uniform word rank: frequent words are shared by many keyframes, most words by few
+    uniform_real_distribution<double> logRank(0.0,log((double)VOCABULARY_SIZE));
+
+    vKFs.resize(nKFs);
+    for(int i=0; i<nKFs; i++)
+    {
+        vector<unsigned int> &vWords = vKFs[i].vWords;
+        vWords.reserve(nWordsPerKF);
+        while((int)vWords.size()<nWordsPerKF)
+        {
+            const unsigned int w = min<unsigned int>(VOCABULARY_SIZE-1,exp(logRank(rng)));
+            if(find(vWords.begin(),vWords.end(),w)==vWords.end())
+                vWords.push_back(w);
+        }
+        sort(vWords.begin(),vWords.end());
+        vKFs[i].nQuery = 0;
+        vKFs[i].nWords = 0;
+    }
+}
+
+double ElapsedMs(const chrono::steady_clock::time_point &t0)
+{
+    return chrono::duration_cast<chrono::duration<double,milli> >(chrono::steady_clock::now()-t0).count();
+}
+
+template<class InvertedFile>
+void Run(const char* name, vector<BenchKeyFrame> &vKFs, const vector<int> &vErased, const vector<int> &vQueries)
+{
+    InvertedFile* pFile = new InvertedFile();
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for(size_t i=0; i<vKFs.size(); i++)
+        pFile->add(&vKFs[i]);
+    const double tAdd = ElapsedMs(t0);
+
+    t0 = chrono::steady_clock::now();
+    for(size_t i=0; i<vErased.size(); i++)
+        pFile->erase(&vKFs[vErased[i]]);
+    const double tErase = ElapsedMs(t0);
+
+    for(size_t i=0; i<vKFs.size(); i++)
+        vKFs[i].nQuery = 0;
+
+    size_t nSharing = 0;
+    t0 = chrono::steady_clock::now();
+    for(size_t i=0; i<vQueries.size(); i++)
+        nSharing += pFile->query(&vKFs[vQueries[i]],i+1);
+    const double tQuery = ElapsedMs(t0);
+
+    cout << "  " << left << setw(9) << name << right << fixed << setprecision(3)
+         << " add " << setw(9) << 1000.0*tAdd/vKFs.size() << " us/KF"
+         << "   erase " << setw(9) << (vErased.empty() ? 0.0 : 1000.0*tErase/vErased.size()) << " us/KF"
+         << "   query " << setw(9) << tQuery/vQueries.size() << " ms"
+         << "   (" << nSharing/vQueries.size() << " KFs sharing words)" << endl;
+
+    delete pFile;
+}
+
+} //namespace
+
+int main(int argc, char **argv)
+{
+    int nWordsPerKF = 300;
+    vector<int> vnKFs;
+    if(argc>1)
+        nWordsPerKF = atoi(argv[1]);
+    for(int i=2; i<argc; i++)
+        vnKFs.push_back(atoi(argv[i]));
+    if(vnKFs.empty())
+    {
+        vnKFs.push_back(1000);
+        vnKFs.push_back(10000);
+        vnKFs.push_back(100000);
+    }
+
+    cout << "Inverted file benchmark: " << nWordsPerKF << " words per keyframe, vocabulary of " << VOCABULARY_SIZE
+         << " words, " << 100*ERASED_RATIO << "% of the keyframes erased (at most " << MAX_ERASED << "), "
+         << NUM_QUERIES << " queries" << endl;
+
+    for(size_t n=0; n<vnKFs.size(); n++)
+    {
+        const int nKFs = vnKFs[n];
+        vector<BenchKeyFrame> vKFs;
+        CreateKeyFrames(nKFs,nWordsPerKF,vKFs);
+
+        mt19937 rng(7);
+        vector<int> vOrder(nKFs);
+        for(int i=0; i<nKFs; i++)
+            vOrder[i] = i;
+        shuffle(vOrder.begin(),vOrder.end(),rng);
+        const vector<int> vErased(vOrder.begin(),vOrder.begin()+min(MAX_ERASED,(int)(ERASED_RATIO*nKFs)));
+        vector<int> vQueries;
+        for(int i=0; i<NUM_QUERIES; i++)
+            vQueries.push_back(vOrder[vErased.size()+i%(nKFs-vErased.size())]);
+
+        cout << nKFs << " keyframes" << endl;
+        Run<ListInvertedFile>("list",vKFs,vErased,vQueries);
+        Run<PostingsInvertedFile>("postings",vKFs,vErased,vQueries);
+    }
+
+    return 0;
+}
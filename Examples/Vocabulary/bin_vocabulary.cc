@@ -0,0 +1,66 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include<iostream>
+#include<chrono>
+
+#include"ORBVocabulary.h"
+
+using namespace std;
+
+// Converts the text vocabulary (ORBvoc.txt) into the binary format that System memory-maps
+// when the vocabulary path ends in .bin
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        cerr << endl << "Usage: ./bin_vocabulary path_to_vocabulary.txt path_to_vocabulary.bin" << endl;
+        return 1;
+    }
+
+    ORB_SLAM3::ORBVocabulary voc;
+
+    cout << "Loading text vocabulary " << argv[1] << " ..." << endl;
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    if(!voc.loadFromTextFile(argv[1]))
+    {
+        cerr << "Failed to open at: " << argv[1] << endl;
+        return 1;
+    }
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    cout << "Loaded " << voc.size() << " words in " << chrono::duration_cast<chrono::duration<double> >(t1 - t0).count() << " s" << endl;
+
+    if(!voc.saveToBinaryFile(argv[2]))
+    {
+        cerr << "Failed to write: " << argv[2] << endl;
+        return 1;
+    }
+
+    // Check that the written file maps back
+    ORB_SLAM3::ORBVocabulary vocBin;
+    t0 = chrono::steady_clock::now();
+    if(!vocBin.loadFromBinaryFile(argv[2]) || vocBin.size() != voc.size())
+    {
+        cerr << "The binary vocabulary could not be loaded back" << endl;
+        return 1;
+    }
+    t1 = chrono::steady_clock::now();
+    cout << "Saved " << argv[2] << ", it loads in " << chrono::duration_cast<chrono::duration<double> >(t1 - t0).count() << " s" << endl;
+
+    return 0;
+}
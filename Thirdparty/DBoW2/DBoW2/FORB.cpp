@@ -14,6 +14,9 @@
 #include <string>
 #include <sstream>
 #include <stdint-gcc.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "FORB.h"
 
@@ -80,12 +83,19 @@ void FORB::meanValue(const std::vector<FORB::pDescriptor> &descriptors,
   
 int FORB::distance(const FORB::TDescriptor &a,
   const FORB::TDescriptor &b)
+{
+  return distance(a.ptr<unsigned char>(), b.ptr<unsigned char>());
+}
+
+// --------------------------------------------------------------------------
+
+int FORB::distance(const unsigned char *a, const unsigned char *b)
 {
   // Bit set count operation from
   // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
 
-  const int *pa = a.ptr<int32_t>();
-  const int *pb = b.ptr<int32_t>();
+  const int *pa = reinterpret_cast<const int32_t*>(a);
+  const int *pb = reinterpret_cast<const int32_t*>(b);
 
   int dist=0;
 
@@ -100,6 +110,79 @@ int FORB::distance(const FORB::TDescriptor &a,
   return dist;
 }
 
+// --------------------------------------------------------------------------
+
+#ifdef __AVX2__
+
+// Bit count of the 32 bytes of a ^ b, as four 64-bit partial sums
+static inline __m256i popcount256(const __m256i &a, const unsigned char *b)
+{
+  const __m256i lookup = _mm256_setr_epi8(
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+  const __m256i v = _mm256_xor_si256(a,
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+  const __m256i cnt = _mm256_add_epi8(
+    _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask)),
+    _mm256_shuffle_epi8(lookup,
+      _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask)));
+  return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+#endif
+
+void FORB::distances(const unsigned char *a, const unsigned char *b,
+  int n, int *d)
+{
+  int i = 0;
+
+#ifdef __AVX2__
+  // the 32 bytes of a descriptor fill one register; four descriptors are
+  // counted together and their partial sums reduced at once
+  const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+
+  for(; i + 4 <= n; i += 4, b += 4*32)
+  {
+    const __m256i s0 = popcount256(va, b);
+    const __m256i s1 = popcount256(va, b + 32);
+    const __m256i s2 = popcount256(va, b + 64);
+    const __m256i s3 = popcount256(va, b + 96);
+
+    // 64-bit lanes: (s0, s1) and (s2, s3) for each 128-bit half
+    const __m256i s01 = _mm256_add_epi64(_mm256_unpacklo_epi64(s0, s1),
+      _mm256_unpackhi_epi64(s0, s1));
+    const __m256i s23 = _mm256_add_epi64(_mm256_unpacklo_epi64(s2, s3),
+      _mm256_unpackhi_epi64(s2, s3));
+    // 32-bit lanes: (s0, s2, s1, s3) for each half, then add the halves
+    const __m256i s = _mm256_or_si256(s01, _mm256_slli_epi64(s23, 32));
+    const __m128i r = _mm_add_epi32(_mm256_castsi256_si128(s),
+      _mm256_extracti128_si256(s, 1));
+
+    d[i]   = _mm_cvtsi128_si32(r);
+    d[i+1] = _mm_extract_epi32(r, 2);
+    d[i+2] = _mm_extract_epi32(r, 1);
+    d[i+3] = _mm_extract_epi32(r, 3);
+  }
+#endif
+
+#ifdef __POPCNT__
+  const uint64_t *pa = reinterpret_cast<const uint64_t*>(a);
+  for(; i < n; ++i, b += 32)
+  {
+    const uint64_t *pb = reinterpret_cast<const uint64_t*>(b);
+    d[i] = __builtin_popcountll(pa[0] ^ pb[0]) +
+      __builtin_popcountll(pa[1] ^ pb[1]) +
+      __builtin_popcountll(pa[2] ^ pb[2]) +
+      __builtin_popcountll(pa[3] ^ pb[3]);
+  }
+#else
+  for(; i < n; ++i, b += 32)
+    d[i] = distance(a, b);
+#endif
+}
+
 // --------------------------------------------------------------------------
   
 std::string FORB::toString(const FORB::TDescriptor &a)
@@ -136,6 +219,14 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::fromData(FORB::TDescriptor &a, const unsigned char *p)
+{
+  a.create(1, FORB::L, CV_8U);
+  std::copy(p, p+FORB::L, a.ptr<unsigned char>());
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
@@ -46,6 +46,42 @@ public:
    */
   static int distance(const TDescriptor &a, const TDescriptor &b);
 
+  /**
+   * Calculates the distance between two descriptors stored as L raw bytes
+   * @param a
+   * @param b
+   * @return distance
+   */
+  static int distance(const unsigned char *a, const unsigned char *b);
+
+  /**
+   * Calculates the distances between a descriptor and n descriptors stored
+   * back to back, L raw bytes each
+   * @param a
+   * @param b first byte of the n descriptors
+   * @param n
+   * @param d (out) n distances
+   */
+  static void distances(const unsigned char *a, const unsigned char *b,
+    int n, int *d);
+
+  /**
+   * Returns the L raw bytes of a descriptor
+   * @param a descriptor
+   * @return pointer to the first byte
+   */
+  static const unsigned char* data(const TDescriptor &a)
+  {
+    return a.ptr<unsigned char>();
+  }
+
+  /**
+   * Returns a descriptor from its L raw bytes
+   * @param a (out) descriptor
+   * @param p bytes
+   */
+  static void fromData(TDescriptor &a, const unsigned char *p);
+
   /**
    * Returns a string version of the descriptor
    * @param a descriptor
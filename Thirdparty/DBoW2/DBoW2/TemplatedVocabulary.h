@@ -3,6 +3,9 @@
  * Added functions: Save and Load from text files without using cv::FileStorage.
  * Date: August 2015
  * Raúl Mur-Artal
+ *
+ * Added a flat, memory-mappable layout of the tree used by transform,
+ * with save and load to binary files.
  */
 
 /**
@@ -26,6 +29,13 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -145,6 +155,19 @@ public:
   virtual void transform(const std::vector<TDescriptor>& features,
     BowVector &v, FeatureVector &fv, int levelsup) const;
 
+  /**
+   * Transform a set of descriptors stored back to back, F::L bytes each
+   * (e.g. the rows of a continuous descriptor matrix), into a bow vector and
+   * a feature vector
+   * @param features first byte of the n descriptors
+   * @param n
+   * @param v (out) bow vector
+   * @param fv (out) feature vector of nodes and feature indexes
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   */
+  virtual void transform(const unsigned char *features, int n,
+    BowVector &v, FeatureVector &fv, int levelsup) const;
+
   /**
    * Transforms a single feature into a word (without weight)
    * @param feature
@@ -246,6 +269,26 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The file is memory-mapped read-only and used in place, so loading takes
+   * constant time and processes loading the same file share its pages.
+   * The tree nodes are not rebuilt: only the query functions (transform,
+   * score, get*) are available, create, stopWords and the other save
+   * functions need a vocabulary loaded from a text or YAML file
+   * @param filename
+   * @return false if the file could not be mapped or is not a vocabulary
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file for loadFromBinaryFile.
+   * The data is written in the byte order of this machine
+   * @param filename
+   * @return false if the file could not be written
+   */
+  bool saveToBinaryFile(const std::string &filename) const;
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -328,6 +371,44 @@ protected:
     inline bool isLeaf() const { return children.empty(); }
   };
 
+  /**
+   * Layout of the flattened tree, shared by the in-memory copy and the
+   * binary files. Offsets are in bytes from the start of the header and
+   * every array starts at a multiple of 64 bytes. Node ids are those of
+   * m_nodes, the children of a node are consecutive in the children array
+   * and their descriptors are consecutive too, so choosing a child reads one
+   * contiguous block.
+   */
+  struct FlatHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t descriptor_bytes;
+    int32_t k;
+    int32_t L;
+    int32_t scoring;
+    int32_t weighting;
+    uint32_t num_nodes;
+    uint32_t num_words;
+    /// num_nodes+1 uint32: children of node i in [child_starts[i], child_starts[i+1])
+    uint64_t child_starts;
+    /// num_nodes-1 uint32 node ids
+    uint64_t children;
+    /// num_nodes uint32 node ids, 0 for the root
+    uint64_t parents;
+    /// num_nodes uint32 word ids, only valid for the leaves
+    uint64_t node_words;
+    /// num_words uint32 node ids
+    uint64_t word_nodes;
+    /// num_nodes WordValue
+    uint64_t weights;
+    /// num_nodes descriptors of descriptor_bytes: row j+1 is the descriptor
+    /// of children[j], row 0 (the root) is unused
+    uint64_t descriptors;
+    /// Total size of the header and the arrays
+    uint64_t size;
+  };
+
 protected:
 
   /**
@@ -335,6 +416,24 @@ protected:
    */
   void createScoringObject();
 
+  /**
+   * Builds the flat tree from m_nodes, into memory owned by the vocabulary
+   */
+  void buildFlatTree();
+
+  /**
+   * Points the flat tree arrays to an image in memory, after validating it
+   * @param image header followed by the arrays
+   * @param size bytes available at image
+   * @return false if the image is not a valid vocabulary for F
+   */
+  bool attachFlatTree(const unsigned char *image, size_t size);
+
+  /**
+   * Drops the flat tree, unmapping the binary file if there is one
+   */
+  void releaseFlatTree();
+
   /** 
    * Returns a set of pointers to descriptores
    * @param training_features all the features
@@ -361,6 +460,19 @@ protected:
    * @param id (out) word id
    */
   virtual void transform(const TDescriptor &feature, WordId &id) const;
+
+  /**
+   * Returns the word ids associated to a set of features. All the features
+   * go down one level of the tree before any goes further
+   * @param features n descriptors stored back to back, F::L bytes each
+   * @param n
+   * @param ids (out) n word ids
+   * @param weights (out) n word weights
+   * @param nids (out) if given, n ids of the nodes "levelsup" levels up
+   * @param levelsup
+   */
+  void transformPacked(const unsigned char *features, int n, WordId *ids,
+    WordValue *weights, NodeId *nids, int levelsup) const;
       
   /**
    * Creates a level in the tree, under the parent, by running kmeans with
@@ -425,6 +537,23 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Flat tree used by transform. m_nodes is empty if it was memory-mapped
+  const FlatHeader *m_flat;
+  const uint32_t *m_child_starts;
+  const uint32_t *m_children;
+  const uint32_t *m_parents;
+  const uint32_t *m_node_words;
+  const uint32_t *m_word_nodes;
+  const WordValue *m_weights;
+  const unsigned char *m_descriptors;
+
+  /// Memory of the flat tree when it is built from m_nodes
+  std::vector<uint64_t> m_flat_storage;
+
+  /// Mapped binary file, NULL if the flat tree is built from m_nodes
+  void *m_mapped;
+  size_t m_mapped_size;
   
 };
 
@@ -434,7 +563,10 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
   : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
+  m_scoring_object(NULL), m_flat(NULL),
+  m_child_starts(NULL), m_children(NULL), m_parents(NULL), m_node_words(NULL),
+  m_word_nodes(NULL), m_weights(NULL), m_descriptors(NULL),
+  m_mapped(NULL), m_mapped_size(0)
 {
   createScoringObject();
 }
@@ -443,7 +575,10 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
+  (const std::string &filename): m_scoring_object(NULL), m_flat(NULL),
+  m_child_starts(NULL), m_children(NULL), m_parents(NULL), m_node_words(NULL),
+  m_word_nodes(NULL), m_weights(NULL), m_descriptors(NULL),
+  m_mapped(NULL), m_mapped_size(0)
 {
   load(filename);
 }
@@ -452,7 +587,10 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
+  (const char *filename): m_scoring_object(NULL), m_flat(NULL),
+  m_child_starts(NULL), m_children(NULL), m_parents(NULL), m_node_words(NULL),
+  m_word_nodes(NULL), m_weights(NULL), m_descriptors(NULL),
+  m_mapped(NULL), m_mapped_size(0)
 {
   load(filename);
 }
@@ -516,7 +654,10 @@ void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
   const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+  : m_scoring_object(NULL), m_flat(NULL),
+  m_child_starts(NULL), m_children(NULL), m_parents(NULL), m_node_words(NULL),
+  m_word_nodes(NULL), m_weights(NULL), m_descriptors(NULL),
+  m_mapped(NULL), m_mapped_size(0)
 {
   *this = voc;
 }
@@ -527,6 +668,7 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
 {
   delete m_scoring_object;
+  releaseFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -545,9 +687,21 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   
   this->m_nodes.clear();
   this->m_words.clear();
+  this->releaseFlatTree();
   
   this->m_nodes = voc.m_nodes;
   this->createWords();
+
+  if(!this->m_nodes.empty())
+    this->buildFlatTree();
+  else if(voc.m_flat)
+  {
+    // copy a mapped vocabulary into owned memory
+    this->m_flat_storage.resize((voc.m_flat->size + 7) / 8);
+    memcpy(&this->m_flat_storage[0], voc.m_flat, voc.m_flat->size);
+    this->attachFlatTree((const unsigned char*)&this->m_flat_storage[0],
+      voc.m_flat->size);
+  }
   
   return *this;
 }
@@ -560,6 +714,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  releaseFlatTree();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -580,9 +735,11 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 
   // create the words
   createWords();
+  buildFlatTree();
 
   // and set the weight of each node of the tree
   setNodeWeights(training_features);
+  buildFlatTree();
   
 }
 
@@ -1000,7 +1157,7 @@ void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
 template<class TDescriptor, class F>
 inline unsigned int TemplatedVocabulary<TDescriptor,F>::size() const
 {
-  return m_words.size();
+  return m_flat ? m_flat->num_words : m_words.size();
 }
 
 // --------------------------------------------------------------------------
@@ -1008,7 +1165,7 @@ inline unsigned int TemplatedVocabulary<TDescriptor,F>::size() const
 template<class TDescriptor, class F>
 inline bool TemplatedVocabulary<TDescriptor,F>::empty() const
 {
-  return m_words.empty();
+  return size() == 0;
 }
 
 // --------------------------------------------------------------------------
@@ -1017,15 +1174,14 @@ template<class TDescriptor, class F>
 float TemplatedVocabulary<TDescriptor,F>::getEffectiveLevels() const
 {
   long sum = 0;
-  typename std::vector<Node*>::const_iterator wit;
-  for(wit = m_words.begin(); wit != m_words.end(); ++wit)
+  for(WordId wid = 0; wid < size(); ++wid)
   {
-    const Node *p = *wit;
+    NodeId nid = m_word_nodes[wid];
     
-    for(; p->id != 0; sum++) p = &m_nodes[p->parent];
+    for(; nid != 0; sum++) nid = m_parents[nid];
   }
   
-  return (float)((double)sum / (double)m_words.size());
+  return (float)((double)sum / (double)size());
 }
 
 // --------------------------------------------------------------------------
@@ -1033,7 +1189,14 @@ float TemplatedVocabulary<TDescriptor,F>::getEffectiveLevels() const
 template<class TDescriptor, class F>
 TDescriptor TemplatedVocabulary<TDescriptor,F>::getWord(WordId wid) const
 {
-  return m_words[wid]->descriptor;
+  // descriptors are stored in the order of the children array
+  const NodeId nid = m_word_nodes[wid];
+  const uint32_t *c = m_children + m_child_starts[m_parents[nid]];
+  while(*c != nid) ++c;
+
+  TDescriptor d;
+  F::fromData(d, m_descriptors + (size_t)(c - m_children + 1) * F::L);
+  return d;
 }
 
 // --------------------------------------------------------------------------
@@ -1041,7 +1204,7 @@ TDescriptor TemplatedVocabulary<TDescriptor,F>::getWord(WordId wid) const
 template<class TDescriptor, class F>
 WordValue TemplatedVocabulary<TDescriptor, F>::getWordWeight(WordId wid) const
 {
-  return m_words[wid]->weight;
+  return m_weights[m_word_nodes[wid]];
 }
 
 // --------------------------------------------------------------------------
@@ -1127,6 +1290,21 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(
   const std::vector<TDescriptor>& features,
   BowVector &v, FeatureVector &fv, int levelsup) const
+{
+  std::vector<unsigned char> packed(features.size() * F::L);
+  for(size_t i = 0; i < features.size(); ++i)
+    memcpy(&packed[i * F::L], F::data(features[i]), F::L);
+
+  transform(packed.empty() ? NULL : &packed[0], (int)features.size(),
+    v, fv, levelsup);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F> 
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const unsigned char *features, int n,
+  BowVector &v, FeatureVector &fv, int levelsup) const
 {
   v.clear();
   fv.clear();
@@ -1140,26 +1318,24 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
   
-  typename vector<TDescriptor>::const_iterator fit;
+  std::vector<WordId> ids(n);
+  std::vector<WordValue> weights(n);
+  std::vector<NodeId> nids(n);
+  if(n > 0)
+    transformPacked(features, n, &ids[0], &weights[0], &nids[0], levelsup);
+
   // 单词的权重类型为TF/TF_IDF
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    unsigned int i_feature = 0;
     // 遍历当前图像的所有特征点
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(int i_feature = 0; i_feature < n; ++i_feature)
     {
-      WordId id; // 单词的id
-      NodeId nid; // 单词所属的子树对应的节点ID（叶节点-levelsup那一层的节点）
-      WordValue w;  // 单词的权重
       // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w, &nid, levelsup); // 遍历子树，搜索得到id，nid, w
-      
-      if(w > 0) // not stopped
+      if(weights[i_feature] > 0) // not stopped
       { 
         // 添加进BowVector:v和FeatureVector:fv中
-        v.addWeight(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addWeight(ids[i_feature], weights[i_feature]);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
     // 归一化BowVector的值
@@ -1174,20 +1350,13 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(int i_feature = 0; i_feature < n; ++i_feature)
     {
-      WordId id;
-      NodeId nid;
-      WordValue w;
       // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w, &nid, levelsup);
-      
-      if(w > 0) // not stopped
+      if(weights[i_feature] > 0) // not stopped
       {
-        v.addIfNotExist(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addIfNotExist(ids[i_feature], weights[i_feature]);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
   } // if m_weighting == ...
@@ -1220,49 +1389,74 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature, 
   WordId &word_id, WordValue &weight, NodeId *nid, int levelsup) const
 { 
-  // propagate the feature down the tree
-  vector<NodeId> nodes;
-  typename vector<NodeId>::const_iterator nit;
+  transformPacked(F::data(feature), 1, &word_id, &weight, nid, levelsup);
+}
+
+// --------------------------------------------------------------------------
 
-  // level at which the node must be stored in nid, if given
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transformPacked(
+  const unsigned char *features, int n, WordId *ids, WordValue *weights,
+  NodeId *nids, int levelsup) const
+{
+  // level at which the node must be stored in nids, if given
   // 获取levelsup后对应的层级
   const int nid_level = m_L - levelsup;
-  if(nid_level <= 0 && nid != NULL) *nid = 0; // root
+  if(nid_level <= 0 && nids != NULL) std::fill(nids, nids + n, 0); // root
 
   // 从根节点开始搜索
-  NodeId final_id = 0; // root
-  int current_level = 0;
-
-  do
+  std::vector<NodeId> nodes(n, 0); // root
+  std::vector<int> d(m_k);
+
+  // Descending all the features one level at a time keeps the upper levels
+  // in cache and lets the misses of different features in the lower levels
+  // overlap, instead of every feature walking its whole path alone
+  bool descending = true;
+  for(int current_level = 1; descending; ++current_level)
   {
-    ++current_level;
-    nodes = m_nodes[final_id].children;
-    final_id = nodes[0];
- 
-    double best_d = F::distance(feature, m_nodes[final_id].descriptor);
+    descending = false;
 
-    for(nit = nodes.begin() + 1; nit != nodes.end(); ++nit)
+    for(int i = 0; i < n; ++i)
     {
-      NodeId id = *nit;
-      double d = F::distance(feature, m_nodes[id].descriptor);
-      if(d < best_d)
+      if(i + 4 < n)
       {
-        best_d = d;
-        // 获取最优匹配的叶子节点id
-        final_id = id;
+        const unsigned char *next = m_descriptors +
+          ((size_t)m_child_starts[nodes[i + 4]] + 1) * F::L;
+        for(int b = 0; b < m_k * F::L; b += 64)
+          __builtin_prefetch(next + b);
       }
+
+      const uint32_t c0 = m_child_starts[nodes[i]];
+      const int nc = m_child_starts[nodes[i] + 1] - c0;
+      if(nc == 0) continue; // leaf
+
+      descending = true;
+      if(nc > (int)d.size()) d.resize(nc);
+
+      // the children's descriptors are contiguous
+      F::distances(features + (size_t)i * F::L,
+        m_descriptors + ((size_t)c0 + 1) * F::L, nc, &d[0]);
+
+      int best = 0;
+      for(int j = 1; j < nc; ++j)
+        if(d[j] < d[best]) best = j;
+
+      // 获取最优匹配的节点id
+      nodes[i] = m_children[c0 + best];
+
+      if(nids != NULL && current_level == nid_level)
+        // 如果搜索到了levelsup层级的节点，则存储当前节点的id到nids中
+        nids[i] = nodes[i];
     }
-    
-    if(nid != NULL && current_level == nid_level)
-      // 如果搜索到了levelsup层级的节点，则存储当前节点的id到nid中
-      *nid = final_id;
-    
-  } while( !m_nodes[final_id].isLeaf() );
+  }
 
   // turn node id into word id
   // 获取单词id和权重
-  word_id = m_nodes[final_id].word_id;
-  weight = m_nodes[final_id].weight;
+  for(int i = 0; i < n; ++i)
+  {
+    ids[i] = m_node_words[nodes[i]];
+    weights[i] = m_weights[nodes[i]];
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -1271,11 +1465,11 @@ template<class TDescriptor, class F>
 NodeId TemplatedVocabulary<TDescriptor,F>::getParentNode
   (WordId wid, int levelsup) const
 {
-  NodeId ret = m_words[wid]->id; // node id
+  NodeId ret = m_word_nodes[wid]; // node id
   while(levelsup > 0 && ret != 0) // ret == 0 --> root
   {
     --levelsup;
-    ret = m_nodes[ret].parent;
+    ret = m_parents[ret];
   }
   return ret;
 }
@@ -1288,9 +1482,9 @@ void TemplatedVocabulary<TDescriptor,F>::getWordsFromNode
 {
   words.clear();
   
-  if(m_nodes[nid].isLeaf())
+  if(m_child_starts[nid] == m_child_starts[nid + 1])
   {
-    words.push_back(m_nodes[nid].word_id);
+    words.push_back(m_node_words[nid]);
   }
   else
   {
@@ -1304,17 +1498,14 @@ void TemplatedVocabulary<TDescriptor,F>::getWordsFromNode
       NodeId parentid = parents.back();
       parents.pop_back();
       
-      const vector<NodeId> &child_ids = m_nodes[parentid].children;
-      vector<NodeId>::const_iterator cit;
-      
-      for(cit = child_ids.begin(); cit != child_ids.end(); ++cit)
+      for(uint32_t c = m_child_starts[parentid]; c < m_child_starts[parentid + 1]; ++c)
       {
-        const Node &child_node = m_nodes[*cit];
+        NodeId childid = m_children[c];
         
-        if(child_node.isLeaf())
-          words.push_back(child_node.word_id);
+        if(m_child_starts[childid] == m_child_starts[childid + 1])
+          words.push_back(m_node_words[childid]);
         else
-          parents.push_back(*cit);
+          parents.push_back(childid);
         
       } // for each child
     } // while !parents.empty
@@ -1336,6 +1527,8 @@ int TemplatedVocabulary<TDescriptor,F>::stopWords(double minWeight)
       (*wit)->weight = 0;
     }
   }
+  if(!m_nodes.empty())
+    buildFlatTree();
   return c;
 }
 
@@ -1352,6 +1545,7 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
 
     m_words.clear();
     m_nodes.clear();
+    releaseFlatTree();
 
     string s;
     getline(f,s);
@@ -1386,6 +1580,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
     {
         string snode;
         getline(f,snode);
+        if(snode.empty())
+            continue;
         stringstream ssnode;
         ssnode << snode;
 
@@ -1426,6 +1622,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    buildFlatTree();
+
     return true;
 
 }
@@ -1457,6 +1655,228 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::buildFlatTree()
+{
+  releaseFlatTree();
+
+  const uint32_t num_nodes = m_nodes.size();
+  const uint32_t num_words = m_words.size();
+
+  // lay out the arrays after the header
+  FlatHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "DBoW2bin", 8);
+  h.version = 2;
+  h.descriptor_bytes = F::L;
+  h.k = m_k;
+  h.L = m_L;
+  h.scoring = m_scoring;
+  h.weighting = m_weighting;
+  h.num_nodes = num_nodes;
+  h.num_words = num_words;
+
+  uint64_t offset = sizeof(FlatHeader);
+  uint64_t *sections[] = { &h.child_starts, &h.children, &h.parents,
+    &h.node_words, &h.word_nodes, &h.weights, &h.descriptors, &h.size };
+  const uint64_t bytes[] = { (num_nodes + 1) * sizeof(uint32_t),
+    (num_nodes > 0 ? num_nodes - 1 : 0) * sizeof(uint32_t),
+    num_nodes * sizeof(uint32_t), num_nodes * sizeof(uint32_t),
+    num_words * sizeof(uint32_t), num_nodes * sizeof(WordValue),
+    (uint64_t)num_nodes * F::L, 0 };
+  for(int i = 0; i < 8; ++i)
+  {
+    offset = (offset + 63) & ~(uint64_t)63;
+    *sections[i] = offset;
+    offset += bytes[i];
+  }
+  h.size = offset;
+
+  m_flat_storage.assign((h.size + 7) / 8, 0);
+  unsigned char *image = (unsigned char*)&m_flat_storage[0];
+  memcpy(image, &h, sizeof(h));
+
+  uint32_t *child_starts = (uint32_t*)(image + h.child_starts);
+  uint32_t *children = (uint32_t*)(image + h.children);
+  uint32_t *parents = (uint32_t*)(image + h.parents);
+  uint32_t *node_words = (uint32_t*)(image + h.node_words);
+  uint32_t *word_nodes = (uint32_t*)(image + h.word_nodes);
+  WordValue *weights = (WordValue*)(image + h.weights);
+  unsigned char *descriptors = image + h.descriptors;
+
+  uint32_t c = 0;
+  for(uint32_t i = 0; i < num_nodes; ++i)
+  {
+    const Node &node = m_nodes[i];
+    child_starts[i] = c;
+    for(size_t j = 0; j < node.children.size(); ++j, ++c)
+    {
+      children[c] = node.children[j];
+      memcpy(descriptors + ((size_t)c + 1) * F::L,
+        F::data(m_nodes[node.children[j]].descriptor), F::L);
+    }
+    parents[i] = node.parent;
+    node_words[i] = node.word_id;
+    weights[i] = node.weight;
+  }
+  if(num_nodes > 0)
+    child_starts[num_nodes] = c;
+
+  for(uint32_t i = 0; i < num_words; ++i)
+    word_nodes[i] = m_words[i]->id;
+
+  attachFlatTree(image, h.size);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::attachFlatTree
+  (const unsigned char *image, size_t size)
+{
+  const FlatHeader *h = (const FlatHeader*)image;
+  if(size < sizeof(FlatHeader) || memcmp(h->magic, "DBoW2bin", 8) != 0 ||
+    h->version != 2 || h->descriptor_bytes != (uint32_t)F::L ||
+    h->size > size || h->num_nodes == 0 || h->k <= 0 || h->L <= 0 ||
+    h->scoring < L1_NORM || h->scoring > DOT_PRODUCT ||
+    h->weighting < TF_IDF || h->weighting > BINARY)
+    return false;
+
+  // every array must lie inside the image, after the header and aligned
+  const uint64_t num_nodes = h->num_nodes;
+  const uint64_t num_words = h->num_words;
+  const uint64_t offsets[] = { h->child_starts, h->children, h->parents,
+    h->node_words, h->word_nodes, h->weights, h->descriptors };
+  const uint64_t bytes[] = { (num_nodes + 1) * sizeof(uint32_t),
+    (num_nodes - 1) * sizeof(uint32_t), num_nodes * sizeof(uint32_t),
+    num_nodes * sizeof(uint32_t), num_words * sizeof(uint32_t),
+    num_nodes * sizeof(WordValue), num_nodes * F::L };
+  const uint64_t alignments[] = { sizeof(uint32_t), sizeof(uint32_t),
+    sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(WordValue), 1 };
+  for(int i = 0; i < 7; ++i)
+  {
+    if(offsets[i] < sizeof(FlatHeader) || offsets[i] > h->size ||
+      bytes[i] > h->size - offsets[i] || offsets[i] % alignments[i] != 0)
+      return false;
+  }
+
+  const uint32_t *child_starts = (const uint32_t*)(image + h->child_starts);
+  const uint32_t *children = (const uint32_t*)(image + h->children);
+  const uint32_t *parents = (const uint32_t*)(image + h->parents);
+  const uint32_t *node_words = (const uint32_t*)(image + h->node_words);
+  const uint32_t *word_nodes = (const uint32_t*)(image + h->word_nodes);
+
+  // the indices must stay in their arrays. Children have larger ids than
+  // their parent, as m_nodes is built, so neither the descent nor the walk
+  // up to the root can loop
+  if(child_starts[0] != 0 || child_starts[num_nodes] != num_nodes - 1)
+    return false;
+  for(uint32_t i = 0; i < num_nodes; ++i)
+  {
+    const uint32_t c0 = child_starts[i], c1 = child_starts[i + 1];
+    if(c1 < c0 || c1 > num_nodes - 1)
+      return false;
+    for(uint32_t c = c0; c < c1; ++c)
+      if(children[c] <= i || children[c] >= num_nodes)
+        return false;
+    if(i > 0 && parents[i] >= i)
+      return false;
+    if(c0 == c1 && node_words[i] >= num_words)
+      return false;
+  }
+  for(uint32_t i = 0; i < num_words; ++i)
+    if(word_nodes[i] == 0 || word_nodes[i] >= num_nodes)
+      return false;
+
+  m_flat = h;
+  m_child_starts = child_starts;
+  m_children = children;
+  m_parents = parents;
+  m_node_words = node_words;
+  m_word_nodes = word_nodes;
+  m_weights = (const WordValue*)(image + h->weights);
+  m_descriptors = image + h->descriptors;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::releaseFlatTree()
+{
+  m_flat = NULL;
+  m_child_starts = m_children = m_parents = NULL;
+  m_node_words = m_word_nodes = NULL;
+  m_weights = NULL;
+  m_descriptors = NULL;
+
+  m_flat_storage.clear();
+  if(m_mapped)
+  {
+    munmap(m_mapped, m_mapped_size);
+    m_mapped = NULL;
+    m_mapped_size = 0;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FlatHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file referenced
+  if(mapped == MAP_FAILED)
+    return false;
+
+  m_words.clear();
+  m_nodes.clear();
+  releaseFlatTree();
+
+  if(!attachFlatTree((const unsigned char*)mapped, st.st_size))
+  {
+    std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+    munmap(mapped, st.st_size);
+    return false;
+  }
+  m_mapped = mapped;
+  m_mapped_size = st.st_size;
+
+  m_k = m_flat->k;
+  m_L = m_flat->L;
+  m_scoring = (ScoringType)m_flat->scoring;
+  m_weighting = (WeightingType)m_flat->weighting;
+  createScoringObject();
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+  if(!m_flat)
+    return false;
+
+  ofstream f(filename.c_str(), ios_base::out | ios_base::binary);
+  f.write((const char*)m_flat, m_flat->size);
+  return f.good();
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1582,6 +2002,7 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  releaseFlatTree();
   
   cv::FileNode fvoc = fs[name];
   
@@ -1626,6 +2047,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  buildFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -90,6 +90,8 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void constructQuadraticFormForVertex(int i);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::resize;
@@ -108,6 +110,9 @@ namespace g2o {
       JacobianXiOplusType _jacobianOplusXi;
       JacobianXjOplusType _jacobianOplusXj;
 
+      //! adds the hessian block and b of xi, of xj and the off diagonal block xi-xj, as selected
+      void addQuadraticForm(bool addFrom, bool addTo, bool addFromTo);
+
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   };
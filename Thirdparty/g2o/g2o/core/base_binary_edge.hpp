@@ -57,11 +57,6 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
   VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
 
-  // get the Jacobian of the nodes in the manifold domain
-  const JacobianXiOplusType& A = jacobianOplusXi();
-  const JacobianXjOplusType& B = jacobianOplusXj();
-
-
   bool fromNotFixed = !(from->fixed());
   bool toNotFixed = !(to->fixed());
 
@@ -70,52 +65,86 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
     from->lockQuadraticForm();
     to->lockQuadraticForm();
 #endif
-    const InformationType& omega = _information;
-    Matrix<double, D, 1> omega_r = - omega * _error;
-    if (this->robustKernel() == 0) {
-      if (fromNotFixed) {
-        Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+    addQuadraticForm(fromNotFixed, toNotFixed, fromNotFixed && toNotFixed);
+#ifdef G2O_OPENMP
+    to->unlockQuadraticForm();
+    from->unlockQuadraticForm();
+#endif
+  }
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticFormForVertex(int i)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
+  bool fromNotFixed = !(from->fixed());
+  bool toNotFixed = !(to->fixed());
+
+  // the off diagonal block belongs to the vertex with the smaller hessian index
+  bool offDiagonal = fromNotFixed && toNotFixed;
+  bool fromOwnsOffDiagonal = offDiagonal && from->hessianIndex() < to->hessianIndex();
+
+  if (i == 0 && fromNotFixed)
+    addQuadraticForm(true, false, fromOwnsOffDiagonal);
+  else if (i == 1 && toNotFixed)
+    addQuadraticForm(false, true, offDiagonal && !fromOwnsOffDiagonal);
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::addQuadraticForm(bool addFrom, bool addTo, bool addFromTo)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
+  // get the Jacobian of the nodes in the manifold domain
+  const JacobianXiOplusType& A = jacobianOplusXi();
+  const JacobianXjOplusType& B = jacobianOplusXj();
+
+  const InformationType& omega = _information;
+  Matrix<double, D, 1> omega_r = - omega * _error;
+  if (this->robustKernel() == 0) {
+    if (addFrom || addFromTo) {
+      Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+      if (addFrom) {
         from->b().noalias() += A.transpose() * omega_r;
         from->A().noalias() += AtO*A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
-          else
-            _hessian.noalias() += AtO * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * omega * B;
       }
-    } else { // robust (weighted) error according to some kernel
-      double error = this->chi2();
-      Eigen::Vector3d rho;
-      this->robustKernel()->robustify(error, rho);
-      InformationType weightedOmega = this->robustInformation(rho);
-      //std::cout << PVAR(rho.transpose()) << std::endl;
-      //std::cout << PVAR(weightedOmega) << std::endl;
-
-      omega_r *= rho[1];
-      if (fromNotFixed) {
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += A.transpose() * weightedOmega * A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
-          else
-            _hessian.noalias() += A.transpose() * weightedOmega * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * weightedOmega * B;
+      if (addFromTo) {
+        if (_hessianRowMajor) // we have to write to the block as transposed
+          _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
+        else
+          _hessian.noalias() += AtO * B;
       }
     }
-#ifdef G2O_OPENMP
-    to->unlockQuadraticForm();
-    from->unlockQuadraticForm();
-#endif
+    if (addTo) {
+      to->b().noalias() += B.transpose() * omega_r;
+      to->A().noalias() += B.transpose() * omega * B;
+    }
+  } else { // robust (weighted) error according to some kernel
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    InformationType weightedOmega = this->robustInformation(rho);
+    //std::cout << PVAR(rho.transpose()) << std::endl;
+    //std::cout << PVAR(weightedOmega) << std::endl;
+
+    omega_r *= rho[1];
+    if (addFrom) {
+      from->b().noalias() += A.transpose() * omega_r;
+      from->A().noalias() += A.transpose() * weightedOmega * A;
+    }
+    if (addFromTo) {
+      if (_hessianRowMajor) // we have to write to the block as transposed
+        _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
+      else
+        _hessian.noalias() += A.transpose() * weightedOmega * B;
+    }
+    if (addTo) {
+      to->b().noalias() += B.transpose() * omega_r;
+      to->A().noalias() += B.transpose() * weightedOmega * B;
+    }
   }
 }
 
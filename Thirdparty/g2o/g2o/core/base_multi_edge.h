@@ -86,6 +86,8 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void constructQuadraticFormForVertex(int i);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::computeError;
@@ -101,6 +103,7 @@ namespace g2o {
       std::vector<JacobianType, aligned_allocator<JacobianType> > _jacobianOplus; ///< jacobians of the edge (w.r.t. oplus)
 
       void computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError);
+      void computeQuadraticFormForVertex(const InformationType& omega, const ErrorVector& weightedError, int i);
 
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
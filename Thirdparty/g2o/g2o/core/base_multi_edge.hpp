@@ -48,6 +48,22 @@ void BaseMultiEdge<D, E>::constructQuadraticForm()
 }
 
 
+template <int D, typename E>
+void BaseMultiEdge<D, E>::constructQuadraticFormForVertex(int i)
+{
+  if (this->robustKernel()) {
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    Matrix<double, D, 1> omega_r = - _information * _error;
+    omega_r *= rho[1];
+    computeQuadraticFormForVertex(this->robustInformation(rho), omega_r, i);
+  } else {
+    computeQuadraticFormForVertex(_information, - _information * _error, i);
+  }
+}
+
+
 template <int D, typename E>
 void BaseMultiEdge<D, E>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
@@ -220,3 +236,54 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
 
   }
 }
+
+template <int D, typename E>
+void BaseMultiEdge<D, E>::computeQuadraticFormForVertex(const InformationType& omega, const ErrorVector& weightedError, int i)
+{
+  OptimizableGraph::Vertex* from = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+  if (from->fixed())
+    return;
+
+  const MatrixXd& A = _jacobianOplus[i];
+
+  MatrixXd AtO = A.transpose() * omega;
+  int fromDim = from->dimension();
+  assert(fromDim >= 0);
+  Eigen::Map<MatrixXd> fromMap(from->hessianData(), fromDim, fromDim);
+  Eigen::Map<VectorXd> fromB(from->bData(), fromDim);
+
+  // ii block in the hessian
+  fromMap.noalias() += AtO * A;
+  fromB.noalias() += A.transpose() * weightedError;
+
+  // the off-diagonal blocks to the vertices with a larger hessian index, computed
+  // exactly like computeQuadraticForm() does for the pair (min(i,j), max(i,j))
+  for (size_t j = 0; j < _vertices.size(); ++j) {
+    if (static_cast<int>(j) == i)
+      continue;
+    OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
+    if (to->fixed() || to->hessianIndex() < from->hessianIndex())
+      continue;
+    const MatrixXd& B = _jacobianOplus[j];
+    if (static_cast<int>(j) > i) {
+      int idx = internal::computeUpperTriangleIndex(i, j);
+      assert(idx < (int)_hessian.size());
+      HessianHelper& hhelper = _hessian[idx];
+      if (hhelper.transposed) { // we have to write to the block as transposed
+        hhelper.matrix.noalias() += B.transpose() * AtO.transpose();
+      } else {
+        hhelper.matrix.noalias() += AtO * B;
+      }
+    } else {
+      MatrixXd BtO = B.transpose() * omega;
+      int idx = internal::computeUpperTriangleIndex(j, i);
+      assert(idx < (int)_hessian.size());
+      HessianHelper& hhelper = _hessian[idx];
+      if (hhelper.transposed) { // we have to write to the block as transposed
+        hhelper.matrix.noalias() += A.transpose() * BtO.transpose();
+      } else {
+        hhelper.matrix.noalias() += BtO * A;
+      }
+    }
+  }
+}
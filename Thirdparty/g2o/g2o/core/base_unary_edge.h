@@ -73,6 +73,9 @@ namespace g2o {
 
       virtual void constructQuadraticForm();
 
+      //! the edge only writes to its single vertex
+      virtual void constructQuadraticFormForVertex(int i) { (void) i; constructQuadraticForm();}
+
       virtual void initialEstimate(const OptimizableGraph::VertexSet& from, OptimizableGraph::Vertex* to);
 
       virtual void mapHessianMemory(double*, int, int, bool) {assert(0 && "BaseUnaryEdge does not map memory of the Hessian");}
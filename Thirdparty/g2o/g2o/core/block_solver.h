@@ -147,6 +147,10 @@ namespace g2o {
 
       void deallocate();
 
+      //! buildSystem() and the Schur complement of solve() on the parallel loop of the optimizer
+      void buildSystemParallel();
+      void computeSchurParallel();
+
       SparseBlockMatrix<PoseMatrixType>* _Hpp;
       SparseBlockMatrix<LandmarkMatrixType>* _Hll;
       SparseBlockMatrix<PoseLandmarkMatrixType>* _Hpl;
@@ -168,6 +172,14 @@ namespace g2o {
 
       bool _doSchur;
 
+      // workspace of the parallel code path
+      VectorXd _jacobians;                 ///< Jacobians of all active edges
+      std::vector<int> _jacobianOffsets;   ///< start of the Jacobians of each active edge
+      std::vector<int> _vertexEdgeStarts;  ///< CSR over the hessian index of the vertices
+      std::vector<std::pair<int, int> > _vertexEdges; ///< (active edge, vertex number in the edge)
+      std::vector<int> _poseLandmarkStarts; ///< CSR over the poses
+      std::vector<std::pair<int, int> > _poseLandmarks; ///< (landmark, position in the landmark column of _HplCCS)
+
       double* _coefficients;
       double* _bschur;
 
@@ -375,58 +375,62 @@ bool BlockSolver<Traits>::solve(){
 
   //_DInvSchur->clear();
   memset (_coefficients, 0, _sizePoses*sizeof(double));
+  if (_optimizer->parallelFor())
+    computeSchurParallel();
+  else {
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) schedule(dynamic, 10)
 # endif
-  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
-    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
-    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
-
-    // calculate inverse block for the landmark
-    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
-    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
-    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
-    Dinv = D->inverse();
-
-    LandmarkVectorType  db(D->rows());
-    for (int j=0; j<D->rows(); ++j) {
-      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
-    }
-    db=Dinv*db;
+    for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      // calculate inverse block for the landmark
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      db=Dinv*db;
 
-    assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
-    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+      assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
 
-    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
-        it_outer != landmarkColumn.end(); ++it_outer) {
-      int i1 = it_outer->row;
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
+          it_outer != landmarkColumn.end(); ++it_outer) {
+        int i1 = it_outer->row;
 
-      const PoseLandmarkMatrixType* Bi = it_outer->block;
-      assert(Bi);
+        const PoseLandmarkMatrixType* Bi = it_outer->block;
+        assert(Bi);
 
-      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
-      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
-      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+        PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+        assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+        typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
 #    ifdef G2O_OPENMP
-      ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
+        ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
 #    endif
-      Bb.noalias() += (*Bi)*db;
-
-      assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
-      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
-
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
-      for (; it_inner != landmarkColumn.end(); ++it_inner) {
-        int i2 = it_inner->row;
-        const PoseLandmarkMatrixType* Bj = it_inner->block;
-        assert(Bj); 
-        while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
-          ++targetColumnIt;
-        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
-        PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
-        assert(Hi1i2);
-        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        Bb.noalias() += (*Bi)*db;
+
+        assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
+        typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+        for (; it_inner != landmarkColumn.end(); ++it_inner) {
+          int i2 = it_inner->row;
+          const PoseLandmarkMatrixType* Bj = it_inner->block;
+          assert(Bj); 
+          while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
+            ++targetColumnIt;
+          assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+          PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
+          assert(Hi1i2);
+          (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        }
       }
     }
   }
@@ -501,6 +505,11 @@ bool BlockSolver<Traits>::computeMarginals(SparseBlockMatrix<MatrixXd>& spinv, c
 template <typename Traits>
 bool BlockSolver<Traits>::buildSystem()
 {
+  if (_optimizer->parallelFor() && _optimizer->activeEdges().size() > 100) {
+    buildSystemParallel();
+    return 0;
+  }
+
   // clear b vector
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) if (_optimizer->indexMapping().size() > 1000)
@@ -560,6 +569,170 @@ bool BlockSolver<Traits>::buildSystem()
 }
 
 
+template <typename Traits>
+void BlockSolver<Traits>::buildSystemParallel()
+{
+  const SparseOptimizer::ParallelForFunction& parallelFor = _optimizer->parallelFor();
+  const OptimizableGraph::EdgeContainer& edges = _optimizer->activeEdges();
+  const OptimizableGraph::VertexContainer& vertices = _optimizer->indexMapping();
+  const int numEdges = static_cast<int>(edges.size());
+  const int numVertices = static_cast<int>(vertices.size());
+  const int chunkSize = 64;
+
+  _Hpp->clear();
+  if (_doSchur) {
+    _Hll->clear();
+    _Hpl->clear();
+  }
+
+  // every edge keeps its Jacobians in its own memory, they are needed until all vertices are done
+  _jacobianOffsets.resize(numEdges + 1);
+  _jacobianOffsets[0] = 0;
+  for (int k = 0; k < numEdges; ++k)
+    _jacobianOffsets[k+1] = _jacobianOffsets[k] + JacobianWorkspace::externalSize(edges[k]);
+  if (_jacobians.size() < _jacobianOffsets[numEdges])
+    _jacobians.resize(_jacobianOffsets[numEdges]);
+
+  // the edges of each vertex in the order of the active edges, as the serial loop adds them
+  _vertexEdgeStarts.assign(numVertices + 1, 0);
+  for (int k = 0; k < numEdges; ++k) {
+    const OptimizableGraph::Edge* e = edges[k];
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      int vertexIndex = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i))->hessianIndex();
+      if (vertexIndex >= 0)
+        ++_vertexEdgeStarts[vertexIndex+1];
+    }
+  }
+  for (int i = 0; i < numVertices; ++i)
+    _vertexEdgeStarts[i+1] += _vertexEdgeStarts[i];
+  _vertexEdges.resize(_vertexEdgeStarts[numVertices]);
+  std::vector<int> next(_vertexEdgeStarts.begin(), _vertexEdgeStarts.end() - 1);
+  for (int k = 0; k < numEdges; ++k) {
+    const OptimizableGraph::Edge* e = edges[k];
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      int vertexIndex = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i))->hessianIndex();
+      if (vertexIndex >= 0)
+        _vertexEdges[next[vertexIndex]++] = std::make_pair(k, static_cast<int>(i));
+    }
+  }
+
+  // linearize the edges
+  parallelFor(0, (numEdges + chunkSize - 1) / chunkSize, [&](int chunk) {
+    JacobianWorkspace jacobianWorkspace;
+    const int end = std::min(numEdges, (chunk + 1) * chunkSize);
+    for (int k = chunk * chunkSize; k < end; ++k) {
+      OptimizableGraph::Edge* e = edges[k];
+      jacobianWorkspace.mapExternalMemory(_jacobians.data() + _jacobianOffsets[k], e);
+      e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+#    ifndef NDEBUG
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        if (! v->fixed()) {
+          bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+          if (hasANan) {
+            cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+            break;
+          }
+        }
+      }
+#    endif
+    }
+  });
+
+  // each vertex accumulates its own blocks, nothing is written by two threads
+  parallelFor(0, (numVertices + chunkSize - 1) / chunkSize, [&](int chunk) {
+    const int end = std::min(numVertices, (chunk + 1) * chunkSize);
+    for (int i = chunk * chunkSize; i < end; ++i) {
+      OptimizableGraph::Vertex* v = vertices[i];
+      assert(v);
+      v->clearQuadraticForm();
+      for (int j = _vertexEdgeStarts[i]; j < _vertexEdgeStarts[i+1]; ++j)
+        edges[_vertexEdges[j].first]->constructQuadraticFormForVertex(_vertexEdges[j].second);
+      int iBase = v->colInHessian();
+      if (v->marginalized())
+        iBase+=_sizePoses;
+      v->copyB(_b+iBase);
+    }
+  });
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::computeSchurParallel()
+{
+  const SparseOptimizer::ParallelForFunction& parallelFor = _optimizer->parallelFor();
+  const int numLandmarks = static_cast<int>(_Hll->blockCols().size());
+  const int chunkSize = 64;
+
+  // invert the landmark blocks, Dinv * b of the landmarks goes to the landmark part of _coefficients
+  parallelFor(0, (numLandmarks + chunkSize - 1) / chunkSize, [&](int chunk) {
+    const int end = std::min(numLandmarks, (chunk + 1) * chunkSize);
+    for (int landmarkIndex = chunk * chunkSize; landmarkIndex < end; ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      typename LandmarkVectorType::MapType dbDinv(&_coefficients[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses], D->rows());
+      dbDinv=Dinv*db;
+    }
+  });
+
+  // the landmarks of each pose in increasing order, as the serial loop visits them
+  _poseLandmarkStarts.assign(_numPoses + 1, 0);
+  for (int landmarkIndex = 0; landmarkIndex < numLandmarks; ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t j = 0; j < landmarkColumn.size(); ++j)
+      ++_poseLandmarkStarts[landmarkColumn[j].row + 1];
+  }
+  for (int i = 0; i < _numPoses; ++i)
+    _poseLandmarkStarts[i+1] += _poseLandmarkStarts[i];
+  _poseLandmarks.resize(_poseLandmarkStarts[_numPoses]);
+  std::vector<int> next(_poseLandmarkStarts.begin(), _poseLandmarkStarts.end() - 1);
+  for (int landmarkIndex = 0; landmarkIndex < numLandmarks; ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t j = 0; j < landmarkColumn.size(); ++j)
+      _poseLandmarks[next[landmarkColumn[j].row]++] = std::make_pair(landmarkIndex, static_cast<int>(j));
+  }
+
+  // every pose updates its own row of the upper triangle of _Hschur and its coefficients
+  parallelFor(0, _numPoses, [&](int i1) {
+    for (int k = _poseLandmarkStarts[i1]; k < _poseLandmarkStarts[i1+1]; ++k) {
+      int landmarkIndex = _poseLandmarks[k].first;
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+      const LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      LandmarkVectorType db = typename LandmarkVectorType::MapType(&_coefficients[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses], Dinv.rows());
+
+      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin() + _poseLandmarks[k].second;
+      const PoseLandmarkMatrixType* Bi = it_outer->block;
+      assert(Bi);
+
+      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+      Bb.noalias() += (*Bi)*db;
+
+      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = it_outer; it_inner != landmarkColumn.end(); ++it_inner) {
+        int i2 = it_inner->row;
+        const PoseLandmarkMatrixType* Bj = it_inner->block;
+        assert(Bj);
+        while (targetColumnIt->row < i2)
+          ++targetColumnIt;
+        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+        PoseMatrixType* Hi1i2 = targetColumnIt->block;
+        assert(Hi1i2);
+        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+      }
+    }
+  });
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::setLambda(double lambda, bool backup)
 {
@@ -34,6 +34,15 @@ using namespace std;
 
 namespace g2o {
 
+namespace {
+  // the Jacobians are mapped as aligned Eigen matrices, keep every one of them at an aligned address
+  inline int alignedJacobianSize(int size)
+  {
+    const int alignment = EIGEN_MAX_ALIGN_BYTES > 0 ? EIGEN_MAX_ALIGN_BYTES / static_cast<int>(sizeof(double)) : 1;
+    return (size + alignment - 1) / alignment * alignment;
+  }
+}
+
 JacobianWorkspace::JacobianWorkspace() :
   _maxNumVertices(-1), _maxDimension(-1)
 {
@@ -56,6 +65,30 @@ bool JacobianWorkspace::allocate()
   return true;
 }
 
+void JacobianWorkspace::mapExternalMemory(double* memory, const HyperGraph::Edge* e_)
+{
+  const OptimizableGraph::Edge* e = static_cast<const OptimizableGraph::Edge*>(e_);
+  const int errorDimension = e->dimension();
+  _external.resize(e->vertices().size());
+  for (size_t i = 0; i < e->vertices().size(); ++i) {
+    const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+    _external[i] = memory;
+    memory += alignedJacobianSize(errorDimension * v->dimension());
+  }
+}
+
+int JacobianWorkspace::externalSize(const HyperGraph::Edge* e_)
+{
+  const OptimizableGraph::Edge* e = static_cast<const OptimizableGraph::Edge*>(e_);
+  const int errorDimension = e->dimension();
+  int size = 0;
+  for (size_t i = 0; i < e->vertices().size(); ++i) {
+    const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+    size += alignedJacobianSize(errorDimension * v->dimension());
+  }
+  return size;
+}
+
 void JacobianWorkspace::updateSize(const HyperGraph::Edge* e_)
 {
   const OptimizableGraph::Edge* e = static_cast<const OptimizableGraph::Edge*>(e_);
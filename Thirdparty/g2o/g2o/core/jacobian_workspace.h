@@ -81,14 +81,29 @@ namespace g2o {
        */
       double* workspaceForVertex(int vertexIndex)
       {
+        if (! _external.empty()) {
+          assert(vertexIndex >= 0 && (size_t)vertexIndex < _external.size() && "Index out of bounds");
+          return _external[vertexIndex];
+        }
         assert(vertexIndex >= 0 && (size_t)vertexIndex < _workspace.size() && "Index out of bounds");
         return _workspace[vertexIndex].data();
       }
 
+      /**
+       * let the Jacobians of the edge e be stored in external memory instead of the workspace,
+       * so that they stay valid after the next edge is linearized. The memory has to be aligned
+       * and hold externalSize(e) doubles.
+       */
+      void mapExternalMemory(double* memory, const HyperGraph::Edge* e);
+
+      //! doubles of external memory needed by the Jacobians of e, each one padded to keep the alignment
+      static int externalSize(const HyperGraph::Edge* e);
+
     protected:
       WorkspaceVector _workspace;   ///< the memory pre-allocated for computing the Jacobians
       int _maxNumVertices;          ///< the maximum number of vertices connected by a hyper-edge
       int _maxDimension;            ///< the maximum dimension (number of elements) for a Jacobian
+      std::vector<double*> _external; ///< Jacobians of the current edge if mapped to external memory
   };
 
 } // end namespace
@@ -437,6 +437,15 @@ namespace g2o {
          */
         virtual void constructQuadraticForm() = 0;
 
+        /**
+         * The part of constructQuadraticForm() owned by the i-th vertex of the edge:
+         * its hessian block ii and parameter vector b, and the off diagonal blocks to
+         * the other vertices of the edge with a larger hessian index. Calling it for all
+         * non-fixed vertices of the edge equals constructQuadraticForm(), but different
+         * vertices never write to the same memory and can be processed concurrently.
+         */
+        virtual void constructQuadraticFormForVertex(int i) = 0;
+
         /**
          * maps the internal matrix to some external memory location,
          * you need to provide the memory before calling constructQuadraticForm
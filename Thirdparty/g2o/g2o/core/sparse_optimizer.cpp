@@ -67,12 +67,22 @@ namespace g2o{
         (*(*it))(this);
     }
 
+    if (_parallelFor && _activeEdges.size() > 50) {
+      const int chunkSize = 64;
+      const int numEdges = static_cast<int>(_activeEdges.size());
+      _parallelFor(0, (numEdges + chunkSize - 1) / chunkSize, [&](int chunk) {
+        const int end = std::min(numEdges, (chunk + 1) * chunkSize);
+        for (int k = chunk * chunkSize; k < end; ++k)
+          _activeEdges[k]->computeError();
+      });
+    } else {
 #   ifdef G2O_OPENMP
 #   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
 #   endif
-    for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
-      OptimizableGraph::Edge* e = _activeEdges[k];
-      e->computeError();
+      for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
     }
 
 #  ifndef NDEBUG
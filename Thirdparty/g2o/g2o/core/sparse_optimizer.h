@@ -34,6 +34,7 @@
 #include "batch_stats.h"
 
 #include <map>
+#include <functional>
 
 namespace g2o {
 
@@ -187,6 +188,20 @@ namespace g2o {
     //! if external stop flag is given, return its state. False otherwise
     bool terminate() {return _forceStopFlag ? (*_forceStopFlag) : false; }
 
+    /**
+     * runs f(i) for every i in [begin,end) and returns once all of them finished
+     */
+    typedef std::function<void(int, int, const std::function<void(int)>&)> ParallelForFunction;
+
+    /**
+     * sets a parallel loop used to compute the errors, the Jacobians and the Schur complement.
+     * The result is identical to the serial one, as every block is still accumulated by a single
+     * thread in the same order. Only valid if the edges compute their Jacobians analytically,
+     * numeric differentiation modifies the vertex estimates. An empty function runs serially.
+     */
+    void setParallelFor(const ParallelForFunction& parallelFor) { _parallelFor = parallelFor;}
+    const ParallelForFunction& parallelFor() const { return _parallelFor;}
+
     //! the index mapping of the vertices
     const VertexContainer& indexMapping() const {return _ivMap;}
     //! the vertices active in the current optimization
@@ -289,6 +304,7 @@ namespace g2o {
     protected:
     bool* _forceStopFlag;
     bool _verbose;
+    ParallelForFunction _parallelFor;
 
     VertexContainer _ivMap;
     VertexContainer _activeVertices;   ///< sorted according to VertexIDCompare
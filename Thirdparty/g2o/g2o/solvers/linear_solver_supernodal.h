@@ -0,0 +1,495 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_LINEAR_SOLVER_SUPERNODAL_H
+#define G2O_LINEAR_SOLVER_SUPERNODAL_H
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+
+#include "../core/linear_solver.h"
+#include "../core/batch_stats.h"
+#include "../stuff/timeutil.h"
+
+#include "../core/eigen_types.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace g2o {
+
+/**
+ * \brief supernodal sparse Cholesky solver, in the spirit of CHOLMOD
+ *
+ * Only depends on Eigen. The fill-reducing ordering (AMD) is computed on the
+ * block structure of A, so every block of A maps to a dense sub-block of L. Consecutive
+ * columns of L with the same sparsity pattern are grouped into supernodes, which are
+ * stored as dense column-major panels and factorized with dense kernels (LLT, triangular
+ * solve, rank update) instead of one scalar column at a time.
+ *
+ * The symbolic factorization (ordering, elimination tree, supernode layout and the map
+ * from the blocks of A into the panels) is reused by all solves, which only redo the
+ * numeric factorization. After init() the block pattern of A is compared with the one
+ * of the cached decomposition and the symbolic part is only recomputed if it changed,
+ * so a solver kept alive across optimizations of graphs with the same structure (e.g.
+ * successive local BA windows) skips the ordering altogether.
+ * Compared to LinearSolverEigen this pays off for large, fairly dense reduced systems
+ * such as global BA or the essential graph.
+ */
+template <typename MatrixType>
+class LinearSolverSupernodal: public LinearSolver<MatrixType>
+{
+  public:
+    typedef Eigen::SparseMatrix<double, Eigen::ColMajor> SparseMatrix;
+    typedef Eigen::Triplet<double> Triplet;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> PanelMatrix;
+
+  public:
+    LinearSolverSupernodal() :
+      LinearSolver<MatrixType>(),
+      _init(true), _writeDebug(false), _n(0), _numSymbolic(0), _numSymbolicReused(0)
+    {
+    }
+
+    virtual ~LinearSolverSupernodal()
+    {
+    }
+
+    //! the pattern of A is checked against the cached symbolic decomposition on the next solve
+    virtual bool init()
+    {
+      _init = true;
+      return true;
+    }
+
+    bool solve(const SparseBlockMatrix<MatrixType>& A, double* x, double* b)
+    {
+      if (_init) { // compute the symbolic decomposition only if the pattern changed
+        if (samePattern(A)) {
+          ++_numSymbolicReused;
+        } else {
+          computeSymbolicDecomposition(A);
+          storePattern(A);
+          ++_numSymbolic;
+        }
+      }
+      _init = false;
+
+      double t=get_monotonic_time();
+      if (! computeNumericDecomposition(A)) { // the matrix is not positive definite
+        if (_writeDebug) {
+          std::cerr << "Cholesky failure, writing debug.txt (Hessian loadable by Octave)" << std::endl;
+          A.writeOctave("debug.txt");
+        }
+        return false;
+      }
+
+      // Solving the system in the permuted ordering
+      VectorXD::MapType xx(x, _n);
+      VectorXD::ConstMapType bb(b, _n);
+      for (int i = 0; i < _n; ++i)
+        _y(i) = bb(_perm[i]);
+      solveForward();
+      solveBackward();
+      for (int i = 0; i < _n; ++i)
+        xx(_perm[i]) = _y(i);
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats) {
+        globalStats->timeNumericDecomposition = get_monotonic_time() - t;
+        globalStats->choleskyNNZ = _nnzL;
+      }
+
+      return true;
+    }
+
+    //! number of supernodes of the current symbolic decomposition
+    int numSupernodes() const { return _supernodes.size();}
+
+    //! how often the symbolic decomposition was computed / reused after init()
+    int numSymbolicDecompositions() const { return _numSymbolic;}
+    int numSymbolicReused() const { return _numSymbolicReused;}
+
+    //! write a debug dump of the system matrix if it is not SPD in solve
+    virtual bool writeDebug() const { return _writeDebug;}
+    virtual void setWriteDebug(bool b) { _writeDebug = b;}
+
+  protected:
+    /**
+     * a set of consecutive columns of L sharing the same structure below the diagonal.
+     * The panel holds the numCols x numCols lower triangular diagonal block on top of
+     * the rows.size() x numCols dense block below it.
+     */
+    struct Supernode
+    {
+      int firstBlock, lastBlock;        // permuted block columns [firstBlock,lastBlock)
+      int firstCol, numCols;            // permuted scalar columns
+      std::vector<int> rowBlocks;       // permuted block rows below the diagonal block, sorted
+      std::vector<int> rowBlockOffsets; // panel row of each entry of rowBlocks
+      std::vector<int> rows;            // permuted scalar rows below the diagonal block, sorted
+      PanelMatrix panel;
+    };
+
+    //! where a block of A is copied to in the panels
+    struct AssemblyEntry
+    {
+      int supernode;
+      int row, col;     // panel position of the (0,0) element of the block
+      bool transposed;  // block lies in the upper triangle of the permuted matrix
+    };
+
+    bool _init;
+    bool _writeDebug;
+    int _n;
+    size_t _nnzL;
+    std::vector<int> _perm;          // permuted scalar index -> index in A
+    std::vector<int> _colSupernode;  // permuted scalar column -> supernode
+    std::vector<Supernode> _supernodes;
+    std::vector<AssemblyEntry> _assembly;
+    std::vector<int> _map;           // workspace: permuted row -> panel row of the current target
+    PanelMatrix _update;             // workspace: dense update of the current supernode
+    VectorXD _y, _gather;            // workspace for the triangular solves
+    std::vector<int> _patternBlockIndices; // block pattern the symbolic decomposition was computed for
+    std::vector<int> _patternBlocks;
+    int _numSymbolic;
+    int _numSymbolicReused;
+
+    //! end of every block column, and the row of every upper triangular block (columns separated by -1)
+    void blockPattern(const SparseBlockMatrix<MatrixType>& A, std::vector<int>& blockIndices, std::vector<int>& blocks) const
+    {
+      blockIndices.clear();
+      blocks.clear();
+      for (size_t c = 0; c < A.blockCols().size(); ++c){
+        blockIndices.push_back(A.colBaseOfBlock(c) + A.colsOfBlock(c));
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          if (it->first > static_cast<int>(c))
+            break;
+          blocks.push_back(it->first);
+        }
+        blocks.push_back(-1); // end of column
+      }
+    }
+
+    bool samePattern(const SparseBlockMatrix<MatrixType>& A) const
+    {
+      if (_supernodes.empty() || A.blockCols().size() != _patternBlockIndices.size())
+        return false;
+      std::vector<int> blockIndices, blocks;
+      blockPattern(A, blockIndices, blocks);
+      return blockIndices == _patternBlockIndices && blocks == _patternBlocks;
+    }
+
+    void storePattern(const SparseBlockMatrix<MatrixType>& A)
+    {
+      blockPattern(A, _patternBlockIndices, _patternBlocks);
+    }
+
+    /**
+     * compute the symbolic decomposition of the matrix only once.
+     * Since A has the same pattern in all the iterations, we only
+     * compute the ordering, elimination tree and supernodes once and
+     * re-use them for all the following iterations.
+     */
+    void computeSymbolicDecomposition(const SparseBlockMatrix<MatrixType>& A)
+    {
+      double t=get_monotonic_time();
+      const int nb = A.blockCols().size();
+      _n = A.rows();
+      assert(_n == A.cols() && "Matrix A is not square");
+
+      // AMD ordering on the block structure
+      std::vector<int> blockPerm(nb), blockPinv(nb);
+      {
+        std::vector<Triplet> triplets;
+        for (int c = 0; c < nb; ++c){
+          const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+          for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+            const int& r = it->first;
+            if (r > c) // only upper triangle
+              break;
+            triplets.push_back(Triplet(r, c, 0.));
+          }
+        }
+        SparseMatrix auxBlockMatrix(nb, nb);
+        auxBlockMatrix.setFromTriplets(triplets.begin(), triplets.end());
+        Eigen::SparseMatrix<double, Eigen::ColMajor, int> C;
+        C = auxBlockMatrix.selfadjointView<Eigen::Upper>();
+        Eigen::PermutationMatrix<Eigen::Dynamic,Eigen::Dynamic,int> blockP;
+        Eigen::internal::minimum_degree_ordering(C, blockP);
+        for (int i = 0; i < nb; ++i) {
+          blockPerm[i] = blockP.indices()(i);
+          blockPinv[blockPerm[i]] = i;
+        }
+      }
+
+      // scalar layout of the permuted matrix
+      std::vector<int> blockBase(nb+1, 0);
+      _perm.resize(_n);
+      for (int i = 0; i < nb; ++i) {
+        const int p = blockPerm[i];
+        const int nCols = A.colsOfBlock(p);
+        blockBase[i+1] = blockBase[i] + nCols;
+        for (int j = 0; j < nCols; ++j)
+          _perm[blockBase[i]+j] = A.colBaseOfBlock(p) + j;
+      }
+
+      // strictly lower block pattern of the permuted matrix, per column
+      std::vector<std::vector<int> > lowerRows(nb);
+      for (int c = 0; c < nb; ++c){
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int& r = it->first;
+          if (r >= c)
+            break;
+          const int pr = blockPinv[r];
+          const int pc = blockPinv[c];
+          lowerRows[std::min(pr, pc)].push_back(std::max(pr, pc));
+        }
+      }
+
+      // block structure of L and elimination tree: struct(j) is the pattern of A(:,j)
+      // merged with the structures of the children of j, parent(j) = min struct(j)
+      std::vector<int> parent(nb, -1);
+      std::vector<std::vector<int> > children(nb);
+      std::vector<std::vector<int> > colStruct(nb);
+      std::vector<int> mark(nb, -1);
+      for (int j = 0; j < nb; ++j) {
+        std::vector<int>& s = colStruct[j];
+        mark[j] = j;
+        for (size_t k = 0; k < lowerRows[j].size(); ++k) {
+          const int i = lowerRows[j][k];
+          if (mark[i] != j) {
+            mark[i] = j;
+            s.push_back(i);
+          }
+        }
+        for (size_t c = 0; c < children[j].size(); ++c) {
+          const std::vector<int>& sc = colStruct[children[j][c]];
+          for (size_t k = 0; k < sc.size(); ++k) {
+            const int i = sc[k];
+            if (mark[i] != j) {
+              mark[i] = j;
+              s.push_back(i);
+            }
+          }
+        }
+        std::sort(s.begin(), s.end());
+        if (! s.empty()) {
+          parent[j] = s[0];
+          children[s[0]].push_back(j);
+        }
+      }
+
+      // fundamental supernodes: j joins the supernode of j-1 if j-1 is its only child
+      // and struct(j-1) = {j} + struct(j)
+      std::vector<int> blockSupernode(nb);
+      _supernodes.clear();
+      for (int j = 0; j < nb; ++j) {
+        const bool merge = j > 0 && parent[j-1] == j && children[j].size() == 1 &&
+                           colStruct[j-1].size() == colStruct[j].size() + 1;
+        if (! merge) {
+          _supernodes.push_back(Supernode());
+          _supernodes.back().firstBlock = j;
+        }
+        _supernodes.back().lastBlock = j + 1;
+        blockSupernode[j] = _supernodes.size() - 1;
+      }
+
+      _colSupernode.resize(_n);
+      _nnzL = 0;
+      size_t maxRows = 0;
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        Supernode& sn = _supernodes[s];
+        sn.firstCol = blockBase[sn.firstBlock];
+        sn.numCols = blockBase[sn.lastBlock] - sn.firstCol;
+        sn.rowBlocks.swap(colStruct[sn.lastBlock-1]);
+        sn.rowBlockOffsets.resize(sn.rowBlocks.size());
+        sn.rows.clear();
+        for (size_t k = 0; k < sn.rowBlocks.size(); ++k) {
+          const int rb = sn.rowBlocks[k];
+          sn.rowBlockOffsets[k] = sn.numCols + sn.rows.size();
+          for (int i = blockBase[rb]; i < blockBase[rb+1]; ++i)
+            sn.rows.push_back(i);
+        }
+        sn.panel.resize(sn.numCols + sn.rows.size(), sn.numCols);
+        for (int i = 0; i < sn.numCols; ++i)
+          _colSupernode[sn.firstCol + i] = s;
+        _nnzL += sn.numCols * (sn.numCols + 1) / 2 + sn.rows.size() * sn.numCols;
+        maxRows = std::max(maxRows, sn.rows.size());
+      }
+
+      // where each block of A goes, in the order the blocks are visited in the numeric phase
+      _assembly.clear();
+      for (int c = 0; c < nb; ++c){
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int& r = it->first;
+          if (r > c)
+            break;
+          const int pr = blockPinv[r];
+          const int pc = blockPinv[c];
+          const int colBlock = std::min(pr, pc);
+          const int rowBlock = std::max(pr, pc);
+          AssemblyEntry e;
+          e.supernode = blockSupernode[colBlock];
+          e.transposed = pr < pc;
+          const Supernode& sn = _supernodes[e.supernode];
+          e.col = blockBase[colBlock] - sn.firstCol;
+          if (rowBlock < sn.lastBlock) {
+            e.row = blockBase[rowBlock] - sn.firstCol;
+          } else {
+            const size_t k = std::lower_bound(sn.rowBlocks.begin(), sn.rowBlocks.end(), rowBlock) - sn.rowBlocks.begin();
+            assert(k < sn.rowBlocks.size() && sn.rowBlocks[k] == rowBlock && "block of A missing in the structure of L");
+            e.row = sn.rowBlockOffsets[k];
+          }
+          _assembly.push_back(e);
+        }
+      }
+
+      _map.resize(_n);
+      _update.resize(maxRows, maxRows);
+      _y.resize(_n);
+      _gather.resize(maxRows);
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats)
+        globalStats->timeSymbolicDecomposition = get_monotonic_time() - t;
+    }
+
+    //! copies A into the panels and factorizes them, right-looking over the supernodes
+    bool computeNumericDecomposition(const SparseBlockMatrix<MatrixType>& A)
+    {
+      for (size_t s = 0; s < _supernodes.size(); ++s)
+        _supernodes[s].panel.setZero();
+
+      size_t k = 0;
+      for (size_t c = 0; c < A.blockCols().size(); ++c){
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int& r = it->first;
+          if (r > static_cast<int>(c))
+            break;
+          const AssemblyEntry& e = _assembly[k++];
+          const MatrixType& m = *(it->second);
+          PanelMatrix& panel = _supernodes[e.supernode].panel;
+          if (r == static_cast<int>(c)) {
+            for (int cc = 0; cc < m.cols(); ++cc)
+              for (int rr = cc; rr < m.rows(); ++rr)
+                panel(e.row + rr, e.col + cc) = m(rr, cc);
+          } else if (! e.transposed) {
+            panel.block(e.row, e.col, m.rows(), m.cols()) = m;
+          } else {
+            panel.block(e.row, e.col, m.cols(), m.rows()) = m.transpose();
+          }
+        }
+      }
+
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        Supernode& sn = _supernodes[s];
+        const int nc = sn.numCols;
+        const int nr = sn.rows.size();
+
+        // diagonal block, in place
+        Eigen::Ref<PanelMatrix> L11 = sn.panel.topRows(nc);
+        Eigen::LLT<Eigen::Ref<PanelMatrix>, Eigen::Lower> llt(L11);
+        if (llt.info() != Eigen::Success)
+          return false;
+        if (nr == 0)
+          continue;
+
+        // block below the diagonal: B = B * L11^-T
+        typename PanelMatrix::BlockXpr B = sn.panel.bottomRows(nr);
+        L11.template triangularView<Eigen::Lower>().transpose().template solveInPlace<Eigen::OnTheRight>(B);
+
+        // U = B * B^T (lower part) is subtracted from the supernodes owning the rows of B
+        typename PanelMatrix::BlockXpr U = _update.topLeftCorner(nr, nr);
+        U.template triangularView<Eigen::Lower>().setZero();
+        U.template selfadjointView<Eigen::Lower>().rankUpdate(B);
+
+        int p = 0;
+        while (p < nr) {
+          Supernode& tn = _supernodes[_colSupernode[sn.rows[p]]];
+          const int colEnd = tn.firstCol + tn.numCols;
+          int q = p;
+          while (q < nr && sn.rows[q] < colEnd)
+            ++q;
+
+          for (int i = 0; i < tn.numCols; ++i)
+            _map[tn.firstCol + i] = i;
+          for (size_t i = 0; i < tn.rows.size(); ++i)
+            _map[tn.rows[i]] = tn.numCols + i;
+
+          for (int jj = p; jj < q; ++jj) {
+            double* dst = &tn.panel(0, sn.rows[jj] - tn.firstCol);
+            for (int ii = jj; ii < nr; ++ii)
+              dst[_map[sn.rows[ii]]] -= U(ii, jj);
+          }
+          p = q;
+        }
+      }
+      return true;
+    }
+
+    //! L y = y
+    void solveForward()
+    {
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        const Supernode& sn = _supernodes[s];
+        const int nr = sn.rows.size();
+        VectorXD::SegmentReturnType y1 = _y.segment(sn.firstCol, sn.numCols);
+        sn.panel.topRows(sn.numCols).template triangularView<Eigen::Lower>().solveInPlace(y1);
+        if (nr == 0)
+          continue;
+        _gather.head(nr).noalias() = sn.panel.bottomRows(nr) * y1;
+        for (int i = 0; i < nr; ++i)
+          _y(sn.rows[i]) -= _gather(i);
+      }
+    }
+
+    //! L^T y = y
+    void solveBackward()
+    {
+      for (int s = static_cast<int>(_supernodes.size()) - 1; s >= 0; --s) {
+        const Supernode& sn = _supernodes[s];
+        const int nr = sn.rows.size();
+        VectorXD::SegmentReturnType y1 = _y.segment(sn.firstCol, sn.numCols);
+        if (nr > 0) {
+          for (int i = 0; i < nr; ++i)
+            _gather(i) = _y(sn.rows[i]);
+          y1.noalias() -= sn.panel.bottomRows(nr).transpose() * _gather.head(nr);
+        }
+        sn.panel.topRows(sn.numCols).template triangularView<Eigen::Lower>().transpose().solveInPlace(y1);
+      }
+    }
+};
+
+} // end namespace
+
+#endif
@@ -70,6 +70,14 @@ namespace ORB_SLAM3 {
 
         virtual Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D) = 0;
 
+        // Batch versions of project and unproject. Points are stored one coordinate per row,
+        // each row contiguous, so that the implementations vectorize over points. The outputs are resized.
+        typedef Eigen::Matrix<float,2,Eigen::Dynamic,Eigen::RowMajor> Points2f;
+        typedef Eigen::Matrix<float,3,Eigen::Dynamic,Eigen::RowMajor> Points3f;
+
+        virtual void projectBatch(const Points3f &P3D, Points2f &P2D) = 0;
+        virtual void unprojectBatch(const Points2f &P2D, Points3f &P3D) = 0;
+
         virtual bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                              Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated) = 0;
 
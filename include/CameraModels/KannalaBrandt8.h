@@ -23,6 +23,7 @@
 #include <assert.h>
 
 #include "GeometricCamera.h"
+#include "UndistortionLUT.h"
 
 #include "TwoViewReconstruction.h"
 
@@ -39,29 +40,37 @@ namespace ORB_SLAM3 {
     }
 
     public:
-        KannalaBrandt8() : precision(1e-6) {
+        KannalaBrandt8() : precision(1e-6), mpUnprojectLUT(nullptr) {
             mvParameters.resize(8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
         }
-        KannalaBrandt8(const std::vector<float> _vParameters) : GeometricCamera(_vParameters), precision(1e-6), mvLappingArea(2,0) ,tvr(nullptr) {
+        KannalaBrandt8(const std::vector<float> _vParameters) : GeometricCamera(_vParameters), precision(1e-6), mvLappingArea(2,0) ,tvr(nullptr), mpUnprojectLUT(nullptr) {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
         }
 
         KannalaBrandt8(const std::vector<float> _vParameters, const float _precision) : GeometricCamera(_vParameters),
-                                                                                        precision(_precision), mvLappingArea(2,0) {
+                                                                                        precision(_precision), mvLappingArea(2,0), mpUnprojectLUT(nullptr) {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
         }
-        KannalaBrandt8(KannalaBrandt8* pKannala) : GeometricCamera(pKannala->mvParameters), precision(pKannala->precision), mvLappingArea(2,0) ,tvr(nullptr) {
+        KannalaBrandt8(KannalaBrandt8* pKannala) : GeometricCamera(pKannala->mvParameters), precision(pKannala->precision), mvLappingArea(2,0) ,tvr(nullptr), mpUnprojectLUT(nullptr) {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
         }
 
+        ~KannalaBrandt8(){
+            if(mpUnprojectLUT) delete mpUnprojectLUT;
+        }
+
+        // The LUT is owned, a copy would delete it twice
+        KannalaBrandt8(const KannalaBrandt8&) = delete;
+        KannalaBrandt8& operator=(const KannalaBrandt8&) = delete;
+
         cv::Point2f project(const cv::Point3f &p3D);
         Eigen::Vector2d project(const Eigen::Vector3d & v3D);
         Eigen::Vector2f project(const Eigen::Vector3f & v3D);
@@ -74,6 +83,13 @@ namespace ORB_SLAM3 {
 
         Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D);
 
+        void projectBatch(const Points3f &P3D, Points2f &P2D);
+        void unprojectBatch(const Points2f &P2D, Points3f &P3D);
+
+        // Optional grid of bearing vectors every fStep pixels, evaluated once with the Newton solve.
+        // unproject and unprojectEig interpolate it instead of iterating, up to about 84 degrees off axis.
+        void SetUnprojectionLUT(const int width, const int height, const float fStep);
+
 
         bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                      Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated);
@@ -106,6 +122,8 @@ namespace ORB_SLAM3 {
 
         TwoViewReconstruction* tvr;
 
+        UndistortionLUT* mpUnprojectLUT;
+
         void Triangulate(const cv::Point2f &p1, const cv::Point2f &p2, const Eigen::Matrix<float,3,4> &Tcw1,
                          const Eigen::Matrix<float,3,4> &Tcw2, Eigen::Vector3f &x3D);
     };
@@ -22,6 +22,7 @@
 #include <assert.h>
 
 #include "GeometricCamera.h"
+#include "UndistortionLUT.h"
 
 #include "TwoViewReconstruction.h"
 
@@ -37,18 +38,18 @@ namespace ORB_SLAM3 {
     }
 
     public:
-        Pinhole() {
+        Pinhole() : mpUndistortLUT(nullptr) {
             mvParameters.resize(4);
             mnId=nNextId++;
             mnType = CAM_PINHOLE;
         }
-        Pinhole(const std::vector<float> _vParameters) : GeometricCamera(_vParameters), tvr(nullptr) {
+        Pinhole(const std::vector<float> _vParameters) : GeometricCamera(_vParameters), tvr(nullptr), mpUndistortLUT(nullptr) {
             assert(mvParameters.size() == 4);
             mnId=nNextId++;
             mnType = CAM_PINHOLE;
         }
 
-        Pinhole(Pinhole* pPinhole) : GeometricCamera(pPinhole->mvParameters), tvr(nullptr) {
+        Pinhole(Pinhole* pPinhole) : GeometricCamera(pPinhole->mvParameters), tvr(nullptr), mpUndistortLUT(nullptr) {
             assert(mvParameters.size() == 4);
             mnId=nNextId++;
             mnType = CAM_PINHOLE;
@@ -57,8 +58,13 @@ namespace ORB_SLAM3 {
 
         ~Pinhole(){
             if(tvr) delete tvr;
+            if(mpUndistortLUT) delete mpUndistortLUT;
         }
 
+        // tvr and the LUT are owned, a copy would delete them twice
+        Pinhole(const Pinhole&) = delete;
+        Pinhole& operator=(const Pinhole&) = delete;
+
         cv::Point2f project(const cv::Point3f &p3D);
         Eigen::Vector2d project(const Eigen::Vector3d & v3D);
         Eigen::Vector2f project(const Eigen::Vector3f & v3D);
@@ -71,6 +77,14 @@ namespace ORB_SLAM3 {
 
         Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D);
 
+        void projectBatch(const Points3f &P3D, Points2f &P2D);
+        void unprojectBatch(const Points2f &P2D, Points3f &P3D);
+
+        // Optional grid of undistorted pixel coordinates every fStep pixels for the distortion coefficients
+        // of the images (k1,k2,p1,p2[,k3]), evaluated once with cv::undistortPoints
+        void SetUndistortionLUT(const cv::Mat &DistCoef, const int width, const int height, const float fStep);
+        UndistortionLUT* GetUndistortionLUT() { return mpUndistortLUT; }
+
 
         bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                              Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated);
@@ -93,6 +107,8 @@ namespace ORB_SLAM3 {
         //Parameters vector corresponds to
         //      [fx, fy, cx, cy]
         TwoViewReconstruction* tvr;
+
+        UndistortionLUT* mpUndistortLUT;
     };
 }
 
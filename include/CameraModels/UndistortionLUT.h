@@ -0,0 +1,72 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAMERAMODELS_UNDISTORTIONLUT_H
+#define CAMERAMODELS_UNDISTORTIONLUT_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3 {
+    // Map from image pixels to nChannels values sampled on a regular grid and bilinearly interpolated.
+    // The camera evaluates its exact (iterative) map on the nodes once, lookups are then a few
+    // multiplications. Nodes set to NaN mark where the map must not be interpolated.
+    class UndistortionLUT {
+    public:
+        // Nodes every fStep pixels, covering [0,width]x[0,height]
+        UndistortionLUT(const int width, const int height, const float fStep, const int nChannels);
+
+        // Pixel coordinates of the nodes, row by row
+        std::vector<cv::Point2f> GetNodes() const;
+
+        // nChannels values per node, in the order of GetNodes
+        void SetValues(const std::vector<float> &vValues);
+
+        // False outside the grid or next to an invalid node, the caller then uses the exact map
+        inline bool Lookup(const float u, const float v, float* pOut) const {
+            const float gx = u * mfInvStep, gy = v * mfInvStep;
+            const int ix = static_cast<int>(gx), iy = static_cast<int>(gy);
+            if(gx < 0.f || gy < 0.f || ix >= mnCols - 1 || iy >= mnRows - 1)
+                return false;
+
+            const float ax = gx - ix, ay = gy - iy;
+            const float w00 = (1.f - ax) * (1.f - ay), w01 = ax * (1.f - ay);
+            const float w10 = (1.f - ax) * ay, w11 = ax * ay;
+            const float* p00 = &mvValues[(iy * mnCols + ix) * mnChannels];
+            const float* p10 = p00 + mnCols * mnChannels;
+
+            for(int c = 0; c < mnChannels; c++) {
+                pOut[c] = w00 * p00[c] + w01 * p00[c + mnChannels] + w10 * p10[c] + w11 * p10[c + mnChannels];
+                if(pOut[c] != pOut[c])
+                    return false;
+            }
+            return true;
+        }
+
+        int GetChannels() const { return mnChannels; }
+
+    private:
+        int mnCols, mnRows, mnChannels;
+        float mfStep, mfInvStep;
+
+        std::vector<float> mvValues;
+    };
+}
+
+#endif //CAMERAMODELS_UNDISTORTIONLUT_H
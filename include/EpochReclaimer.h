@@ -0,0 +1,132 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EPOCHRECLAIMER_H
+#define EPOCHRECLAIMER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <functional>
+
+namespace ORB_SLAM3
+{
+
+// Deferred deletion of map objects that other threads may still point to.
+//
+// Each thread that dereferences map objects is a participant and periodically declares a quiescent state,
+// a point where it keeps no pointer to a retired object: it has dropped them from the containers it keeps
+// between iterations and from the shared ones it fills. The epoch advances when every participant has been
+// quiescent in it. A retired object is deleted two full epochs after the one in which it was retired: the first
+// one makes sure every container was cleaned, the second one drains the copies taken before the cleaning.
+class EpochReclaimer
+{
+public:
+    EpochReclaimer();
+    // Deletes the objects still waiting
+    ~EpochReclaimer();
+
+    // wakeUp, if given, is called when the participant is the only one holding back reclamation
+    // (e.g. a thread waiting for work). It must make the participant reach its quiescent state soon.
+    int Register(const std::string &name, const std::function<void()> &wakeUp = std::function<void()>());
+    void Unregister(const int id);
+
+    void Quiesce(const int id);
+
+    // Takes ownership of an object already removed from the map
+    template<class T>
+    void Retire(T* pObject)
+    {
+        Retire(static_cast<void*>(pObject), &DeleteObject<T>);
+    }
+
+    // Objects waiting for their grace period, and objects deleted so far
+    size_t GetNumRetired();
+    unsigned long GetNumReclaimed();
+
+    // Process-wide reclaimer, created by System when System.ReclaimMemory is set. NULL otherwise.
+    static EpochReclaimer* GetInstance() { return mpInstance; }
+    static void SetInstance(EpochReclaimer* pReclaimer) { mpInstance = pReclaimer; }
+
+private:
+    struct Participant
+    {
+        std::string name;
+        std::function<void()> wakeUp;
+        unsigned long nEpoch;
+        bool bActive;
+        bool bWakeUpSent;
+    };
+
+    struct RetiredObject
+    {
+        void* pObject;
+        void (*deleter)(void*);
+        unsigned long nEpoch;
+    };
+
+    template<class T>
+    static void DeleteObject(void* pObject)
+    {
+        delete static_cast<T*>(pObject);
+    }
+
+    void Retire(void* pObject, void (*deleter)(void*));
+
+    // Advances the epoch if possible and moves out the objects to delete and the wake up calls to make.
+    // Requires mMutex.
+    void Collect(std::vector<RetiredObject> &vToDelete, std::vector<std::function<void()> > &vWakeUps, const int nCallerId);
+    void Release(std::vector<RetiredObject> &vToDelete, std::vector<std::function<void()> > &vWakeUps);
+
+    std::mutex mMutex;
+    unsigned long mnEpoch;
+    std::vector<Participant> mvParticipants;
+    // In retirement order, so also in epoch order
+    std::deque<RetiredObject> mdRetired;
+    unsigned long mnReclaimed;
+
+    static EpochReclaimer* mpInstance;
+};
+
+// Participant for the lifetime of the object, for tasks that never go through a quiescent state
+// (e.g. a global bundle adjustment). Does nothing when there is no reclaimer.
+class ReclaimerScope
+{
+public:
+    ReclaimerScope(const std::string &name): mpReclaimer(EpochReclaimer::GetInstance()), mnId(-1)
+    {
+        if(mpReclaimer)
+            mnId = mpReclaimer->Register(name);
+    }
+
+    ~ReclaimerScope()
+    {
+        if(mpReclaimer)
+            mpReclaimer->Unregister(mnId);
+    }
+
+private:
+    EpochReclaimer* mpReclaimer;
+    int mnId;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // EPOCHRECLAIMER_H
@@ -32,6 +32,7 @@
 
 #include "Converter.h"
 #include "Settings.h"
+#include "KeyPointGrid.h"
 
 #include <mutex>
 #include <opencv2/opencv.hpp>
@@ -49,6 +50,7 @@ class KeyFrame;
 class ConstraintPoseImu;
 class GeometricCamera;
 class ORBextractor;
+class LocalMapSnapshot;
 
 class Frame
 {
@@ -102,6 +104,11 @@ public:
     // and fill variables of the MapPoint to be used by the tracking
     bool isInFrustum(MapPoint* pMP, float viewingCosLimit);
 
+    // isInFrustum over a whole local map snapshot, projecting into both cameras when Nleft != -1.
+    // Points already seen in this frame (mnLastFrameSeen) are skipped. vVisible gets the snapshot
+    // indices of the points in the frustum of any camera, whose tracking variables are filled.
+    void isInFrustum(const LocalMapSnapshot &localMap, float viewingCosLimit, std::vector<size_t> &vVisible);
+
     bool ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v);
 
     Eigen::Vector3f inRefCoordinates(Eigen::Vector3f pCw);
@@ -249,7 +256,7 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    KeyPointGrid mGrid;
 
     IMU::Bias mPredBias;
 
@@ -341,7 +348,7 @@ public:
     std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
     //Grid for the right image
-    std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    KeyPointGrid mGridRight;
 
     Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
 
@@ -349,6 +356,9 @@ public:
     void ComputeStereoFishEyeMatches();
 
     bool isInFrustumChecks(MapPoint* pMP, float viewingCosLimit, bool bRight = false);
+    // Batch version over a snapshot for one camera, vbInView[i] is set for the points in its frustum
+    void isInFrustumChecks(const LocalMapSnapshot &localMap, float viewingCosLimit, std::vector<unsigned char> &vbInView,
+                           bool bRight = false);
 
     Eigen::Vector3f UnprojectStereoFishEye(const int &i);
 
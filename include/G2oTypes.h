@@ -764,6 +764,36 @@ public:
         Eigen::Vector3d bg, ba;
 };
 
+// Prior on gravity direction, scale and biases, e.g. the marginal of the keyframes that left a fixed-lag window.
+// Information and error are ordered as (gravity direction, log scale, gyro bias, acc bias).
+class EdgePriorInertialGS : public g2o::BaseMultiEdge<9,Vector9d>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    EdgePriorInertialGS(const Eigen::Matrix3d &Rwg_, const double &scale_, const Eigen::Vector3d &bg_,
+                        const Eigen::Vector3d &ba_, const Matrix9d &H_);
+
+    virtual bool read(std::istream& is){return false;}
+    virtual bool write(std::ostream& os) const{return false;}
+
+    void computeError();
+    virtual void linearizeOplus();
+
+    Eigen::Matrix<double,9,9> GetHessian(){
+        linearizeOplus();
+        Eigen::Matrix<double,9,9> J;
+        J.block<9,2>(0,0) = _jacobianOplus[0];
+        J.block<9,1>(0,2) = _jacobianOplus[1];
+        J.block<9,3>(0,3) = _jacobianOplus[2];
+        J.block<9,3>(0,6) = _jacobianOplus[3];
+        return J.transpose()*information()*J;
+    }
+
+    Eigen::Matrix3d Rwg;
+    double scale;
+    Eigen::Vector3d bg, ba;
+};
+
 // Priors for biases
 class EdgePriorAcc : public g2o::BaseUnaryEdge<3,Eigen::Vector3d,VertexAccBias>
 {
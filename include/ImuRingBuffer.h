@@ -0,0 +1,90 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMURINGBUFFER_H
+#define IMURINGBUFFER_H
+
+#include "ImuTypes.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+namespace ORB_SLAM3
+{
+
+// Fixed capacity queue of IMU samples between one producer (Tracking::GrabImuData) and one consumer
+// (the tracking thread). Neither side locks, except the consumer when it has to wait for samples.
+// Samples are kept in timestamp order: a sample older than the previous one is dropped.
+class ImuRingBuffer
+{
+public:
+    // The capacity is rounded up to a power of two
+    ImuRingBuffer(const size_t nCapacity = 16384);
+
+    // Producer side. Returns false, dropping the sample, if it is out of order or the buffer is full.
+    bool Push(const IMU::Point &point);
+
+    // Consumer side
+    size_t Size() const;
+    bool Empty() const { return Size()==0; }
+
+    // Discards the samples before t0 and moves the ones before t1 to vPoints. The first sample at or after t1
+    // is also copied to vPoints but stays in the buffer. Returns false if that sample has not arrived yet.
+    bool ExtractRange(const double t0, const double t1, std::vector<IMU::Point> &vPoints);
+
+    // Blocks until a sample at or after t is in the buffer, at most timeout seconds. Returns false on timeout.
+    bool WaitUntil(const double t, const double timeout);
+
+    // Consumer side. Discards the buffered samples and lets the producer restart from an older timestamp,
+    // e.g. when the sequence rolls back.
+    void Clear();
+
+    // Samples rejected by Push
+    unsigned long GetNumDropped() const { return mnDropped.load(std::memory_order_relaxed); }
+
+private:
+    bool IsAvailable(const double t) const;
+
+    const size_t mnCapacity;
+    std::vector<IMU::Point> mvPoints;
+
+    // Monotonic counters, the slot is the counter modulo the capacity.
+    // mnHead is only written by the producer, mnTail only by the consumer.
+    std::atomic<size_t> mnHead;
+    std::atomic<size_t> mnTail;
+
+    // Producer only
+    double mLastPushedT;
+    std::atomic<unsigned long> mnDropped;
+
+    // Set by Clear, consumed by the next Push
+    std::atomic<bool> mbResetRequested;
+
+    // Used only while the consumer waits
+    std::atomic<bool> mbWaiting;
+    std::mutex mMutexWait;
+    std::condition_variable mcvWait;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // IMURINGBUFFER_H
@@ -28,6 +28,7 @@
 #include <Eigen/Dense>
 #include <sophus/se3.hpp>
 #include <mutex>
+#include <atomic>
 
 #include "SerializationUtils.h"
 
@@ -169,6 +170,24 @@ class Preintegrated
     }
 
 public:
+    // Measurement to integrate, t is the integration interval
+    struct integrable
+    {
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & boost::serialization::make_array(a.data(), a.size());
+            ar & boost::serialization::make_array(w.data(), w.size());
+            ar & t;
+        }
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        integrable(){}
+        integrable(const Eigen::Vector3f &a_, const Eigen::Vector3f &w_ , const float &t_):a(a_),w(w_),t(t_){}
+        Eigen::Vector3f a, w;
+        float t;
+    };
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Preintegrated(const Bias &b_, const Calib &calib);
     Preintegrated(Preintegrated* pImuPre);
@@ -177,7 +196,12 @@ public:
     void CopyFrom(Preintegrated* pImuPre);
     void Initialize(const Bias &b_);
     void IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt);
+    // Same as integrating the measurements one by one, without the per sample overhead
+    void IntegrateNewMeasurements(const std::vector<integrable> &vMeasurements);
     void Reintegrate();
+    // Reintegrates only if the updated bias is too far from the integration one for the first order
+    // correction (GetUpdatedDelta*) to be accurate. Returns true if it reintegrated.
+    bool ReintegrateIfNeeded();
     void MergePrevious(Preintegrated* pPrev);
     void SetNewBias(const Bias &bu_);
     IMU::Bias GetDeltaBias(const Bias &b_);
@@ -199,6 +223,14 @@ public:
     Bias GetOriginalBias();
     Bias GetUpdatedBias();
 
+    // Max norm of the gyro bias change handled with the bias jacobians. The accelerometer bias enters the
+    // deltas linearly, so its jacobians are exact and it never forces a reintegration.
+    static void SetReintegrationThreshold(const float th) { mfReintegrationTh = th; }
+    static float GetReintegrationThreshold() { return mfReintegrationTh; }
+    // Calls to ReintegrateIfNeeded that reintegrated, and that kept the first order correction
+    static unsigned long GetNumReintegrations() { return mnReintegrations; }
+    static unsigned long GetNumFirstOrderUpdates() { return mnFirstOrderUpdates; }
+
     void printMeasurements() const {
         std::cout << "pint meas:\n";
         for(int i=0; i<mvMeasurements.size(); i++){
@@ -228,26 +260,16 @@ private:
     // This is used to compute the updated values of the preintegration
     Eigen::Matrix<float,6,1> db;
 
-    struct integrable
-    {
-        template<class Archive>
-        void serialize(Archive & ar, const unsigned int version)
-        {
-            ar & boost::serialization::make_array(a.data(), a.size());
-            ar & boost::serialization::make_array(w.data(), w.size());
-            ar & t;
-        }
-
-        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-        integrable(){}
-        integrable(const Eigen::Vector3f &a_, const Eigen::Vector3f &w_ , const float &t_):a(a_),w(w_),t(t_){}
-        Eigen::Vector3f a, w;
-        float t;
-    };
+    // Integrates without storing the measurements
+    void Integrate(const integrable* pMeasurements, const size_t n);
 
     std::vector<integrable> mvMeasurements;
 
     std::mutex mMutex;
+
+    static float mfReintegrationTh;
+    static std::atomic<unsigned long> mnReintegrations;
+    static std::atomic<unsigned long> mnFirstOrderUpdates;
 };
 
 // Lie Algebra Functions
@@ -31,6 +31,7 @@
 
 #include "GeometricCamera.h"
 #include "SerializationUtils.h"
+#include "ObjectPool.h"
 
 #include <mutex>
 
@@ -193,7 +194,7 @@ class KeyFrame
     }
 
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    MAKE_POOLED_OPERATOR_NEW(mPool)
     KeyFrame();
     KeyFrame(Frame &F, Map* pMap, KeyFrameDatabase* pKFDB);
 
@@ -309,6 +310,8 @@ public:
 public:
 
     static long unsigned int nNextId;
+    // Memory of all the keyframes. They are never deleted, bad keyframes stay in the spanning tree used to save trajectories.
+    static ObjectPool mPool;
     long unsigned int mnId;
     const long unsigned int mnFrameId;
 
@@ -455,7 +458,7 @@ protected:
     ORBVocabulary* mpORBvocabulary;
 
     // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    KeyPointGrid mGrid;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
@@ -515,7 +518,7 @@ public:
 
     const int NLeft, NRight;
 
-    std::vector< std::vector <std::vector<size_t> > > mGridRight;
+    KeyPointGrid mGridRight;
 
     Sophus::SE3<float> GetRightPose();
     Sophus::SE3<float> GetRightPoseInverse();
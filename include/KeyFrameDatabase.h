@@ -23,11 +23,13 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <memory>
 
 #include "KeyFrame.h"
 #include "Frame.h"
 #include "ORBVocabulary.h"
 #include "Map.h"
+#include "KeyFramePostings.h"
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
@@ -87,13 +89,18 @@ protected:
    // Associated vocabulary
    const ORBVocabulary* mpVoc;
 
-   // Inverted file
-   std::vector<list<KeyFrame*> > mvInvertedFile;
+   // Inverted file, NULL for the words no keyframe contains. Entries are replaced atomically,
+   // so the Detect* queries read them without locking mMutex
+   std::vector<std::shared_ptr<KeyFramePostings> > mvInvertedFile;
+
+   std::shared_ptr<KeyFramePostings> GetPostings(const unsigned int wordId) const;
+   // Only with mMutex locked
+   void SetPostings(const unsigned int wordId, const std::shared_ptr<KeyFramePostings> &pPostings);
 
    // For save relation without pointer, this is necessary for save/load function
    std::vector<list<long unsigned int> > mvBackupInvertedFileId;
 
-   // Mutex
+   // Serializes the writers (add, erase, clear)
    std::mutex mMutex;
 
 };
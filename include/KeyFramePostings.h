@@ -0,0 +1,72 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef KEYFRAMEPOSTINGS_H
+#define KEYFRAMEPOSTINGS_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Keyframes that contain one vocabulary word, in a fixed-capacity contiguous array. Erased entries
+// are left as NULL tombstones, the owner replaces the postings by a Compacted copy when they fill up
+// or too many entries were erased. Writers must be serialized by the owner. Readers need no lock:
+// they read Size() once and skip NULL entries, a concurrent Append or Erase is seen or not as a whole.
+class KeyFramePostings
+{
+public:
+    KeyFramePostings(const size_t nCapacity);
+
+    // Number of entries, including tombstones
+    size_t Size() const { return mnSize.load(std::memory_order_acquire); }
+
+    size_t Capacity() const { return mvpKFs.size(); }
+
+    size_t NumErased() const { return mnErased; }
+
+    // NULL if the entry was erased
+    KeyFrame* At(const size_t i) const { return mvpKFs[i].load(std::memory_order_acquire); }
+
+    // Returns false if there is no room left, the caller then appends to a Compacted copy
+    bool Append(KeyFrame* pKF);
+
+    // Tombstones the first entry equal to pKF. Returns false if it is not in the postings
+    bool Erase(KeyFrame* pKF);
+    void EraseAt(const size_t i);
+
+    // Worth compacting once half of the entries are tombstones
+    bool NeedsCompaction() const { return mnErased>=8 && 2*mnErased>=Size(); }
+
+    // New postings with the live entries in the same order and room for at least nExtra more
+    KeyFramePostings* Compacted(const size_t nExtra) const;
+
+private:
+    std::vector<std::atomic<KeyFrame*> > mvpKFs;
+    std::atomic<size_t> mnSize;
+    size_t mnErased;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // KEYFRAMEPOSTINGS_H
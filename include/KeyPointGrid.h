@@ -0,0 +1,87 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef KEYPOINTGRID_H
+#define KEYPOINTGRID_H
+
+#include <vector>
+
+#include <boost/serialization/serialization.hpp>
+#include <boost/serialization/vector.hpp>
+
+namespace ORB_SLAM3
+{
+
+// Keypoint indices bucketed in a cols x rows grid, stored in CSR form: the indices of all cells
+// in one contiguous array (cells ordered by column, then row) plus the start offset of each cell.
+// Used by Frame and KeyFrame to restrict feature matching to an image area.
+class KeyPointGrid
+{
+    friend class boost::serialization::access;
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version)
+    {
+        ar & mnCols;
+        ar & mnRows;
+        ar & mvCellStarts;
+        ar & mvIndices;
+    }
+
+public:
+    KeyPointGrid();
+
+    // Counting sort of the keypoints into the grid. vCells[i] is the cell of keypoint i
+    // (posX*nRows+posY) or -1 if it falls outside. Indices inside a cell stay in increasing order.
+    void Build(const int nCols, const int nRows, const std::vector<int> &vCells);
+
+    // True until Build is called
+    bool empty() const { return mvCellStarts.empty(); }
+
+    int GetCols() const { return mnCols; }
+    int GetRows() const { return mnRows; }
+
+    // Keypoint indices of cell (posX,posY) are in [CellBegin,CellEnd)
+    const unsigned int* CellBegin(const int posX, const int posY) const
+    {
+        return mvIndices.data() + mvCellStarts[posX*mnRows+posY];
+    }
+
+    const unsigned int* CellEnd(const int posX, const int posY) const
+    {
+        return mvIndices.data() + mvCellStarts[posX*mnRows+posY+1];
+    }
+
+    size_t CellSize(const int posX, const int posY) const
+    {
+        return mvCellStarts[posX*mnRows+posY+1] - mvCellStarts[posX*mnRows+posY];
+    }
+
+private:
+    int mnCols;
+    int mnRows;
+
+    // nCols*nRows+1 offsets into mvIndices
+    std::vector<unsigned int> mvCellStarts;
+    std::vector<unsigned int> mvIndices;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // KEYPOINTGRID_H
@@ -0,0 +1,62 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LOCALMAPSNAPSHOT_H
+#define LOCALMAPSNAPSHOT_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+class MapPoint;
+
+// Structure-of-arrays copy of the local map tracked by Tracking, taken once per local map update.
+// The visibility test and the projection search of the current frame read these packed arrays
+// instead of locking every MapPoint for its position, normal, distances and descriptor.
+class LocalMapSnapshot
+{
+public:
+    // Copies the good points of vpMapPoints, taking each MapPoint mutex once
+    void Build(const std::vector<MapPoint*> &vpMapPoints);
+
+    void clear();
+
+    size_t size() const { return mvpMapPoints.size(); }
+
+    std::vector<MapPoint*> mvpMapPoints;
+    // MapPoint mnId, keys the projections of the frame (Frame::mmProjectPoints)
+    std::vector<long unsigned int> mvnIds;
+
+    // World positions and normals, one array per coordinate
+    std::vector<float> mvX, mvY, mvZ;
+    std::vector<float> mvNx, mvNy, mvNz;
+
+    // Distance bounds of the scale invariance region (MapPoint mfMinDistance, mfMaxDistance)
+    std::vector<float> mvMinDistance;
+    std::vector<float> mvMaxDistance;
+
+    // Row i is the descriptor of mvpMapPoints[i]
+    cv::Mat mDescriptors;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // LOCALMAPSNAPSHOT_H
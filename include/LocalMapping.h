@@ -26,8 +26,11 @@
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
 #include "Settings.h"
+#include "EpochReclaimer.h"
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
 
 #include <mutex>
+#include <condition_variable>
 
 
 namespace ORB_SLAM3
@@ -62,12 +65,17 @@ public:
     void Release();
     bool isStopped();
     bool stopRequested();
+    // Blocks until Local Mapping has stopped (or finished) after RequestStop
+    void WaitUntilStopped();
     bool AcceptKeyFrames();
     void SetAcceptKeyFrames(bool flag);
     bool SetNotStop(bool flag);
 
     void InterruptBA();
 
+    // Called when a global BA has published its solution, the thread applies it between keyframes
+    void InformGlobalBASolution();
+
     void RequestFinish();
     bool isFinished();
 
@@ -93,6 +101,10 @@ public:
     unsigned int mInitSect;
     unsigned int mIdxInit;
     unsigned int mnKFs;
+
+    // Estimate gravity, scale and biases over the keyframes added since the previous initialization stage,
+    // with the older ones summarized by a prior, instead of over the whole map
+    bool mbFixedLagInertialInit;
     double mFirstTs;
     int mnMatchesInliers;
 
@@ -135,6 +147,18 @@ protected:
     void ProcessNewKeyFrame();
     void CreateNewMapPoints();
 
+    // Point triangulated from keypoint idx1 of the current keyframe and keypoint idx2 of a neighbor
+    struct TriangulatedPoint
+    {
+        Eigen::Vector3f x3D;
+        size_t idx1;
+        size_t idx2;
+    };
+
+    // Matches the current keyframe with pKF2 and triangulates the matches that pass the parallax,
+    // reprojection and scale checks. Does not modify the map, so it runs in parallel over the neighbors.
+    void TriangulateWithNeighbor(KeyFrame* pKF2, std::vector<TriangulatedPoint> &vTriangulated);
+
     void MapPointCulling();
     void SearchInNeighbors();
     void KeyFrameCulling();
@@ -149,6 +173,7 @@ protected:
     bool mbResetRequestedActiveMap;
     Map* mpMapToReset;
     std::mutex mMutexReset;
+    std::condition_variable mcvReset;
 
     bool CheckFinish();
     void SetFinish();
@@ -169,12 +194,29 @@ protected:
 
     std::mutex mMutexNewKFs;
 
+    // The main loop sleeps on mcvNewKFs until a keyframe is queued or another
+    // thread sets mbWakeUp (stop, release, reset or finish request)
+    void WaitForWork();
+    void WakeUp();
+    std::condition_variable mcvNewKFs;
+    bool mbWakeUp;
+
+    // Deletion of culled points, NULL if disabled. Before waiting for work the thread drops the
+    // bad points of mlpRecentAddedMapPoints and of the queued keyframes and reports a quiescent state.
+    void EnterQuiescentState();
+    EpochReclaimer* mpReclaimer;
+    int mnReclaimerId;
+
     bool mbAbortBA;
 
+    // Optimizer reused by every LocalBundleAdjustment call of this thread
+    g2o::SparseOptimizer* mpLocalBAOptimizer;
+
     bool mbStopped;
     bool mbStopRequested;
     bool mbNotStop;
     std::mutex mMutexStop;
+    std::condition_variable mcvStop;
 
     bool mbAcceptKeyFrames;
     std::mutex mMutexAccept;
@@ -184,7 +226,13 @@ protected:
 
     bool bInitializing;
 
+    // Prior on (gravity direction, scale, gyro bias, acc bias) from the keyframes up to mnInertialPriorKFId of
+    // mpInertialPriorMap, used by the fixed-lag initialization
     Eigen::MatrixXd infoInertial;
+    Map* mpInertialPriorMap;
+    unsigned long mnInertialPriorKFId;
+    // Keyframes of vpKF not summarized by the prior yet, preceded by the newest one that is
+    std::vector<KeyFrame*> GetInertialWindow(const std::vector<KeyFrame*> &vpKF);
     int mNumLM;
     int mNumKFCulling;
 
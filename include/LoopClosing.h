@@ -27,10 +27,13 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "EpochReclaimer.h"
 
 #include <boost/algorithm/string.hpp>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h"
 
 namespace ORB_SLAM3
@@ -69,6 +72,10 @@ public:
     // This function will run in a separate thread
     void RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoopKF);
 
+    // Updates the map with the solution published by the last global BA, if it has not been applied yet.
+    // Only Local Mapping, between keyframes, or Loop Closing, while Local Mapping is stopped, may call it.
+    void ApplyGlobalBundleAdjustment();
+
     bool isRunningGBA(){
         unique_lock<std::mutex> lock(mMutexGBA);
         return mbRunningGBA;
@@ -111,6 +118,9 @@ public:
     vector<int> vnGBAMPs;
     int nFGBA_exec;
     int nFGBA_abort;
+    // Solutions applied to the map, finished ones (by Local Mapping) and aborted ones (by Loop Closing)
+    int nFGBA_applied;
+    int nFGBA_appliedAborted;
 
 #endif
 
@@ -149,6 +159,7 @@ protected:
     bool mbResetActiveMapRequested;
     Map* mpMapToReset;
     std::mutex mMutexReset;
+    std::condition_variable mcvReset;
 
     bool CheckFinish();
     void SetFinish();
@@ -168,6 +179,20 @@ protected:
 
     std::mutex mMutexLoopQueue;
 
+    // The main loop sleeps on mcvLoopQueue until a keyframe is queued or
+    // another thread sets mbWakeUp (reset or finish request)
+    void WaitForWork();
+    void WakeUp();
+    std::condition_variable mcvLoopQueue;
+    bool mbWakeUp;
+
+    // Deletion of culled points, NULL if disabled. Before waiting for work the thread drops the bad
+    // points kept from the previous keyframe (loop and merge candidates) and reports a quiescent state.
+    // A global BA registers on its own while it runs.
+    void EnterQuiescentState();
+    EpochReclaimer* mpReclaimer;
+    int mnReclaimerId;
+
     // Loop detector parameters
     float mnCovisibilityConsistencyTh;
 
@@ -213,19 +238,32 @@ protected:
     long unsigned int mLastLoopKFid;
 
     // Variables related to Global Bundle Adjustment
+    // Only the Loop Closing thread launches and stops the BA, so mpThreadGBA is not protected
+    void LaunchGlobalBundleAdjustment(Map* pMap, unsigned long nLoopKF);
+    // Aborts the running BA and waits for its thread. Its partial solution is kept for ApplyGlobalBundleAdjustment.
+    void StopGlobalBundleAdjustment();
     bool mbRunningGBA;
     bool mbFinishedGBA;
     bool mbStopGBA;
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
 
+    // Solution of the last BA, finished or aborted, waiting to be applied. It lives in the mTcwGBA, mPosGBA...
+    // fields of the keyframes and points marked with mnGBALoopKF.
+    bool mbGBASolutionReady;
+    Map* mpGBAMap;
+    unsigned long mnGBALoopKF;
+    bool mbGBAImuInit;
+    bool mbGBAAborted;
+    int mnGBAIterations;
+#ifdef REGISTER_TIMES
+    std::chrono::steady_clock::time_point mTimeStartGBA;
+#endif
+
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
 
 
-    bool mnFullBAIdx;
-
-
 
     vector<double> vdPR_CurrentTime;
     vector<double> vdPR_MatchedTime;
@@ -26,6 +26,8 @@
 #include "Converter.h"
 
 #include "SerializationUtils.h"
+#include "StripedMutex.h"
+#include "ObjectPool.h"
 
 #include <opencv2/core/core.hpp>
 #include <mutex>
@@ -104,7 +106,7 @@ class MapPoint
 
 
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    MAKE_POOLED_OPERATOR_NEW(mPool)
     MapPoint();
 
     MapPoint(const Eigen::Vector3f &Pos, KeyFrame* pRefKF, Map* pMap);
@@ -144,11 +146,15 @@ public:
     void ComputeDistinctiveDescriptors();
 
     cv::Mat GetDescriptor();
+    // Copies the 32 byte descriptor to pDesc, unless the point is bad (returns false)
+    bool CopyDescriptor(unsigned char* pDesc);
 
     void UpdateNormalAndDepth();
 
     float GetMinDistanceInvariance();
     float GetMaxDistanceInvariance();
+    // Consistent copy of position, normal and scale invariance distances (mfMinDistance, mfMaxDistance)
+    void GetPosNormalDistances(Eigen::Vector3f &pos, Eigen::Vector3f &normal, float &minDistance, float &maxDistance);
     int PredictScale(const float &currentDist, KeyFrame*pKF);
     int PredictScale(const float &currentDist, Frame* pF);
 
@@ -207,6 +213,9 @@ public:
 
     unsigned int mnOriginMapId;
 
+    // Memory of all the points
+    static ObjectPool mPool;
+
 protected:    
 
      // Position in absolute coordinates
@@ -224,6 +233,17 @@ protected:
      // Best descriptor to fast matching
      cv::Mat mDescriptor;
 
+     // Observations (keyframe, keypoint index) used in the last ComputeDistinctiveDescriptors, one per row,
+     // the Hamming distances between their descriptors (saturated at 255) and each row sorted, to read its median
+     // directly. Both tables are row-major with mnDescriptorStride columns. A new observation appends a row and a
+     // column, a removed one is swapped with the last. Dropped above MAX_CACHED_DESCRIPTORS observations, where
+     // they would take more than 512KB. Not serialized.
+     std::vector<std::pair<KeyFrame*,int> > mvDescriptorKeys;
+     std::vector<uint8_t> mvDescriptorDistances;
+     std::vector<uint8_t> mvDescriptorSortedDistances;
+     size_t mnDescriptorStride;
+     static const size_t MAX_CACHED_DESCRIPTORS;
+
      // Reference KeyFrame
      KeyFrame* mpRefKF;
      long unsigned int mBackupRefKFId;
@@ -232,7 +252,7 @@ protected:
      int mnVisible;
      int mnFound;
 
-     // Bad flag (we do not currently erase MapPoint from memory)
+     // Bad flag. A bad point is deleted later only if there is an EpochReclaimer (System.ReclaimMemory)
      bool mbBad;
      MapPoint* mpReplaced;
      // For save relation without pointer, this is necessary for save/load function
@@ -244,10 +264,25 @@ protected:
 
      Map* mpMap;
 
-     // Mutex
-     std::mutex mMutexPos;
-     std::mutex mMutexFeatures;
-     std::mutex mMutexMap;
+     // Mutex. They come from pools shared by all the points (the address selects the stripe),
+     // so a point does not carry its own. Never hold the same kind of lock of two points at once.
+     StripedMutex& MutexPos() { return mPosMutexes.Get(this); }
+     StripedMutex& MutexFeatures() { return mFeaturesMutexes.Get(this); }
+     StripedMutex& MutexMap() { return mMapMutexes.Get(this); }
+     StripedMutex& MutexDescriptors() { return mDescriptorsMutexes.Get(this); }
+
+     // Maintenance of the descriptor distance tables, called with MutexDescriptors held
+     void ClearDescriptorCache();
+     void RemoveDescriptorRow(const size_t r);
+     void AddDescriptorRow(const std::pair<KeyFrame*,int> &key);
+
+     static MutexStripes<1024> mPosMutexes;
+     static MutexStripes<1024> mFeaturesMutexes;
+     static MutexStripes<256> mMapMutexes;
+     static MutexStripes<256> mDescriptorsMutexes;
+
+     // Position, normal and distances are written under MutexPos() and read without locking
+     SeqLock mPosSeq;
 
 };
 
@@ -27,6 +27,8 @@
 namespace ORB_SLAM3
 {
 
+class ThreadPool;
+
 class ExtractorNode
 {
 public:
@@ -58,6 +60,11 @@ public:
                     std::vector<cv::KeyPoint>& _keypoints,
                     cv::OutputArray _descriptors, std::vector<int> &vLappingArea);
 
+    // Run the per-level keypoint detection, orientation and descriptor passes on a worker pool.
+    // The output is identical to the serial path. NULL (default) extracts in the calling thread.
+    void SetThreadPool(ThreadPool* pThreadPool){
+        mpThreadPool = pThreadPool;}
+
     int inline GetLevels(){
         return nlevels;}
 
@@ -86,6 +93,7 @@ protected:
 
     void ComputePyramid(cv::Mat image);
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);    
+    void ComputeKeyPointsLevel(const int level, std::vector<cv::KeyPoint>& keypoints);
     std::vector<cv::KeyPoint> DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
                                            const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
 
@@ -106,6 +114,8 @@ protected:
     std::vector<float> mvInvScaleFactor;    
     std::vector<float> mvLevelSigma2;
     std::vector<float> mvInvLevelSigma2;
+
+    ThreadPool* mpThreadPool;
 };
 
 } //namespace ORB_SLAM
@@ -33,6 +33,8 @@
 namespace ORB_SLAM3
 {
 
+    class LocalMapSnapshot;
+
     class ORBmatcher
     {
     public:
@@ -42,10 +44,26 @@ namespace ORB_SLAM3
         // Computes the Hamming distance between two ORB descriptors
         static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
+        // Computes the Hamming distances between descriptor a and the rows vIndices[i]+offset of B (one-to-many).
+        // vDist[i] is the distance to row vIndices[i]+offset. Uses the widest popcount available on the running CPU.
+        static void DescriptorDistances(const cv::Mat &a, const cv::Mat &B, const std::vector<size_t> &vIndices, std::vector<int> &vDist, const size_t offset = 0);
+        static void DescriptorDistances(const cv::Mat &a, const cv::Mat &B, const std::vector<unsigned int> &vIndices, std::vector<int> &vDist);
+
+        // Computes the Hamming distances between every row of A and every row of B (many-to-many).
+        // D is a A.rows x B.rows CV_32S matrix.
+        static void DescriptorDistances(const cv::Mat &A, const cv::Mat &B, cv::Mat &D);
+
+        // Computes the Hamming distances between descriptor pa and the n descriptors ppb[i] (32 bytes each),
+        // which do not need to live in the same matrix. pDist[i] is the distance to ppb[i].
+        static void DescriptorDistances(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist);
+
         // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
         // Used to track the local map (Tracking)
         int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3, const bool bFarPoints = false, const float thFarPoints = 50.0f);
 
+        // Same search over a local map snapshot, reading the descriptors from the snapshot
+        int SearchByProjection(Frame &F, const LocalMapSnapshot &localMap, const float th=3, const bool bFarPoints = false, const float thFarPoints = 50.0f);
+
         // Project MapPoints tracked in last frame into the current frame and search matches.
         // Used to track from previous frame (Tracking)
         int SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th, const bool bMono);
@@ -83,6 +101,13 @@ namespace ORB_SLAM3
         // Project MapPoints into KeyFrame and search for duplicated MapPoints.
         int Fuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, const float th=3.0, const bool bRight = false);
 
+        // The two steps of Fuse. SearchFuse only reads the map: it appends to vFuse each MapPoint that
+        // duplicates a keypoint of pKF, with that keypoint index, so searches on different keyframes can
+        // run in parallel. ApplyFuse then adds the observations or replaces the duplicated MapPoints in
+        // the order of vFuse, skipping the points that an earlier fusion made bad. Returns the number fused.
+        void SearchFuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<MapPoint*,size_t> > &vFuse, const float th=3.0, const bool bRight = false);
+        int ApplyFuse(KeyFrame* pKF, const vector<pair<MapPoint*,size_t> > &vFuse);
+
         // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints.
         int Fuse(KeyFrame* pKF, Sophus::Sim3f &Scw, const std::vector<MapPoint*> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint);
 
@@ -96,6 +121,10 @@ namespace ORB_SLAM3
     protected:
         float RadiusByViewingCos(const float &viewCos);
 
+        // Projection search of the local map. If pDescriptors is given, its row i is the
+        // descriptor of vpMapPoints[i]; otherwise the descriptors are read from the MapPoints
+        int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const cv::Mat* pDescriptors, const float th, const bool bFarPoints, const float thFarPoints);
+
         void ComputeThreeMaxima(std::vector<int>* histo, const int L, int &ind1, int &ind2, int &ind3);
 
         float mfNNratio;
@@ -0,0 +1,91 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <new>
+#include <cstddef>
+
+#include <Eigen/Core>
+
+namespace ORB_SLAM3
+{
+
+// Fixed size allocator for the objects of one class. Slots are carved from slabs of nSlotsPerSlab
+// objects, aligned to a cache line, and freed slots are reused by later allocations.
+// Slabs are only given back to the system when the pool is destroyed.
+class ObjectPool
+{
+public:
+    struct Stats
+    {
+        std::string name;
+        size_t nSlotSize;
+        size_t nLive;       // Allocated objects
+        size_t nFree;       // Slots ready for reuse
+        size_t nSlabs;
+        size_t nBytes;      // Memory held by the slabs
+        unsigned long nAllocated;
+        unsigned long nReleased;
+    };
+
+    ObjectPool(const std::string &name, const size_t nObjectSize, const size_t nSlotsPerSlab);
+    ~ObjectPool();
+
+    void* Allocate(const size_t nSize);
+    void Deallocate(void* p);
+
+    Stats GetStats();
+
+private:
+    void AddSlab();
+
+    static const size_t mnAlignment = 64;
+
+    const std::string mName;
+    const size_t mnSlotSize;
+    const size_t mnSlotsPerSlab;
+
+    std::mutex mMutex;
+    // Raw slab allocations and head of the free slot list (the next pointer is stored in the slot)
+    std::vector<void*> mvpSlabs;
+    void* mpFreeList;
+    size_t mnFree;
+    unsigned long mnAllocated;
+    unsigned long mnReleased;
+};
+
+} //namespace ORB_SLAM3
+
+// Class specific new/delete taking the objects from the static ObjectPool Pool.
+// Replaces EIGEN_MAKE_ALIGNED_OPERATOR_NEW, the pool slots satisfy Eigen alignment.
+#define MAKE_POOLED_OPERATOR_NEW(Pool) \
+    void* operator new(std::size_t size) { return Pool.Allocate(size); } \
+    void operator delete(void* ptr) { Pool.Deallocate(ptr); } \
+    void operator delete(void* ptr, std::size_t) { Pool.Deallocate(ptr); } \
+    void* operator new[](std::size_t size) { return Eigen::internal::conditional_aligned_malloc<true>(size); } \
+    void operator delete[](void* ptr) { Eigen::internal::conditional_aligned_free<true>(ptr); } \
+    static void* operator new(std::size_t size, void* ptr) { return ::operator new(size,ptr); } \
+    void operator delete(void* memory, void* ptr) { return ::operator delete(memory,ptr); }
+
+#endif // OBJECTPOOL_H
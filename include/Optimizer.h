@@ -34,6 +34,7 @@
 #include "Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h"
 #include "Thirdparty/g2o/g2o/core/optimization_algorithm_gauss_newton.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_supernodal.h"
 #include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
 #include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_dense.h"
@@ -47,14 +48,23 @@ class Optimizer
 {
 public:
 
-    void static BundleAdjustment(const std::vector<KeyFrame*> &vpKF, const std::vector<MapPoint*> &vpMP,
+    // The global BAs return the number of iterations done, fewer than requested if pbStopFlag was raised.
+    // The estimates are recovered in any case, an interrupted optimization leaves the best one found so far.
+    int static BundleAdjustment(const std::vector<KeyFrame*> &vpKF, const std::vector<MapPoint*> &vpMP,
                                  int nIterations = 5, bool *pbStopFlag=NULL, const unsigned long nLoopKF=0,
                                  const bool bRobust = true);
-    void static GlobalBundleAdjustemnt(Map* pMap, int nIterations=5, bool *pbStopFlag=NULL,
+    int static GlobalBundleAdjustemnt(Map* pMap, int nIterations=5, bool *pbStopFlag=NULL,
                                        const unsigned long nLoopKF=0, const bool bRobust = true);
-    void static FullInertialBA(Map *pMap, int its, const bool bFixLocal=false, const unsigned long nLoopKF=0, bool *pbStopFlag=NULL, bool bInit=false, float priorG = 1e2, float priorA=1e6, Eigen::VectorXd *vSingVal = NULL, bool *bHess=NULL);
+    // With nFirstFreeKFid, keyframes with a lower id stay fixed and only points seen after them are optimized.
+    // pInertialPrior is the fixed-lag prior on those keyframes (see FixedLagInertialOptimization), its bias part
+    // constrains the common biases of bInit.
+    int static FullInertialBA(Map *pMap, int its, const bool bFixLocal=false, const unsigned long nLoopKF=0, bool *pbStopFlag=NULL, bool bInit=false, float priorG = 1e2, float priorA=1e6, Eigen::VectorXd *vSingVal = NULL, bool *bHess=NULL,
+                              const unsigned long nFirstFreeKFid=0, const Eigen::MatrixXd *pInertialPrior=NULL);
 
-    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges);
+    // pOptimizer is an optional workspace kept by the caller between calls: its solver, and the
+    // symbolic factorization when the sparsity pattern did not change, are reused
+    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges,
+                                      g2o::SparseOptimizer* pOptimizer = static_cast<g2o::SparseOptimizer*>(NULL));
 
     int static PoseOptimization(Frame* pFrame);
     int static PoseInertialOptimizationLastKeyFrame(Frame* pFrame, bool bRecInit = false);
@@ -98,6 +108,14 @@ public:
     void static InertialOptimization(Map *pMap, Eigen::Vector3d &bg, Eigen::Vector3d &ba, float priorG = 1e2, float priorA = 1e6);
     void static InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &scale);
 
+    // Fixed-lag versions of the inertial-only optimizations above. vpKFs are the keyframes of the window in temporal
+    // order. Older keyframes are summarized by infoPrior, the information on (gravity direction, scale, gyro bias,
+    // acc bias) around the input values (zero if there is no prior). With a prior, the first keyframe is the newest
+    // one of the previous window and keeps its velocity. On output infoPrior summarizes the window as well.
+    void static FixedLagInertialOptimization(Map *pMap, const vector<KeyFrame*> &vpKFs, Eigen::Matrix3d &Rwg, double &scale, Eigen::Vector3d &bg, Eigen::Vector3d &ba, bool bMono, Eigen::MatrixXd &infoPrior, float priorG = 1e2, float priorA = 1e6);
+    // Velocities and biases fixed
+    void static FixedLagInertialOptimization(const vector<KeyFrame*> &vpKFs, Eigen::Matrix3d &Rwg, double &scale, Eigen::MatrixXd &infoPrior);
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 };
 
@@ -83,6 +83,7 @@ namespace ORB_SLAM3 {
         bool rgb() {return bRGB_;}
         bool needToResize() {return bNeedToResize1_;}
         bool needToRectify() {return bNeedToRectify_;}
+        float undistortionLUTStep() {return undistortionLUTStep_;}
 
         float noiseGyro() {return noiseGyro_;}
         float noiseAcc() {return noiseAcc_;}
@@ -91,6 +92,9 @@ namespace ORB_SLAM3 {
         float imuFrequency() {return imuFrequency_;}
         Sophus::SE3f Tbc() {return Tbc_;}
         bool insertKFsWhenLost() {return insertKFsWhenLost_;}
+        float imuWaitTimeout() {return imuWaitTimeout_;}
+        float imuReintegrationThreshold() {return imuReintegrationTh_;}
+        bool fixedLagImuInit() {return fixedLagImuInit_;}
 
         float depthMapFactor() {return depthMapFactor_;}
 
@@ -99,6 +103,7 @@ namespace ORB_SLAM3 {
         float initThFAST() {return initThFAST_;}
         float minThFAST() {return minThFAST_;}
         float scaleFactor() {return scaleFactor_;}
+        bool parallelExtraction() {return bParallelExtraction_;}
 
         float keyFrameSize() {return keyFrameSize_;}
         float keyFrameLineWidth() {return keyFrameLineWidth_;}
@@ -116,6 +121,8 @@ namespace ORB_SLAM3 {
         std::string atlasSaveFile() {return sSaveto_;}
 
         float thFarPoints() {return thFarPoints_;}
+        int nThreads() {return nThreads_;}
+        bool reclaimMemory() {return bReclaimMemory_;}
 
         cv::Mat M1l() {return M1l_;}
         cv::Mat M2l() {return M2l_;}
@@ -169,6 +176,7 @@ namespace ORB_SLAM3 {
         cv::Size originalImSize_, newImSize_;
         float fps_;
         bool bRGB_;
+        float undistortionLUTStep_;
 
         bool bNeedToUndistort_;
         bool bNeedToRectify_;
@@ -192,6 +200,9 @@ namespace ORB_SLAM3 {
         float imuFrequency_;
         Sophus::SE3f Tbc_;
         bool insertKFsWhenLost_;
+        float imuWaitTimeout_;
+        float imuReintegrationTh_;
+        bool fixedLagImuInit_;
 
         /*
          * RGBD stuff
@@ -205,6 +216,7 @@ namespace ORB_SLAM3 {
         float scaleFactor_;
         int nLevels_;
         int initThFAST_, minThFAST_;
+        bool bParallelExtraction_;
 
         /*
          * Viewer stuff
@@ -227,6 +239,8 @@ namespace ORB_SLAM3 {
          * Other stuff
          */
         float thFarPoints_;
+        int nThreads_;
+        bool bReclaimMemory_;
 
     };
 };
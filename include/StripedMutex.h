@@ -0,0 +1,124 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STRIPEDMUTEX_H
+#define STRIPEDMUTEX_H
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+namespace ORB_SLAM3
+{
+
+// Mutex on its own cache line. lock() counts the times it had to wait for another thread.
+class alignas(64) StripedMutex
+{
+public:
+    void lock()
+    {
+        if(!mMutex.try_lock())
+        {
+            mnContended.fetch_add(1,std::memory_order_relaxed);
+            mMutex.lock();
+        }
+    }
+
+    bool try_lock()
+    {
+        return mMutex.try_lock();
+    }
+
+    void unlock()
+    {
+        mMutex.unlock();
+    }
+
+    // Number of contended lock() calls, summed over all the striped mutexes
+    static unsigned long GetContentionCount();
+    static void ResetContentionCount();
+
+private:
+    std::mutex mMutex;
+
+    static std::atomic<unsigned long> mnContended;
+};
+
+// Fixed pool of N mutexes shared by many objects, the object address selects the stripe.
+// Two objects may share a stripe, so a thread must never hold two stripes of the same pool at once.
+template<size_t N>
+class MutexStripes
+{
+    static_assert(N>0 && (N&(N-1))==0, "The number of stripes must be a power of two");
+
+public:
+    StripedMutex& Get(const void* pObject)
+    {
+        // Drop the alignment bits and mix the rest (Fibonacci hashing)
+        uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pObject) >> 4);
+        h *= 0x9E3779B97F4A7C15ull;
+        return mvMutexes[(h >> 32) & (N-1)];
+    }
+
+private:
+    StripedMutex mvMutexes[N];
+};
+
+// Sequence counter for data that is written under a lock and read without it.
+// Writers (serialized by their own lock) wrap the update in BeginWrite/EndWrite.
+// Readers copy the data between BeginRead and Retry, and copy again while Retry returns true.
+class SeqLock
+{
+public:
+    SeqLock(): mnSeq(0) {}
+
+    void BeginWrite()
+    {
+        mnSeq.store(mnSeq.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndWrite()
+    {
+        mnSeq.store(mnSeq.load(std::memory_order_relaxed)+1,std::memory_order_release);
+    }
+
+    unsigned int BeginRead() const
+    {
+        unsigned int seq;
+        while((seq=mnSeq.load(std::memory_order_acquire)) & 1)
+            std::this_thread::yield();
+        return seq;
+    }
+
+    bool Retry(const unsigned int seq) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return mnSeq.load(std::memory_order_relaxed)!=seq;
+    }
+
+private:
+    std::atomic<unsigned int> mnSeq;
+};
+
+} //namespace ORB_SLAM
+
+#endif // STRIPEDMUTEX_H
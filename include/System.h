@@ -39,6 +39,8 @@
 #include "Viewer.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "ThreadPool.h"
+#include "EpochReclaimer.h"
 
 
 namespace ORB_SLAM3
@@ -174,6 +176,7 @@ public:
     // Information from most recent processed frame
     // You can call this right after TrackMonocular (or stereo or RGBD)
     int GetTrackingState();
+    // With System.ReclaimMemory the points may be deleted once the next frame has been tracked
     std::vector<MapPoint*> GetTrackedMapPoints();
     std::vector<cv::KeyPoint> GetTrackedKeyPointsUn();
 
@@ -236,6 +239,14 @@ private:
     std::thread* mptLoopClosing;
     std::thread* mptViewer;
 
+    // Shared worker pool for the parallel sections of all threads (ORB extraction, stereo
+    // left/right extraction, two view reconstruction, ...). Registered as ThreadPool::GetInstance().
+    ThreadPool* mpThreadPool;
+
+    // Deletes culled map points once no thread can reach them (System.ReclaimMemory).
+    // NULL when disabled, then bad points stay in memory. Registered as EpochReclaimer::GetInstance().
+    EpochReclaimer* mpReclaimer;
+
     // Reset flag
     std::mutex mMutexReset;
     bool mbReset;
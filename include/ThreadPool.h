@@ -0,0 +1,77 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace ORB_SLAM3
+{
+
+class ThreadPool
+{
+public:
+    // Creates nThreads worker threads that live until the pool is destroyed.
+    // With nThreads=0 every task runs in the calling thread. With two or more threads, one of them
+    // only runs high priority tasks, so these never wait behind a long ParallelFor of the mapping threads.
+    ThreadPool(const int nThreads);
+    ~ThreadPool();
+
+    // Queues a high priority task, served before any ParallelFor helper of normal priority.
+    // Meant for the latency sensitive work of the tracking thread. The future becomes ready once the task has run.
+    // Do not wait on it from inside another pool task, use ParallelFor instead.
+    std::future<void> Submit(const std::function<void()> &task);
+
+    // Runs f(i) for every i in [begin,end) and returns when all of them have finished.
+    // The calling thread also executes iterations, so nested calls from inside a task cannot deadlock.
+    // The tracking thread sets bHighPriority so that its helpers go ahead of the mapping ones.
+    void ParallelFor(const int begin, const int end, const std::function<void(int)> &f, const bool bHighPriority = false);
+
+    int GetNumThreads() const { return mvWorkers.size(); }
+
+    // Process-wide pool, created by System from the settings file. NULL if no System exists.
+    static ThreadPool* GetInstance() { return mpInstance; }
+    static void SetInstance(ThreadPool* pThreadPool) { mpInstance = pThreadPool; }
+
+private:
+    void Run(const bool bReserved);
+
+    std::vector<std::thread> mvWorkers;
+
+    std::deque<std::function<void()> > mqPriorityTasks;
+    std::deque<std::function<void()> > mqTasks;
+    std::mutex mMutexQueue;
+    // Workers that take any task wait on mcvQueue, the reserved worker on mcvPriority
+    std::condition_variable mcvQueue;
+    std::condition_variable mcvPriority;
+    bool mbFinish;
+
+    static ThreadPool* mpInstance;
+};
+
+} //namespace ORB_SLAM3
+
+#endif // THREADPOOL_H
@@ -32,14 +32,19 @@
 #include "ORBVocabulary.h"
 #include "KeyFrameDatabase.h"
 #include "ORBextractor.h"
+#include "ThreadPool.h"
+#include "LocalMapSnapshot.h"
+#include "EpochReclaimer.h"
 #include "MapDrawer.h"
 #include "System.h"
 #include "ImuTypes.h"
+#include "ImuRingBuffer.h"
 #include "Settings.h"
 
 #include "GeometricCamera.h"
 
 #include <mutex>
+#include <condition_variable>
 #include <unordered_set>
 
 namespace ORB_SLAM3
@@ -206,6 +211,8 @@ protected:
     void CreateInitialMapMonocular();
 
     void CheckReplacedInLastFrame();
+    // End of a frame for the EpochReclaimer: drops the bad points kept in mLastFrame
+    void EnterQuiescentState();
     bool TrackReferenceKeyFrame();
     void UpdateLastFrame();
     bool TrackWithMotionModel();
@@ -235,11 +242,12 @@ protected:
     IMU::Preintegrated *mpImuPreintegratedFromLastKF;
 
     // Queue of IMU measurements between frames
-    std::list<IMU::Point> mlQueueImuData;
+    ImuRingBuffer mImuBuffer;
 
     // Vector of IMU measurements from previous to current frame (to be filled by PreintegrateIMU)
     std::vector<IMU::Point> mvImuFromLastFrame;
-    std::mutex mMutexImuQueue;
+    // Interpolated measurements integrated in one batch by both preintegrations
+    std::vector<IMU::Preintegrated::integrable> mvImuToIntegrate;
 
     // Imu calibration parameters
     IMU::Calib *mpImuCalib;
@@ -273,6 +281,8 @@ protected:
     KeyFrame* mpReferenceKF;
     std::vector<KeyFrame*> mvpLocalKeyFrames;
     std::vector<MapPoint*> mvpLocalMapPoints;
+    // Packed copy of mvpLocalMapPoints, rebuilt with it, for SearchLocalPoints
+    LocalMapSnapshot mLocalMapSnapshot;
     
     // System
     System* mpSystem;
@@ -286,6 +296,10 @@ protected:
     //Atlas
     Atlas* mpAtlas;
 
+    // Deletion of culled points, NULL if disabled
+    EpochReclaimer* mpReclaimer;
+    int mnReclaimerId;
+
     //Calibration matrix
     cv::Mat mK;
     Eigen::Matrix3f mK_;
@@ -295,6 +309,8 @@ protected:
 
     float mImuFreq;
     double mImuPer;
+    // Max time (s) to wait for the IMU samples up to the frame. 0 to not wait
+    double mImuWaitTimeout;
     bool mInsertKFsLost;
 
     //New KeyFrame rules (according to fps)
@@ -357,6 +373,9 @@ protected:
 
     void newParameterLoader(Settings* settings);
 
+    // Hands the shared worker pool to the ORB extractors
+    void EnableParallelExtraction();
+
 #ifdef REGISTER_LOOP
     bool Stop();
 
@@ -364,6 +383,7 @@ protected:
     bool mbStopRequested;
     bool mbNotStop;
     std::mutex mMutexStop;
+    std::condition_variable mcvStop;
 #endif
 
 public:
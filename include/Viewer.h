@@ -27,6 +27,7 @@
 #include "Settings.h"
 
 #include <mutex>
+#include <condition_variable>
 
 namespace ORB_SLAM3
 {
@@ -57,6 +58,9 @@ public:
 
     bool isStopped();
 
+    // Blocks until the viewer has stopped after RequestStop, or finished
+    void WaitUntilStopped();
+
     bool isStepByStep();
 
     void Release();
@@ -91,6 +95,7 @@ private:
     bool mbStopped;
     bool mbStopRequested;
     std::mutex mMutexStop;
+    std::condition_variable mcvStop;
 
     bool mbStopTrack;
 
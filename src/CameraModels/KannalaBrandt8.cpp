@@ -114,6 +114,10 @@ namespace ORB_SLAM3 {
     }
 
     cv::Point3f KannalaBrandt8::unproject(const cv::Point2f &p2D) {
+        float ray[3];
+        if (mpUnprojectLUT && mpUnprojectLUT->Lookup(p2D.x, p2D.y, ray))
+            return cv::Point3f(ray[0] / ray[2], ray[1] / ray[2], 1.f);
+
         //Use Newthon method to solve for theta with good precision (err ~ e-6)
         cv::Point2f pw((p2D.x - mvParameters[2]) / mvParameters[0], (p2D.y - mvParameters[3]) / mvParameters[1]);
         float scale = 1.f;
@@ -174,6 +178,131 @@ namespace ORB_SLAM3 {
         return JacGood;
     }
 
+    // atan2(y,x) for y >= 0 written with selects only, so that the batch loops vectorize.
+    // Cephes atanf polynomial after reduction to [0,tan(pi/8)], error below 2e-7 rad.
+    static inline float atan2Batch(const float y, const float x) {
+        const float ax = fabsf(x);
+        const float mx = y > ax ? y : ax;
+        const float mn = y > ax ? ax : y;
+        const float a = mx > 0.f ? mn / mx : 0.f;
+
+        const bool bReduce = a > 0.414213562f;
+        const float t = bReduce ? (a - 1.f) / (a + 1.f) : a;
+        const float t2 = t * t;
+        float r = (((8.05374449538e-2f * t2 - 1.38776856032e-1f) * t2 + 1.99777106478e-1f) * t2
+                   - 3.33329491539e-1f) * t2 * t + t;
+        r = bReduce ? r + 0.785398163f : r;
+        r = y > ax ? 1.570796327f - r : r;
+        return x < 0.f ? 3.141592654f - r : r;
+    }
+
+    void KannalaBrandt8::projectBatch(const Points3f &P3D, Points2f &P2D) {
+        const int n = P3D.cols();
+        P2D.resize(2, n);
+
+        const float fx = mvParameters[0], fy = mvParameters[1], cx = mvParameters[2], cy = mvParameters[3];
+        const float k0 = mvParameters[4], k1 = mvParameters[5], k2 = mvParameters[6], k3 = mvParameters[7];
+        const float* x = P3D.data();
+        const float* y = x + n;
+        const float* z = y + n;
+        float* u = P2D.data();
+        float* v = u + n;
+
+        for(int i = 0; i < n; i++) {
+            const float r = sqrtf(x[i] * x[i] + y[i] * y[i]);
+            const float theta = atan2Batch(r, z[i]);
+
+            const float theta2 = theta * theta;
+            const float rd = theta * (1.f + theta2 * (k0 + theta2 * (k1 + theta2 * (k2 + theta2 * k3))));
+
+            // cos(psi) = x/r and sin(psi) = y/r, psi = 0 on the optical axis
+            const float invr = r > 0.f ? 1.f / r : 0.f;
+            const float cospsi = r > 0.f ? x[i] * invr : 1.f;
+            const float sinpsi = y[i] * invr;
+
+            u[i] = fx * rd * cospsi + cx;
+            v[i] = fy * rd * sinpsi + cy;
+        }
+    }
+
+    void KannalaBrandt8::unprojectBatch(const Points2f &P2D, Points3f &P3D) {
+        const int n = P2D.cols();
+        P3D.resize(3, n);
+
+        const float fx = mvParameters[0], fy = mvParameters[1], cx = mvParameters[2], cy = mvParameters[3];
+        const float k0 = mvParameters[4], k1 = mvParameters[5], k2 = mvParameters[6], k3 = mvParameters[7];
+        const float* u = P2D.data();
+        const float* v = u + n;
+        float* x = P3D.data();
+        float* y = x + n;
+        float* z = y + n;
+
+        // x and y hold the normalized distorted coordinates and z the distorted angle until the end
+        std::vector<float> vTheta(n);
+        for(int i = 0; i < n; i++) {
+            x[i] = (u[i] - cx) / fx;
+            y[i] = (v[i] - cy) / fy;
+            const float theta_d = sqrtf(x[i] * x[i] + y[i] * y[i]);
+            z[i] = theta_d < CV_PI / 2.f ? theta_d : CV_PI / 2.f;
+            vTheta[i] = z[i];
+        }
+
+        // Newton iterations over the whole batch, as in unproject, until every point has converged
+        float* theta = vTheta.data();
+        for(int j = 0; j < 10; j++) {
+            int nNotConverged = 0;
+            for(int i = 0; i < n; i++) {
+                const float theta2 = theta[i] * theta[i], theta4 = theta2 * theta2, theta6 = theta4 * theta2,
+                        theta8 = theta4 * theta4;
+                const float k0_theta2 = k0 * theta2, k1_theta4 = k1 * theta4;
+                const float k2_theta6 = k2 * theta6, k3_theta8 = k3 * theta8;
+                const float theta_fix = (theta[i] * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - z[i]) /
+                                        (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
+                theta[i] -= theta_fix;
+                nNotConverged += fabsf(theta_fix) >= precision;
+            }
+            if(nNotConverged == 0)
+                break;
+        }
+
+        for(int i = 0; i < n; i++) {
+            const float scale = z[i] > 1e-8 ? std::tan(theta[i]) / z[i] : 1.f;
+            x[i] *= scale;
+            y[i] *= scale;
+            z[i] = 1.f;
+        }
+    }
+
+    void KannalaBrandt8::SetUnprojectionLUT(const int width, const int height, const float fStep) {
+        UndistortionLUT* pLUT = new UndistortionLUT(width, height, fStep, 3);
+
+        // unprojectBatch always runs the Newton solve
+        const std::vector<cv::Point2f> vNodes = pLUT->GetNodes();
+        const int n = vNodes.size();
+        Points2f P2D(2, n);
+        for(int i = 0; i < n; i++) {
+            P2D(0, i) = vNodes[i].x;
+            P2D(1, i) = vNodes[i].y;
+        }
+        Points3f rays;
+        unprojectBatch(P2D, rays);
+
+        // Unit bearings interpolate well, except close to 90 degrees where the ray on the z=1 plane
+        // diverges. Those nodes are left out and the lookup falls back to the Newton solve.
+        std::vector<float> vValues(3 * n);
+        for(int i = 0; i < n; i++) {
+            const float invNorm = 1.f / sqrtf(rays(0, i) * rays(0, i) + rays(1, i) * rays(1, i) + 1.f);
+            const bool bValid = invNorm > 0.1f;
+            vValues[3 * i] = bValid ? rays(0, i) * invNorm : NAN;
+            vValues[3 * i + 1] = bValid ? rays(1, i) * invNorm : NAN;
+            vValues[3 * i + 2] = bValid ? invNorm : NAN;
+        }
+        pLUT->SetValues(vValues);
+
+        if(mpUnprojectLUT) delete mpUnprojectLUT;
+        mpUnprojectLUT = pLUT;
+    }
+
     bool KannalaBrandt8::ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                           Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated){
         if(!tvr){
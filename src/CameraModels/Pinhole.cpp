@@ -80,6 +80,60 @@ namespace ORB_SLAM3 {
         return Jac;
     }
 
+    void Pinhole::projectBatch(const Points3f &P3D, Points2f &P2D) {
+        const int n = P3D.cols();
+        P2D.resize(2, n);
+
+        const float fx = mvParameters[0], fy = mvParameters[1], cx = mvParameters[2], cy = mvParameters[3];
+        const float* x = P3D.data();
+        const float* y = x + n;
+        const float* z = y + n;
+        float* u = P2D.data();
+        float* v = u + n;
+
+        for(int i = 0; i < n; i++) {
+            u[i] = fx * x[i] / z[i] + cx;
+            v[i] = fy * y[i] / z[i] + cy;
+        }
+    }
+
+    void Pinhole::unprojectBatch(const Points2f &P2D, Points3f &P3D) {
+        const int n = P2D.cols();
+        P3D.resize(3, n);
+
+        const float fx = mvParameters[0], fy = mvParameters[1], cx = mvParameters[2], cy = mvParameters[3];
+        const float* u = P2D.data();
+        const float* v = u + n;
+        float* x = P3D.data();
+        float* y = x + n;
+        float* z = y + n;
+
+        for(int i = 0; i < n; i++) {
+            x[i] = (u[i] - cx) / fx;
+            y[i] = (v[i] - cy) / fy;
+            z[i] = 1.f;
+        }
+    }
+
+    void Pinhole::SetUndistortionLUT(const cv::Mat &DistCoef, const int width, const int height, const float fStep) {
+        UndistortionLUT* pLUT = new UndistortionLUT(width, height, fStep, 2);
+
+        const std::vector<cv::Point2f> vNodes = pLUT->GetNodes();
+        std::vector<cv::Point2f> vUndistorted;
+        cv::Mat K = this->toK();
+        cv::undistortPoints(vNodes, vUndistorted, K, DistCoef, cv::Mat(), K);
+
+        std::vector<float> vValues(2 * vNodes.size());
+        for(size_t i = 0; i < vNodes.size(); i++) {
+            vValues[2 * i] = vUndistorted[i].x;
+            vValues[2 * i + 1] = vUndistorted[i].y;
+        }
+        pLUT->SetValues(vValues);
+
+        if(mpUndistortLUT) delete mpUndistortLUT;
+        mpUndistortLUT = pLUT;
+    }
+
     bool Pinhole::ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                  Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated){
         if(!tvr){
@@ -0,0 +1,47 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UndistortionLUT.h"
+
+#include <cmath>
+#include <assert.h>
+
+namespace ORB_SLAM3 {
+
+    UndistortionLUT::UndistortionLUT(const int width, const int height, const float fStep, const int nChannels) :
+            mnChannels(nChannels), mfStep(fStep), mfInvStep(1.f / fStep) {
+        assert(fStep > 0.f && nChannels > 0);
+        mnCols = static_cast<int>(std::ceil(width / fStep)) + 1;
+        mnRows = static_cast<int>(std::ceil(height / fStep)) + 1;
+        mvValues.assign(mnCols * mnRows * mnChannels, 0.f);
+    }
+
+    std::vector<cv::Point2f> UndistortionLUT::GetNodes() const {
+        std::vector<cv::Point2f> vNodes;
+        vNodes.reserve(mnCols * mnRows);
+        for(int r = 0; r < mnRows; r++)
+            for(int c = 0; c < mnCols; c++)
+                vNodes.push_back(cv::Point2f(c * mfStep, r * mfStep));
+        return vNodes;
+    }
+
+    void UndistortionLUT::SetValues(const std::vector<float> &vValues) {
+        assert(vValues.size() == mvValues.size());
+        mvValues = vValues;
+    }
+}
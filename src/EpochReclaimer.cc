@@ -0,0 +1,160 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EpochReclaimer.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+EpochReclaimer* EpochReclaimer::mpInstance = NULL;
+
+EpochReclaimer::EpochReclaimer(): mnEpoch(0), mnReclaimed(0)
+{
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+    for(size_t i=0; i<mdRetired.size(); i++)
+        mdRetired[i].deleter(mdRetired[i].pObject);
+}
+
+int EpochReclaimer::Register(const string &name, const function<void()> &wakeUp)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    Participant participant;
+    participant.name = name;
+    participant.wakeUp = wakeUp;
+    participant.nEpoch = mnEpoch;
+    participant.bActive = true;
+    participant.bWakeUpSent = false;
+
+    // Reuse the slot of a participant that has left (e.g. a finished global BA)
+    for(size_t i=0; i<mvParticipants.size(); i++)
+    {
+        if(!mvParticipants[i].bActive)
+        {
+            mvParticipants[i] = participant;
+            return i;
+        }
+    }
+
+    mvParticipants.push_back(participant);
+    return mvParticipants.size()-1;
+}
+
+void EpochReclaimer::Unregister(const int id)
+{
+    vector<RetiredObject> vToDelete;
+    vector<function<void()> > vWakeUps;
+    {
+        unique_lock<mutex> lock(mMutex);
+        mvParticipants[id].bActive = false;
+        mvParticipants[id].wakeUp = function<void()>();
+        Collect(vToDelete,vWakeUps,-1);
+    }
+    Release(vToDelete,vWakeUps);
+}
+
+void EpochReclaimer::Quiesce(const int id)
+{
+    vector<RetiredObject> vToDelete;
+    vector<function<void()> > vWakeUps;
+    {
+        unique_lock<mutex> lock(mMutex);
+        mvParticipants[id].nEpoch = mnEpoch;
+        mvParticipants[id].bWakeUpSent = false;
+        Collect(vToDelete,vWakeUps,id);
+    }
+    Release(vToDelete,vWakeUps);
+}
+
+void EpochReclaimer::Retire(void* pObject, void (*deleter)(void*))
+{
+    RetiredObject retired;
+    retired.pObject = pObject;
+    retired.deleter = deleter;
+
+    unique_lock<mutex> lock(mMutex);
+    retired.nEpoch = mnEpoch;
+    mdRetired.push_back(retired);
+}
+
+size_t EpochReclaimer::GetNumRetired()
+{
+    unique_lock<mutex> lock(mMutex);
+    return mdRetired.size();
+}
+
+unsigned long EpochReclaimer::GetNumReclaimed()
+{
+    unique_lock<mutex> lock(mMutex);
+    return mnReclaimed;
+}
+
+void EpochReclaimer::Collect(vector<RetiredObject> &vToDelete, vector<function<void()> > &vWakeUps, const int nCallerId)
+{
+    bool bAdvance = true;
+    for(size_t i=0; i<mvParticipants.size(); i++)
+    {
+        if(mvParticipants[i].bActive && mvParticipants[i].nEpoch!=mnEpoch)
+        {
+            bAdvance = false;
+            break;
+        }
+    }
+    if(bAdvance)
+        mnEpoch++;
+
+    // Objects retired in epoch e are safe once the epoch e+3 starts
+    while(!mdRetired.empty() && mdRetired.front().nEpoch+3<=mnEpoch)
+    {
+        vToDelete.push_back(mdRetired.front());
+        mdRetired.pop_front();
+    }
+    mnReclaimed += vToDelete.size();
+
+    if(mdRetired.empty())
+        return;
+
+    // Someone is still waiting, wake up the idle participants that lag behind (not the caller, it is not idle)
+    for(size_t i=0; i<mvParticipants.size(); i++)
+    {
+        if((int)i==nCallerId)
+            continue;
+        Participant &participant = mvParticipants[i];
+        if(participant.bActive && participant.nEpoch!=mnEpoch && participant.wakeUp && !participant.bWakeUpSent)
+        {
+            participant.bWakeUpSent = true;
+            vWakeUps.push_back(participant.wakeUp);
+        }
+    }
+}
+
+void EpochReclaimer::Release(vector<RetiredObject> &vToDelete, vector<function<void()> > &vWakeUps)
+{
+    for(size_t i=0; i<vToDelete.size(); i++)
+        vToDelete[i].deleter(vToDelete[i].pObject);
+
+    for(size_t i=0; i<vWakeUps.size(); i++)
+        vWakeUps[i]();
+}
+
+} //namespace ORB_SLAM3
@@ -25,6 +25,8 @@
 #include "Converter.h"
 #include "ORBmatcher.h"
 #include "GeometricCamera.h"
+#include "ThreadPool.h"
+#include "LocalMapSnapshot.h"
 
 #include <thread>
 #include <include/CameraModels/Pinhole.h>
@@ -70,16 +72,8 @@ Frame::Frame(const Frame &frame)
      monoLeft(frame.monoLeft), monoRight(frame.monoRight), mvLeftToRightMatch(frame.mvLeftToRightMatch),
      mvRightToLeftMatch(frame.mvRightToLeftMatch), mvStereo3Dpoints(frame.mvStereo3Dpoints),
      mTlr(frame.mTlr), mRlr(frame.mRlr), mtlr(frame.mtlr), mTrl(frame.mTrl),
-     mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false)
+     mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false), mGrid(frame.mGrid), mGridRight(frame.mGridRight)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++){
-            mGrid[i][j]=frame.mGrid[i][j];
-            if(frame.Nleft > 0){
-                mGridRight[i][j] = frame.mGridRight[i][j];
-            }
-        }
-
     if(frame.mbHasPose)
         SetPose(frame.GetPose());
 
@@ -119,10 +113,20 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,0,0);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,0,0);
-    threadLeft.join();
-    threadRight.join();
+    if(ThreadPool* pThreadPool = ThreadPool::GetInstance())
+    {
+        // Right image on a worker, left image on this thread
+        std::future<void> futureRight = pThreadPool->Submit([&](){ ExtractORB(1,imRight,0,0); });
+        ExtractORB(0,imLeft,0,0);
+        futureRight.wait();
+    }
+    else
+    {
+        thread threadLeft(&Frame::ExtractORB,this,0,imLeft,0,0);
+        thread threadRight(&Frame::ExtractORB,this,1,imRight,0,0);
+        threadLeft.join();
+        threadRight.join();
+    }
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -384,20 +388,10 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
 
 void Frame::AssignFeaturesToGrid()
 {
-    // Fill matrix with points
-    const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
-
-    int nReserve = 0.5f*N/(nCells);
-
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++){
-            mGrid[i][j].reserve(nReserve);
-            if(Nleft != -1){
-                mGridRight[i][j].reserve(nReserve);
-            }
-        }
-
-
+    // Cell of each keypoint (-1 if outside), then counting sort into the flat grids
+    const int nLeft = (Nleft == -1) ? N : Nleft;
+    vector<int> vCells(nLeft);
+    vector<int> vCellsRight(N-nLeft);
 
     for(int i=0;i<N;i++)
     {
@@ -406,13 +400,16 @@ void Frame::AssignFeaturesToGrid()
                                                                  : mvKeysRight[i - Nleft];
 
         int nGridPosX, nGridPosY;
-        if(PosInGrid(kp,nGridPosX,nGridPosY)){
-            if(Nleft == -1 || i < Nleft)
-                mGrid[nGridPosX][nGridPosY].push_back(i);
-            else
-                mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
-        }
+        const int nCell = PosInGrid(kp,nGridPosX,nGridPosY) ? nGridPosX*FRAME_GRID_ROWS+nGridPosY : -1;
+        if(i < nLeft)
+            vCells[i] = nCell;
+        else
+            vCellsRight[i - nLeft] = nCell;
     }
+
+    mGrid.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCells);
+    if(Nleft != -1)
+        mGridRight.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,vCellsRight);
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1)
@@ -585,6 +582,168 @@ bool Frame::isInFrustum(MapPoint *pMP, float viewingCosLimit)
     }
 }
 
+void Frame::isInFrustum(const LocalMapSnapshot &localMap, float viewingCosLimit, vector<size_t> &vVisible)
+{
+    const size_t N = localMap.size();
+    vVisible.clear();
+
+    for(size_t i=0; i<N; i++)
+    {
+        MapPoint* pMP = localMap.mvpMapPoints[i];
+        if(pMP->mnLastFrameSeen == mnId)
+            continue;
+
+        pMP->mbTrackInView = false;
+        if(Nleft == -1)
+        {
+            pMP->mTrackProjX = -1;
+            pMP->mTrackProjY = -1;
+        }
+        else
+        {
+            pMP->mbTrackInViewR = false;
+            pMP->mnTrackScaleLevel = -1;
+            pMP->mnTrackScaleLevelR = -1;
+        }
+    }
+
+    // The second camera of a fisheye stereo rig is tested on its own, as isInFrustum does per point
+    vector<unsigned char> vbInView, vbInViewR;
+    isInFrustumChecks(localMap,viewingCosLimit,vbInView);
+    if(Nleft != -1)
+        isInFrustumChecks(localMap,viewingCosLimit,vbInViewR,true);
+
+    for(size_t i=0; i<N; i++)
+        if(vbInView[i] || (Nleft != -1 && vbInViewR[i]))
+            vVisible.push_back(i);
+}
+
+void Frame::isInFrustumChecks(const LocalMapSnapshot &localMap, float viewingCosLimit, vector<unsigned char> &vbInView, bool bRight)
+{
+    const size_t N = localMap.size();
+    vbInView.assign(N,0);
+
+    Eigen::Matrix3f R;
+    Eigen::Vector3f t, twc;
+    if(bRight)
+    {
+        const Eigen::Matrix3f Rrl = mTrl.rotationMatrix();
+        R = Rrl * mRcw;
+        t = Rrl * mtcw + mTrl.translation();
+        twc = mRwc * mTlr.translation() + mOw;
+    }
+    else
+    {
+        R = mRcw;
+        t = mtcw;
+        twc = mOw;
+    }
+    GeometricCamera* pCamera = bRight ? mpCamera2 : mpCamera;
+
+    // Depth, distance and viewing angle tests over the packed arrays, in one vectorizable pass.
+    // Only the survivors are projected and touch their MapPoint.
+    vector<float> vXc(N), vYc(N), vZc(N), vDist(N), vViewCos(N);
+    vector<unsigned char> vbCandidate(N);
+
+    const float r00 = R(0,0), r01 = R(0,1), r02 = R(0,2);
+    const float r10 = R(1,0), r11 = R(1,1), r12 = R(1,2);
+    const float r20 = R(2,0), r21 = R(2,1), r22 = R(2,2);
+    const float tx = t(0), ty = t(1), tz = t(2);
+    const float ox = twc(0), oy = twc(1), oz = twc(2);
+
+    const float* px = localMap.mvX.data();
+    const float* py = localMap.mvY.data();
+    const float* pz = localMap.mvZ.data();
+    const float* pnx = localMap.mvNx.data();
+    const float* pny = localMap.mvNy.data();
+    const float* pnz = localMap.mvNz.data();
+    const float* pMinDist = localMap.mvMinDistance.data();
+    const float* pMaxDist = localMap.mvMaxDistance.data();
+
+    for(size_t i=0; i<N; i++)
+    {
+        const float x = px[i], y = py[i], z = pz[i];
+        vXc[i] = r00*x + r01*y + r02*z + tx;
+        vYc[i] = r10*x + r11*y + r12*z + ty;
+        vZc[i] = r20*x + r21*y + r22*z + tz;
+
+        const float dx = x-ox, dy = y-oy, dz = z-oz;
+        const float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+        vDist[i] = dist;
+        vViewCos[i] = (dx*pnx[i] + dy*pny[i] + dz*pnz[i])/dist;
+
+        // Positive depth, scale invariance region of the MapPoint and viewing angle
+        vbCandidate[i] = (vZc[i]>=0.0f) & (dist>=0.8f*pMinDist[i]) & (dist<=1.2f*pMaxDist[i]) &
+                         (vViewCos[i]>=viewingCosLimit);
+    }
+
+    // Project the candidates with a single batch call
+    vector<size_t> vCandidates;
+    vCandidates.reserve(N);
+    for(size_t i=0; i<N; i++)
+        if(vbCandidate[i])
+            vCandidates.push_back(i);
+
+    GeometricCamera::Points3f Pcs(3,vCandidates.size());
+    for(size_t k=0; k<vCandidates.size(); k++)
+    {
+        const size_t i = vCandidates[k];
+        Pcs(0,k) = vXc[i];
+        Pcs(1,k) = vYc[i];
+        Pcs(2,k) = vZc[i];
+    }
+    GeometricCamera::Points2f uvs;
+    pCamera->projectBatch(Pcs,uvs);
+
+    for(size_t k=0; k<vCandidates.size(); k++)
+    {
+        const size_t i = vCandidates[k];
+        MapPoint* pMP = localMap.mvpMapPoints[i];
+        if(pMP->mnLastFrameSeen == mnId)
+            continue;
+
+        const Eigen::Vector2f uv = uvs.col(k);
+
+        if(uv(0)<mnMinX || uv(0)>mnMaxX)
+            continue;
+        if(uv(1)<mnMinY || uv(1)>mnMaxY)
+            continue;
+
+        // Predict scale in the image, as MapPoint::PredictScale
+        int nPredictedLevel = ceil(log(pMaxDist[i]/vDist[i])/mfLogScaleFactor);
+        if(nPredictedLevel<0)
+            nPredictedLevel = 0;
+        else if(nPredictedLevel>=mnScaleLevels)
+            nPredictedLevel = mnScaleLevels-1;
+
+        const float Pc_dist = sqrtf(vXc[i]*vXc[i] + vYc[i]*vYc[i] + vZc[i]*vZc[i]);
+
+        // Data used by the tracking
+        if(bRight)
+        {
+            pMP->mbTrackInViewR = true;
+            pMP->mTrackProjXR = uv(0);
+            pMP->mTrackProjYR = uv(1);
+            pMP->mnTrackScaleLevelR = nPredictedLevel;
+            pMP->mTrackViewCosR = vViewCos[i];
+            pMP->mTrackDepthR = Pc_dist;
+        }
+        else
+        {
+            pMP->mbTrackInView = true;
+            pMP->mTrackProjX = uv(0);
+            pMP->mTrackProjY = uv(1);
+            pMP->mnTrackScaleLevel = nPredictedLevel;
+            pMP->mTrackViewCos = vViewCos[i];
+            pMP->mTrackDepth = Pc_dist;
+            if(Nleft == -1)
+                pMP->mTrackProjXR = uv(0) - mbf/vZc[i];
+        }
+
+        vbInView[i] = 1;
+    }
+}
+
 bool Frame::ProjectPointDistort(MapPoint* pMP, cv::Point2f &kp, float &u, float &v)
 {
 
@@ -664,6 +823,11 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
     vector<size_t> vIndices;
     vIndices.reserve(N);
 
+    // mGridRight存的是双目相机里另一个相机的图
+    const KeyPointGrid &grid = (!bRight) ? mGrid : mGridRight;
+    if(grid.empty())
+        return vIndices;
+
     float factorX = r;
     float factorY = r;
     // 范围左边界所属的网格索引
@@ -698,17 +862,16 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            // 获取网格内的所有特征点,mGridRight存的是双目相机里另一个相机的图
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            if(vCell.empty())
-                continue;
+            // 获取网格内的所有特征点
+            const unsigned int* pCellEnd = grid.CellEnd(ix,iy);
             // 遍历每个特征点，判断特征点是否在范围内
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
+            for(const unsigned int* pIdx = grid.CellBegin(ix,iy); pIdx!=pCellEnd; pIdx++)
             {
+                const size_t idx = *pIdx;
                 // mvKeysUn存的是无畸变坐标，如果是双目的话这个是没用的，因为双目相机在用之前必须校正；因此这里作了个判断
-                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[idx]
+                                                         : (!bRight) ? mvKeys[idx]
+                                                                     : mvKeysRight[idx];
                 if(bCheckLevels)
                 {
                     if(kpUn.octave<minLevel)
@@ -722,7 +885,7 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<factorX && fabs(disty)<factorY)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(idx);
             }
         }
     }
@@ -747,8 +910,9 @@ void Frame::ComputeBoW()
 {
     if(mBowVec.empty())
     {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        // The rows of a continuous descriptor matrix go to the vocabulary in place
+        const cv::Mat desc = mDescriptors.isContinuous() ? mDescriptors : mDescriptors.clone();
+        mpORBvocabulary->transform(desc.ptr<unsigned char>(),desc.rows,mBowVec,mFeatVec,4);
     }
 }
 
@@ -760,13 +924,38 @@ void Frame::UndistortKeyPoints()
         return;
     }
 
-    // Fill matrix with points
-    cv::Mat mat(N,2,CV_32F);
+    // Interpolate the precomputed undistortion map of the camera when there is one,
+    // only the keypoints it does not cover go through cv::undistortPoints
+    UndistortionLUT* pLUT = NULL;
+    if(mpCamera->GetType() == GeometricCamera::CAM_PINHOLE)
+        pLUT = static_cast<Pinhole*>(mpCamera)->GetUndistortionLUT();
 
+    mvKeysUn = mvKeys;
+    vector<int> vToUndistort;
+    vToUndistort.reserve(pLUT ? 0 : N);
     for(int i=0; i<N; i++)
     {
-        mat.at<float>(i,0)=mvKeys[i].pt.x;
-        mat.at<float>(i,1)=mvKeys[i].pt.y;
+        float uv[2];
+        if(pLUT && pLUT->Lookup(mvKeys[i].pt.x,mvKeys[i].pt.y,uv))
+        {
+            mvKeysUn[i].pt.x = uv[0];
+            mvKeysUn[i].pt.y = uv[1];
+        }
+        else
+            vToUndistort.push_back(i);
+    }
+
+    const int nToUndistort = vToUndistort.size();
+    if(nToUndistort==0)
+        return;
+
+    // Fill matrix with points
+    cv::Mat mat(nToUndistort,2,CV_32F);
+
+    for(int i=0; i<nToUndistort; i++)
+    {
+        mat.at<float>(i,0)=mvKeys[vToUndistort[i]].pt.x;
+        mat.at<float>(i,1)=mvKeys[vToUndistort[i]].pt.y;
     }
 
     // Undistort points
@@ -776,13 +965,11 @@ void Frame::UndistortKeyPoints()
 
 
     // Fill undistorted keypoint vector
-    mvKeysUn.resize(N);
-    for(int i=0; i<N; i++)
+    for(int i=0; i<nToUndistort; i++)
     {
-        cv::KeyPoint kp = mvKeys[i];
+        cv::KeyPoint &kp = mvKeysUn[vToUndistort[i]];
         kp.pt.x=mat.at<float>(i,0);
         kp.pt.y=mat.at<float>(i,1);
-        mvKeysUn[i]=kp;
     }
 
 }
@@ -1064,10 +1251,24 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1]);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1]);
-    threadLeft.join();
-    threadRight.join();
+    const int x0Left = static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0];
+    const int x1Left = static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1];
+    const int x0Right = static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0];
+    const int x1Right = static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1];
+    if(ThreadPool* pThreadPool = ThreadPool::GetInstance())
+    {
+        // Right image on a worker, left image on this thread
+        std::future<void> futureRight = pThreadPool->Submit([&](){ ExtractORB(1,imRight,x0Right,x1Right); });
+        ExtractORB(0,imLeft,x0Left,x1Left);
+        futureRight.wait();
+    }
+    else
+    {
+        thread threadLeft(&Frame::ExtractORB,this,0,imLeft,x0Left,x1Left);
+        thread threadRight(&Frame::ExtractORB,this,1,imRight,x0Right,x1Right);
+        threadLeft.join();
+        threadRight.join();
+    }
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
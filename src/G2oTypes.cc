@@ -759,6 +759,50 @@ void EdgePriorPoseImu::linearizeOplus()
     _jacobianOplus[3].block<3,3>(12,0) = Eigen::Matrix3d::Identity();
 }
 
+EdgePriorInertialGS::EdgePriorInertialGS(const Eigen::Matrix3d &Rwg_, const double &scale_, const Eigen::Vector3d &bg_,
+                                         const Eigen::Vector3d &ba_, const Matrix9d &H_):
+    Rwg(Rwg_), scale(scale_), bg(bg_), ba(ba_)
+{
+    // This edge links 4 vertices: gravity direction, scale, gyro and acc biases
+    resize(4);
+
+    Matrix9d H = (H_+H_.transpose())/2;
+    Eigen::SelfAdjointEigenSolver<Matrix9d> es(H);
+    Eigen::Matrix<double,9,1> eigs = es.eigenvalues();
+    for(int i=0;i<9;i++)
+        if(eigs[i]<1e-12)
+            eigs[i]=0;
+    H = es.eigenvectors()*eigs.asDiagonal()*es.eigenvectors().transpose();
+    setInformation(H);
+}
+
+void EdgePriorInertialGS::computeError()
+{
+    const VertexGDir* VGDir = static_cast<const VertexGDir*>(_vertices[0]);
+    const VertexScale* VS = static_cast<const VertexScale*>(_vertices[1]);
+    const VertexGyroBias* VG = static_cast<const VertexGyroBias*>(_vertices[2]);
+    const VertexAccBias* VA = static_cast<const VertexAccBias*>(_vertices[3]);
+
+    // Gravity direction only has two degrees of freedom, rotations around z do not change it
+    const Eigen::Vector3d er = LogSO3(Rwg.transpose()*VGDir->estimate().Rwg);
+    _error << er(0), er(1), log(VS->estimate()/scale), VG->estimate()-bg, VA->estimate()-ba;
+}
+
+void EdgePriorInertialGS::linearizeOplus()
+{
+    const VertexGDir* VGDir = static_cast<const VertexGDir*>(_vertices[0]);
+    const Eigen::Vector3d er = LogSO3(Rwg.transpose()*VGDir->estimate().Rwg);
+
+    _jacobianOplus[0].setZero();
+    _jacobianOplus[0].block<2,2>(0,0) = InverseRightJacobianSO3(er).block<2,2>(0,0);
+    _jacobianOplus[1].setZero();
+    _jacobianOplus[1](2,0) = 1.0;
+    _jacobianOplus[2].setZero();
+    _jacobianOplus[2].block<3,3>(3,0) = Eigen::Matrix3d::Identity();
+    _jacobianOplus[3].setZero();
+    _jacobianOplus[3].block<3,3>(6,0) = Eigen::Matrix3d::Identity();
+}
+
 void EdgePriorAcc::linearizeOplus()
 {
     // Jacobian wrt bias
@@ -0,0 +1,136 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImuRingBuffer.h"
+
+#include <chrono>
+#include <limits>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+    size_t NextPowerOfTwo(const size_t n)
+    {
+        size_t p = 1;
+        while(p<n)
+            p <<= 1;
+        return p;
+    }
+}
+
+ImuRingBuffer::ImuRingBuffer(const size_t nCapacity):
+    mnCapacity(NextPowerOfTwo(max(nCapacity,(size_t)2))), mvPoints(mnCapacity, IMU::Point(0,0,0,0,0,0,0)),
+    mnHead(0), mnTail(0), mLastPushedT(-numeric_limits<double>::infinity()), mnDropped(0), mbResetRequested(false),
+    mbWaiting(false)
+{
+}
+
+bool ImuRingBuffer::Push(const IMU::Point &point)
+{
+    // After a Clear the consumer starts a new session, accept again samples older than the last one pushed
+    if(mbResetRequested.load(memory_order_acquire) && mbResetRequested.exchange(false,memory_order_acq_rel))
+        mLastPushedT = -numeric_limits<double>::infinity();
+
+    const size_t head = mnHead.load(memory_order_relaxed);
+    if(point.t<mLastPushedT || head-mnTail.load(memory_order_acquire)==mnCapacity)
+    {
+        mnDropped.fetch_add(1,memory_order_relaxed);
+        return false;
+    }
+
+    mvPoints[head & (mnCapacity-1)] = point;
+    mLastPushedT = point.t;
+    mnHead.store(head+1);
+
+    // The head store and this load are sequentially consistent, and so are the flag store and the fence
+    // in WaitUntil: either the consumer sees the new head before it sleeps, or we see it waiting
+    if(mbWaiting.load())
+    {
+        unique_lock<mutex> lock(mMutexWait);
+        mcvWait.notify_one();
+    }
+    return true;
+}
+
+size_t ImuRingBuffer::Size() const
+{
+    return mnHead.load(memory_order_acquire)-mnTail.load(memory_order_relaxed);
+}
+
+bool ImuRingBuffer::ExtractRange(const double t0, const double t1, vector<IMU::Point> &vPoints)
+{
+    const size_t head = mnHead.load(memory_order_acquire);
+    size_t tail = mnTail.load(memory_order_relaxed);
+
+    // Samples are sorted, binary search the first one not older than t0
+    size_t first = tail, last = head;
+    while(first<last)
+    {
+        const size_t mid = first+(last-first)/2;
+        if(mvPoints[mid & (mnCapacity-1)].t<t0)
+            first = mid+1;
+        else
+            last = mid;
+    }
+    tail = first;
+
+    while(tail<head && mvPoints[tail & (mnCapacity-1)].t<t1)
+    {
+        vPoints.push_back(mvPoints[tail & (mnCapacity-1)]);
+        tail++;
+    }
+
+    const bool bAvailable = tail<head;
+    if(bAvailable)
+        vPoints.push_back(mvPoints[tail & (mnCapacity-1)]);
+
+    mnTail.store(tail,memory_order_release);
+    return bAvailable;
+}
+
+bool ImuRingBuffer::IsAvailable(const double t) const
+{
+    // The newest sample cannot be overwritten until the consumer moves past it
+    const size_t head = mnHead.load(memory_order_acquire);
+    return head!=mnTail.load(memory_order_relaxed) && mvPoints[(head-1) & (mnCapacity-1)].t>=t;
+}
+
+bool ImuRingBuffer::WaitUntil(const double t, const double timeout)
+{
+    if(IsAvailable(t))
+        return true;
+
+    unique_lock<mutex> lock(mMutexWait);
+    mbWaiting.store(true);
+    atomic_thread_fence(memory_order_seq_cst);
+    const bool bAvailable = mcvWait.wait_for(lock, chrono::duration<double>(timeout), [&]{ return IsAvailable(t); });
+    mbWaiting.store(false);
+    return bAvailable;
+}
+
+void ImuRingBuffer::Clear()
+{
+    mnTail.store(mnHead.load(memory_order_acquire),memory_order_release);
+    mbResetRequested.store(true,memory_order_release);
+}
+
+} //namespace ORB_SLAM3
@@ -104,6 +104,10 @@ IntegratedRotation::IntegratedRotation(const Eigen::Vector3f &angVel, const Bias
     }
 }
 
+float Preintegrated::mfReintegrationTh = 0.01f;
+std::atomic<unsigned long> Preintegrated::mnReintegrations(0);
+std::atomic<unsigned long> Preintegrated::mnFirstOrderUpdates(0);
+
 Preintegrated::Preintegrated(const Bias &b_, const Calib &calib)
 {
     Nga = calib.Cov;
@@ -168,70 +172,136 @@ void Preintegrated::Initialize(const Bias &b_)
 void Preintegrated::Reintegrate()
 {
     std::unique_lock<std::mutex> lock(mMutex);
-    const std::vector<integrable> aux = mvMeasurements;
+    std::vector<integrable> aux;
+    aux.swap(mvMeasurements);
     Initialize(bu);
-    for(size_t i=0;i<aux.size();i++)
-        IntegrateNewMeasurement(aux[i].a,aux[i].w,aux[i].t);
+    mvMeasurements.swap(aux);
+    Integrate(mvMeasurements.data(),mvMeasurements.size());
 }
 
-void Preintegrated::IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt)
+bool Preintegrated::ReintegrateIfNeeded()
 {
-    mvMeasurements.push_back(integrable(acceleration,angVel,dt));
-
-    // Position is updated firstly, as it depends on previously computed velocity and rotation.
-    // Velocity is updated secondly, as it depends on previously computed rotation.
-    // Rotation is the last to be updated.
-
-    //Matrices to compute covariance
-    Eigen::Matrix<float,9,9> A;
-    A.setIdentity();
-    Eigen::Matrix<float,9,6> B;
-    B.setZero();
-
-    Eigen::Vector3f acc, accW;
-    acc << acceleration(0)-b.bax, acceleration(1)-b.bay, acceleration(2)-b.baz;
-    accW << angVel(0)-b.bwx, angVel(1)-b.bwy, angVel(2)-b.bwz;
+    float dbg;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        dbg = db.head(3).norm();
+    }
 
-    avgA = (dT*avgA + dR*acc*dt)/(dT+dt);
-    avgW = (dT*avgW + accW*dt)/(dT+dt);
+    if(dbg>mfReintegrationTh)
+    {
+        Reintegrate();
+        mnReintegrations++;
+        return true;
+    }
 
-    // Update delta position dP and velocity dV (rely on no-updated delta rotation)
-    dP = dP + dV*dt + 0.5f*dR*acc*dt*dt;
-    dV = dV + dR*acc*dt;
+    mnFirstOrderUpdates++;
+    return false;
+}
 
-    // Compute velocity and position parts of matrices A and B (rely on non-updated delta rotation)
-    Eigen::Matrix<float,3,3> Wacc = Sophus::SO3f::hat(acc);
+void Preintegrated::IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt)
+{
+    mvMeasurements.push_back(integrable(acceleration,angVel,dt));
+    Integrate(&mvMeasurements.back(),1);
+}
 
-    A.block<3,3>(3,0) = -dR*dt*Wacc;
-    A.block<3,3>(6,0) = -0.5f*dR*dt*dt*Wacc;
-    A.block<3,3>(6,3) = Eigen::DiagonalMatrix<float,3>(dt, dt, dt);
-    B.block<3,3>(3,3) = dR*dt;
-    B.block<3,3>(6,3) = 0.5f*dR*dt*dt;
+void Preintegrated::IntegrateNewMeasurements(const std::vector<integrable> &vMeasurements)
+{
+    mvMeasurements.insert(mvMeasurements.end(),vMeasurements.begin(),vMeasurements.end());
+    Integrate(vMeasurements.data(),vMeasurements.size());
+}
 
+void Preintegrated::Integrate(const integrable* pMeasurements, const size_t n)
+{
+    if(n==0)
+        return;
 
-    // Update position and velocity jacobians wrt bias correction
-    JPa = JPa + JVa*dt -0.5f*dR*dt*dt;
-    JPg = JPg + JVg*dt -0.5f*dR*dt*dt*Wacc*JRg;
-    JVa = JVa - dR*dt;
-    JVg = JVg - dR*dt*Wacc*JRg;
+    // Position is updated firstly, as it depends on previously computed velocity and rotation.
+    // Velocity is updated secondly, as it depends on previously computed rotation.
+    // Rotation is the last to be updated.
 
-    // Update delta rotation
-    IntegratedRotation dRi(angVel,b,dt);
-    dR = NormalizeRotation(dR*dRi.deltaR);
+    // The covariance of (rotation, velocity, position) is propagated as C = A*C*A' + B*Nga*B' with
+    //     | dRi'          0     0 |        | Jr*dt        0 |
+    // A = | M             I     0 |    B = | 0        dR*dt |    M = -dR*Wacc*dt
+    //     | 0.5*dt*M   dt*I     I |        | 0   0.5*dR*dt2 |
+    // Working on its 3x3 blocks skips the products with the zero and identity blocks.
+    // Only the upper blocks are kept during the loop, C is symmetric.
+    Eigen::Matrix3f CRR = C.block<3,3>(0,0), CRV = C.block<3,3>(0,3), CRP = C.block<3,3>(0,6);
+    Eigen::Matrix3f CVV = C.block<3,3>(3,3), CVP = C.block<3,3>(3,6), CPP = C.block<3,3>(6,6);
+    const Eigen::Vector3f ng = Nga.diagonal().head<3>();
+    const Eigen::Vector3f na = Nga.diagonal().tail<3>();
 
-    // Compute rotation parts of matrices A and B
-    A.block<3,3>(0,0) = dRi.deltaR.transpose();
-    B.block<3,3>(0,0) = dRi.rightJ*dt;
+    const Eigen::Vector3f ba(b.bax, b.bay, b.baz);
 
-    // Update covariance
-    C.block<9,9>(0,0) = A * C.block<9,9>(0,0) * A.transpose() + B*Nga*B.transpose();
-    C.block<6,6>(9,9) += NgaWalk;
+    // Delta rotation is accumulated as a quaternion, cheaper to normalize than the rotation matrix
+    Eigen::Quaternionf qR(dR);
 
-    // Update rotation jacobian wrt bias correction
-    JRg = dRi.deltaR.transpose()*JRg - dRi.rightJ*dt;
+    for(size_t i=0; i<n; i++)
+    {
+        const float dt = pMeasurements[i].t;
+        const float dt2 = dt*dt;
+        const Eigen::Vector3f acc = pMeasurements[i].a-ba;
+        const Eigen::Vector3f dRacc = dR*acc;
+
+        avgA = (dT*avgA + dRacc*dt)/(dT+dt);
+        avgW = (dT*avgW + (pMeasurements[i].w-Eigen::Vector3f(b.bwx, b.bwy, b.bwz))*dt)/(dT+dt);
+
+        // Update delta position dP and velocity dV (rely on no-updated delta rotation)
+        dP = dP + dV*dt + 0.5f*dRacc*dt2;
+        dV = dV + dRacc*dt;
+
+        const Eigen::Matrix3f M = -dR*Sophus::SO3f::hat(acc)*dt;
+        const Eigen::Matrix3f G = dR*na.asDiagonal()*dR.transpose();
+
+        // Update position and velocity jacobians wrt bias correction (rely on no-updated delta rotation)
+        const Eigen::Matrix3f MJRg = M*JRg;
+        JPa = JPa + JVa*dt - 0.5f*dR*dt2;
+        JPg = JPg + JVg*dt + 0.5f*dt*MJRg;
+        JVa = JVa - dR*dt;
+        JVg = JVg + MJRg;
+
+        IntegratedRotation dRi(pMeasurements[i].w,b,dt);
+        const Eigen::Matrix3f Rt = dRi.deltaR.transpose();
+
+        // Update covariance
+        const Eigen::Matrix3f XR = M*CRR, XV = M*CRV, XP = M*CRP;
+        const Eigen::Matrix3f UVR = XR + CRV.transpose();
+        const Eigen::Matrix3f UVV = XV + CVV;
+        const Eigen::Matrix3f UVP = XP + CVP;
+        const Eigen::Matrix3f UPR = 0.5f*dt*XR + dt*CRV.transpose() + CRP.transpose();
+        const Eigen::Matrix3f UPV = 0.5f*dt*XV + dt*CVV + CVP.transpose();
+        const Eigen::Matrix3f UPP = 0.5f*dt*XP + dt*CVP + CPP;
+        const Eigen::Matrix3f Y = UVR*M.transpose();
+
+        const Eigen::Matrix3f JrDt = dRi.rightJ*dt;
+        CPP = 0.5f*dt*UPR*M.transpose() + dt*UPV + UPP + (0.25f*dt2*dt2)*G;
+        CVP = 0.5f*dt*Y + dt*UVV + UVP + (0.5f*dt2*dt)*G;
+        CVV = Y + UVV + dt2*G;
+        CRP = Rt*(0.5f*dt*XR.transpose() + dt*CRV + CRP);
+        CRV = Rt*(XR.transpose() + CRV);
+        CRR = Rt*CRR*dRi.deltaR + JrDt*ng.asDiagonal()*JrDt.transpose();
+
+        // Update delta rotation
+        qR = qR*Eigen::Quaternionf(dRi.deltaR);
+        qR.normalize();
+        dR = qR.toRotationMatrix();
+
+        // Update rotation jacobian wrt bias correction
+        JRg = Rt*JRg - JrDt;
+
+        // Total integrated time
+        dT += dt;
+    }
 
-    // Total integrated time
-    dT += dt;
+    C.block<3,3>(0,0) = CRR;
+    C.block<3,3>(0,3) = CRV;
+    C.block<3,3>(0,6) = CRP;
+    C.block<3,3>(3,0) = CRV.transpose();
+    C.block<3,3>(3,3) = CVV;
+    C.block<3,3>(3,6) = CVP;
+    C.block<3,3>(6,0) = CRP.transpose();
+    C.block<3,3>(6,3) = CVP.transpose();
+    C.block<3,3>(6,6) = CPP;
+    C.block<6,6>(9,9).diagonal() += n*NgaWalk.diagonal();
 }
 
 void Preintegrated::MergePrevious(Preintegrated* pPrev)
@@ -249,14 +319,13 @@ void Preintegrated::MergePrevious(Preintegrated* pPrev)
     bav.bay = bu.bay;
     bav.baz = bu.baz;
 
-    const std::vector<integrable > aux1 = pPrev->mvMeasurements;
-    const std::vector<integrable> aux2 = mvMeasurements;
+    std::vector<integrable> aux2;
+    aux2.swap(mvMeasurements);
 
     Initialize(bav);
-    for(size_t i=0;i<aux1.size();i++)
-        IntegrateNewMeasurement(aux1[i].a,aux1[i].w,aux1[i].t);
-    for(size_t i=0;i<aux2.size();i++)
-        IntegrateNewMeasurement(aux2[i].a,aux2[i].w,aux2[i].t);
+    mvMeasurements.reserve(pPrev->mvMeasurements.size()+aux2.size());
+    IntegrateNewMeasurements(pPrev->mvMeasurements);
+    IntegrateNewMeasurements(aux2);
 
 }
 
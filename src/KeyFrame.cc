@@ -19,12 +19,15 @@
 #include "KeyFrame.h"
 #include "Converter.h"
 #include "ImuTypes.h"
+#include "EpochReclaimer.h"
 #include<mutex>
+#include<algorithm>
 
 namespace ORB_SLAM3
 {
 
 long unsigned int KeyFrame::nNextId=0;
+ObjectPool KeyFrame::mPool("KeyFrame",sizeof(KeyFrame),64);
 
 KeyFrame::KeyFrame():
         mnFrameId(0),  mTimeStamp(0), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
@@ -59,24 +62,11 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mbToBeErased(false), mbBad(false), mHalfBaseline(F.mb/2), mpMap(pMap), mbCurrentPlaceRecognition(false), mNameFile(F.mNameFile), mnMergeCorrectedForKF(0),
     mpCamera(F.mpCamera), mpCamera2(F.mpCamera2),
     mvLeftToRightMatch(F.mvLeftToRightMatch),mvRightToLeftMatch(F.mvRightToLeftMatch), mTlr(F.GetRelativePoseTlr()),
-    mvKeysRight(F.mvKeysRight), NLeft(F.Nleft), NRight(F.Nright), mTrl(F.GetRelativePoseTrl()), mnNumberOfOpt(0), mbHasVelocity(false)
+    mvKeysRight(F.mvKeysRight), NLeft(F.Nleft), NRight(F.Nright), mTrl(F.GetRelativePoseTrl()), mnNumberOfOpt(0), mbHasVelocity(false),
+    mGrid(F.mGrid), mGridRight(F.mGridRight)
 {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    if(F.Nleft != -1)  mGridRight.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-    {
-        mGrid[i].resize(mnGridRows);
-        if(F.Nleft != -1) mGridRight[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++){
-            mGrid[i][j] = F.mGrid[i][j];
-            if(F.Nleft != -1){
-                mGridRight[i][j] = F.mGridRight[i][j];
-            }
-        }
-    }
-
 
 
     if(!F.HasVelocity()) {
@@ -99,10 +89,11 @@ void KeyFrame::ComputeBoW()
 {
     if(mBowVec.empty() || mFeatVec.empty())
     {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
+        // The rows of a continuous descriptor matrix go to the vocabulary in place
+        const cv::Mat desc = mDescriptors.isContinuous() ? mDescriptors : mDescriptors.clone();
         // Feature vector associate features with nodes in the 4th level (from leaves up)
         // We assume the vocabulary tree has 6 levels, change the 4 otherwise
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        mpORBvocabulary->transform(desc.ptr<unsigned char>(),desc.rows,mBowVec,mFeatVec,4);
     }
 }
 
@@ -605,6 +596,10 @@ void KeyFrame::SetBadFlag()
         mConnectedKeyFrameWeights.clear();
         mvpOrderedConnectedKeyFrames.clear();
 
+        // The points no longer know this keyframe, so they would not clear it when they are deleted
+        if(EpochReclaimer::GetInstance())
+            fill(mvpMapPoints.begin(),mvpMapPoints.end(),static_cast<MapPoint*>(NULL));
+
         // Update Spanning Tree
         set<KeyFrame*> sParentCandidates;
         if(mpParent)
@@ -706,6 +701,10 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     vector<size_t> vIndices;
     vIndices.reserve(N);
 
+    const KeyPointGrid &grid = (!bRight) ? mGrid : mGridRight;
+    if(grid.empty())
+        return vIndices;
+
     float factorX = r;
     float factorY = r;
 
@@ -729,17 +728,18 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     {
         for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
         {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
+            const unsigned int* pCellEnd = grid.CellEnd(ix,iy);
+            for(const unsigned int* pIdx = grid.CellBegin(ix,iy); pIdx!=pCellEnd; pIdx++)
             {
-                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
+                const size_t idx = *pIdx;
+                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[idx]
+                                                         : (!bRight) ? mvKeys[idx]
+                                                                     : mvKeysRight[idx];
                 const float distx = kpUn.pt.x-x;
                 const float disty = kpUn.pt.y-y;
 
                 if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
+                    vIndices.push_back(idx);
             }
         }
     }
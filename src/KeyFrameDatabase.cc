@@ -41,7 +41,16 @@ void KeyFrameDatabase::add(KeyFrame *pKF)
     unique_lock<mutex> lock(mMutex);
 
     for(DBoW2::BowVector::const_iterator vit= pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
-        mvInvertedFile[vit->first].push_back(pKF);
+    {
+        KeyFramePostings* pPostings = mvInvertedFile[vit->first].get();
+        if(pPostings && pPostings->Append(pKF))
+            continue;
+
+        // Full (or first keyframe with this word): move the live entries to larger postings
+        shared_ptr<KeyFramePostings> pGrown(pPostings ? pPostings->Compacted(1) : new KeyFramePostings(8));
+        pGrown->Append(pKF);
+        SetPostings(vit->first,pGrown);
+    }
 }
 
 void KeyFrameDatabase::erase(KeyFrame* pKF)
@@ -51,24 +60,25 @@ void KeyFrameDatabase::erase(KeyFrame* pKF)
     // Erase elements in the Inverse File for the entry
     for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
     {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        // Keyframes that share the word
+        KeyFramePostings* pPostings = mvInvertedFile[vit->first].get();
+        if(!pPostings || !pPostings->Erase(pKF))
+            continue;
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-        {
-            if(pKF==*lit)
-            {
-                lKFs.erase(lit);
-                break;
-            }
-        }
+        if(pPostings->NeedsCompaction())
+            SetPostings(vit->first,shared_ptr<KeyFramePostings>(pPostings->Compacted(0)));
     }
 }
 
 void KeyFrameDatabase::clear()
 {
-    mvInvertedFile.clear();
-    mvInvertedFile.resize(mpVoc->size());
+    unique_lock<mutex> lock(mMutex);
+
+    for(size_t i=0; i<mvInvertedFile.size(); i++)
+    {
+        if(mvInvertedFile[i])
+            SetPostings(i,shared_ptr<KeyFramePostings>());
+    }
 }
 
 void KeyFrameDatabase::clearMap(Map* pMap)
@@ -76,27 +86,39 @@ void KeyFrameDatabase::clearMap(Map* pMap)
     unique_lock<mutex> lock(mMutex);
 
     // Erase elements in the Inverse File for the entry
-    for(std::vector<list<KeyFrame*> >::iterator vit=mvInvertedFile.begin(), vend=mvInvertedFile.end(); vit!=vend; vit++)
+    for(size_t i=0; i<mvInvertedFile.size(); i++)
     {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =  *vit;
+        // Keyframes that share the word
+        KeyFramePostings* pPostings = mvInvertedFile[i].get();
+        if(!pPostings)
+            continue;
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend;)
+        for(size_t j=0, jend=pPostings->Size(); j<jend; j++)
         {
-            KeyFrame* pKFi = *lit;
-            if(pMap == pKFi->GetMap())
+            KeyFrame* pKFj = pPostings->At(j);
+            if(pKFj && pMap == pKFj->GetMap())
             {
-                lit = lKFs.erase(lit);
+                pPostings->EraseAt(j);
                 // Dont delete the KF because the class Map clean all the KF when it is destroyed
             }
-            else
-            {
-                ++lit;
-            }
         }
+
+        if(pPostings->NeedsCompaction())
+            SetPostings(i,shared_ptr<KeyFramePostings>(pPostings->Compacted(0)));
     }
 }
 
+shared_ptr<KeyFramePostings> KeyFrameDatabase::GetPostings(const unsigned int wordId) const
+{
+    return atomic_load(&mvInvertedFile[wordId]);
+}
+
+void KeyFrameDatabase::SetPostings(const unsigned int wordId, const shared_ptr<KeyFramePostings> &pPostings)
+{
+    // Readers holding the old postings keep them alive until they are done
+    atomic_store(&mvInvertedFile[wordId],pPostings);
+}
+
 vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
 {
     set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
@@ -105,15 +127,17 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
     {
-        unique_lock<mutex> lock(mMutex);
-
         for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
         {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+            shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+            if(!pPostings)
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
             {
-                KeyFrame* pKFi=*lit;
+                KeyFrame* pKFi=pPostings->At(i);
+                if(!pKFi)
+                    continue;
                 if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
                 {
                     if(pKFi->mnLoopQuery!=pKF->mnId)
@@ -233,15 +257,17 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
     {
-        unique_lock<mutex> lock(mMutex);
-
         for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
         {
-            list<KeyFrame*> &lKFs = mvInvertedFile[vit->first];
+            shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+            if(!pPostings)
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
             {
-                KeyFrame* pKFi=*lit;
+                KeyFrame* pKFi=pPostings->At(i);
+                if(!pKFi)
+                    continue;
                 if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
                 {
                     if(pKFi->mnLoopQuery!=pKF->mnId)
@@ -453,11 +479,15 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
 
     for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
     {
-        list<KeyFrame*> &lKFs = mvInvertedFile[vit->first];
+        shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+        if(!pPostings)
+            continue;
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
         {
-            KeyFrame* pKFi=*lit;
+            KeyFrame* pKFi=pPostings->At(i);
+            if(!pKFi)
+                continue;
             pKFi->mnLoopQuery=-1;
             pKFi->mnMergeQuery=-1;
         }
@@ -472,17 +502,19 @@ void KeyFrameDatabase::DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vp
 
     // Search all keyframes that share a word with current frame
     {
-        unique_lock<mutex> lock(mMutex);
-
         spConnectedKF = pKF->GetConnectedKeyFrames();
 
         for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
         {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+            shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+            if(!pPostings)
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
             {
-                KeyFrame* pKFi=*lit;
+                KeyFrame* pKFi=pPostings->At(i);
+                if(!pKFi)
+                    continue;
                 if(spConnectedKF.find(pKFi) != spConnectedKF.end())
                 {
                     continue;
@@ -608,17 +640,19 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &v
 
     // Search all keyframes that share a word with current frame
     {
-        unique_lock<mutex> lock(mMutex);
-
         spConnectedKF = pKF->GetConnectedKeyFrames();
 
         for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
         {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+            shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+            if(!pPostings)
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
             {
-                KeyFrame* pKFi=*lit;
+                KeyFrame* pKFi=pPostings->At(i);
+                if(!pKFi)
+                    continue;
 
                 if(pKFi->mnPlaceRecognitionQuery!=pKF->mnId)
                 {
@@ -736,16 +770,19 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F, Map
 
     // Search all keyframes that share a word with current frame
     {
-        unique_lock<mutex> lock(mMutex);
         // 遍历当前帧的所有单词
         for(DBoW2::BowVector::const_iterator vit=F->mBowVec.begin(), vend=F->mBowVec.end(); vit != vend; vit++)
         {
             // 在倒排数据库里找到所有包含该单词的所有候选关键帧
-            list<KeyFrame*> &lKFs = mvInvertedFile[vit->first];
+            shared_ptr<KeyFramePostings> pPostings = GetPostings(vit->first);
+            if(!pPostings)
+                continue;
             // 遍历候选关键帧
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            for(size_t i=0, iend=pPostings->Size(); i<iend; i++)
             {
-                KeyFrame* pKFi=*lit;
+                KeyFrame* pKFi=pPostings->At(i);
+                if(!pKFi)
+                    continue;
                 // 在本次重定位中第一次被遍历到
                 if(pKFi->mnRelocQuery!=F->mnId)
                 {
@@ -865,6 +902,7 @@ void KeyFrameDatabase::SetORBVocabulary(ORBVocabulary* pORBVoc)
     ptr = (ORBVocabulary**)( &mpVoc );
     *ptr = pORBVoc;
 
+    unique_lock<mutex> lock(mMutex);
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
 }
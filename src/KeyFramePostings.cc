@@ -0,0 +1,80 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "KeyFramePostings.h"
+
+#include <algorithm>
+
+namespace ORB_SLAM3
+{
+
+KeyFramePostings::KeyFramePostings(const size_t nCapacity):
+    mvpKFs(nCapacity), mnSize(0), mnErased(0)
+{
+}
+
+bool KeyFramePostings::Append(KeyFrame* pKF)
+{
+    const size_t n = mnSize.load(std::memory_order_relaxed);
+    if(n==mvpKFs.size())
+        return false;
+
+    // The entry must be visible before the size that exposes it
+    mvpKFs[n].store(pKF,std::memory_order_relaxed);
+    mnSize.store(n+1,std::memory_order_release);
+    return true;
+}
+
+bool KeyFramePostings::Erase(KeyFrame* pKF)
+{
+    const size_t n = mnSize.load(std::memory_order_relaxed);
+    for(size_t i=0; i<n; i++)
+    {
+        if(mvpKFs[i].load(std::memory_order_relaxed)==pKF)
+        {
+            EraseAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void KeyFramePostings::EraseAt(const size_t i)
+{
+    mvpKFs[i].store(static_cast<KeyFrame*>(NULL),std::memory_order_release);
+    mnErased++;
+}
+
+KeyFramePostings* KeyFramePostings::Compacted(const size_t nExtra) const
+{
+    const size_t n = mnSize.load(std::memory_order_relaxed);
+    const size_t nLive = n-mnErased;
+
+    // Grow geometrically so appends stay amortized O(1)
+    KeyFramePostings* pCompacted = new KeyFramePostings(std::max<size_t>(8,2*(nLive+nExtra)));
+    for(size_t i=0; i<n; i++)
+    {
+        KeyFrame* pKF = mvpKFs[i].load(std::memory_order_relaxed);
+        if(pKF)
+            pCompacted->Append(pKF);
+    }
+    return pCompacted;
+}
+
+} //namespace ORB_SLAM3
@@ -0,0 +1,57 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "KeyPointGrid.h"
+
+namespace ORB_SLAM3
+{
+
+KeyPointGrid::KeyPointGrid(): mnCols(0), mnRows(0)
+{
+}
+
+void KeyPointGrid::Build(const int nCols, const int nRows, const std::vector<int> &vCells)
+{
+    mnCols = nCols;
+    mnRows = nRows;
+
+    const int nCells = nCols*nRows;
+
+    // Histogram, shifted by one so the prefix sum gives the start of each cell
+    mvCellStarts.assign(nCells+1,0);
+    for(size_t i=0; i<vCells.size(); i++)
+    {
+        if(vCells[i]>=0)
+            mvCellStarts[vCells[i]+1]++;
+    }
+
+    for(int c=0; c<nCells; c++)
+        mvCellStarts[c+1] += mvCellStarts[c];
+
+    // Scatter, using a running write position per cell
+    mvIndices.resize(mvCellStarts[nCells]);
+    std::vector<unsigned int> vWritePos(mvCellStarts.begin(),mvCellStarts.end()-1);
+    for(size_t i=0; i<vCells.size(); i++)
+    {
+        if(vCells[i]>=0)
+            mvIndices[vWritePos[vCells[i]]++] = i;
+    }
+}
+
+} //namespace ORB_SLAM3
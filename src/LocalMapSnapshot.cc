@@ -0,0 +1,72 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "LocalMapSnapshot.h"
+#include "MapPoint.h"
+
+namespace ORB_SLAM3
+{
+
+void LocalMapSnapshot::Build(const std::vector<MapPoint*> &vpMapPoints)
+{
+    const size_t N = vpMapPoints.size();
+
+    clear();
+    mvpMapPoints.reserve(N);
+    mvnIds.reserve(N);
+    mvX.reserve(N); mvY.reserve(N); mvZ.reserve(N);
+    mvNx.reserve(N); mvNy.reserve(N); mvNz.reserve(N);
+    mvMinDistance.reserve(N);
+    mvMaxDistance.reserve(N);
+    mDescriptors.create(N,32,CV_8U);
+
+    for(size_t i=0; i<N; i++)
+    {
+        MapPoint* pMP = vpMapPoints[i];
+        const size_t n = mvpMapPoints.size();
+        if(!pMP || !pMP->CopyDescriptor(mDescriptors.ptr<unsigned char>(n)))
+            continue;
+
+        Eigen::Vector3f pos, normal;
+        float minDistance, maxDistance;
+        pMP->GetPosNormalDistances(pos,normal,minDistance,maxDistance);
+
+        mvpMapPoints.push_back(pMP);
+        mvnIds.push_back(pMP->mnId);
+        mvX.push_back(pos(0)); mvY.push_back(pos(1)); mvZ.push_back(pos(2));
+        mvNx.push_back(normal(0)); mvNy.push_back(normal(1)); mvNz.push_back(normal(2));
+        mvMinDistance.push_back(minDistance);
+        mvMaxDistance.push_back(maxDistance);
+    }
+
+    mDescriptors = mDescriptors.rowRange(0,mvpMapPoints.size());
+}
+
+void LocalMapSnapshot::clear()
+{
+    mvpMapPoints.clear();
+    mvnIds.clear();
+    mvX.clear(); mvY.clear(); mvZ.clear();
+    mvNx.clear(); mvNy.clear(); mvNz.clear();
+    mvMinDistance.clear();
+    mvMaxDistance.clear();
+    mDescriptors.release();
+}
+
+} //namespace ORB_SLAM3
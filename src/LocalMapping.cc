@@ -23,6 +23,7 @@
 #include "Optimizer.h"
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "ThreadPool.h"
 
 #include<mutex>
 #include<chrono>
@@ -32,8 +33,9 @@ namespace ORB_SLAM3
 
 LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular, bool bInertial, const string &_strSeqName):
     mpSystem(pSys), mbMonocular(bMonocular), mbInertial(bInertial), mbResetRequested(false), mbResetRequestedActiveMap(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas), bInitializing(false),
-    mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
-    mIdxInit(0), mScale(1.0), mInitSect(0), mbNotBA1(true), mbNotBA2(true), mIdxIteration(0), infoInertial(Eigen::MatrixXd::Zero(9,9))
+    mbWakeUp(false), mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
+    mIdxInit(0), mScale(1.0), mInitSect(0), mbNotBA1(true), mbNotBA2(true), mIdxIteration(0), mbFixedLagInertialInit(false), infoInertial(Eigen::MatrixXd::Zero(9,9)),
+    mpInertialPriorMap(static_cast<Map*>(NULL)), mnInertialPriorKFId(0)
 {
     mnMatchesInliers = 0;
 
@@ -44,6 +46,13 @@ LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular,
     mNumLM = 0;
     mNumKFCulling=0;
 
+    mpLocalBAOptimizer = new g2o::SparseOptimizer();
+
+    mpReclaimer = EpochReclaimer::GetInstance();
+    mnReclaimerId = -1;
+    if(mpReclaimer)
+        mnReclaimerId = mpReclaimer->Register("Local Mapping",[this]{ WakeUp(); });
+
 #ifdef REGISTER_TIMES
     nLBA_exec = 0;
     nLBA_abort = 0;
@@ -151,7 +160,7 @@ void LocalMapping::Run()
                     }
                     else
                     {
-                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA);
+                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA,mpLocalBAOptimizer);
                         b_doneLBA = true;
                     }
 
@@ -259,14 +268,17 @@ void LocalMapping::Run()
         else if(Stop() && !mbBadImu)
         {
             // Safe area to stop
-            while(isStopped() && !CheckFinish())
             {
-                usleep(3000);
+                unique_lock<mutex> lock(mMutexStop);
+                mcvStop.wait(lock, [&]{ return !mbStopped || CheckFinish(); });
             }
             if(CheckFinish())
                 break;
         }
 
+        // A finished global BA is applied here, where no local BA is running, so Local Mapping does not stop for it
+        mpLoopCloser->ApplyGlobalBundleAdjustment();
+
         ResetIfRequested();
 
         // Tracking will see that Local Mapping is busy
@@ -275,9 +287,14 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;
 
-        usleep(3000);
+        EnterQuiescentState();
+
+        WaitForWork();
     }
 
+    if(mpReclaimer)
+        mpReclaimer->Unregister(mnReclaimerId);
+
     SetFinish();
 }
 
@@ -286,6 +303,51 @@ void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
     unique_lock<mutex> lock(mMutexNewKFs);
     mlNewKeyFrames.push_back(pKF);
     mbAbortBA=true;
+    mcvNewKFs.notify_one();
+}
+
+void LocalMapping::WaitForWork()
+{
+    unique_lock<mutex> lock(mMutexNewKFs);
+    mcvNewKFs.wait(lock, [&]{ return mbWakeUp || (!mlNewKeyFrames.empty() && !mbBadImu); });
+    mbWakeUp = false;
+}
+
+void LocalMapping::EnterQuiescentState()
+{
+    if(!mpReclaimer)
+        return;
+
+    for(list<MapPoint*>::iterator lit=mlpRecentAddedMapPoints.begin(); lit!=mlpRecentAddedMapPoints.end();)
+    {
+        if((*lit)->isBad())
+            lit = mlpRecentAddedMapPoints.erase(lit);
+        else
+            lit++;
+    }
+
+    {
+        unique_lock<mutex> lock(mMutexNewKFs);
+        for(list<KeyFrame*>::iterator lit=mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
+        {
+            KeyFrame* pKF = *lit;
+            const vector<MapPoint*> vpMapPointMatches = pKF->GetMapPointMatches();
+            for(size_t i=0; i<vpMapPointMatches.size(); i++)
+            {
+                if(vpMapPointMatches[i] && vpMapPointMatches[i]->isBad())
+                    pKF->EraseMapPointMatch(i);
+            }
+        }
+    }
+
+    mpReclaimer->Quiesce(mnReclaimerId);
+}
+
+void LocalMapping::WakeUp()
+{
+    unique_lock<mutex> lock(mMutexNewKFs);
+    mbWakeUp = true;
+    mcvNewKFs.notify_one();
 }
 
 
@@ -334,6 +396,11 @@ void LocalMapping::ProcessNewKeyFrame()
                     mlpRecentAddedMapPoints.push_back(pMP);
                 }
             }
+            else
+            {
+                // Culled while the keyframe was queued, do not keep it in the map
+                mpCurrentKeyFrame->EraseMapPointMatch(i);
+            }
         }
     }
 
@@ -428,6 +495,68 @@ void LocalMapping::CreateNewMapPoints()
             pKF = pKF->mPrevKF;
         }
     }
+    const int nNeighs = vpNeighKFs.size();
+
+    // Search matches with epipolar restriction and triangulate, in parallel over the neighbors.
+    // Nothing is added to the map here.
+    vector<vector<TriangulatedPoint> > vvTriangulated(nNeighs);
+    vector<char> vbAborted(nNeighs,false);
+
+    auto triangulate = [&](const int i)
+    {
+        // 检测是否有新的关键帧，如果有则中断后续处理，优先处理新的关键帧，保证实时性
+        if(i>0 && CheckNewKeyFrames())
+        {
+            vbAborted[i] = true;
+            return;
+        }
+        TriangulateWithNeighbor(vpNeighKFs[i],vvTriangulated[i]);
+    };
+
+    if(ThreadPool* pThreadPool = ThreadPool::GetInstance())
+        pThreadPool->ParallelFor(0,nNeighs,triangulate);
+    else
+        for(int i=0; i<nNeighs; i++)
+            triangulate(i);
+
+    // Create the MapPoints in neighbor order. A keypoint triangulated with several neighbors keeps
+    // the point of the first (most covisible) one, the others are dropped.
+    for(int i=0; i<nNeighs; i++)
+    {
+        if(vbAborted[i])
+            return;
+
+        KeyFrame* pKF2 = vpNeighKFs[i];
+        const vector<TriangulatedPoint> &vTriangulated = vvTriangulated[i];
+        for(size_t j=0; j<vTriangulated.size(); j++)
+        {
+            const size_t idx1 = vTriangulated[j].idx1;
+            const size_t idx2 = vTriangulated[j].idx2;
+            if(mpCurrentKeyFrame->GetMapPoint(idx1) || pKF2->GetMapPoint(idx2))
+                continue;
+
+            // Triangulation is succesfull
+            // 检查完毕，质量不错，作为地图点加入地图
+            MapPoint* pMP = new MapPoint(vTriangulated[j].x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
+
+            pMP->AddObservation(mpCurrentKeyFrame,idx1);
+            pMP->AddObservation(pKF2,idx2);
+
+            mpCurrentKeyFrame->AddMapPoint(pMP,idx1);
+            pKF2->AddMapPoint(pMP,idx2);
+
+            pMP->ComputeDistinctiveDescriptors();
+
+            pMP->UpdateNormalAndDepth();
+
+            mpAtlas->AddMapPoint(pMP);
+            mlpRecentAddedMapPoints.push_back(pMP);
+        }
+    }
+}
+
+void LocalMapping::TriangulateWithNeighbor(KeyFrame* pKF2, vector<TriangulatedPoint> &vTriangulated)
+{
     // 匹配阈值
     float th = 0.6f;
 
@@ -453,308 +582,289 @@ void LocalMapping::CreateNewMapPoints()
     int countStereoGoodProj = 0;
     int countStereoAttempt = 0;
     int totalStereoPts = 0;
-    // Search matches with epipolar restriction and triangulate
-    // 根据对极约束进行匹配，三角化
-    for(size_t i=0; i<vpNeighKFs.size(); i++)
+
+    GeometricCamera* pCamera1 = mpCurrentKeyFrame->mpCamera, *pCamera2 = pKF2->mpCamera;
+
+    // Check first that baseline is not too short
+    Eigen::Vector3f Ow2 = pKF2->GetCameraCenter();
+    // 计算两帧基线向量和长度
+    Eigen::Vector3f vBaseline = Ow2-Ow1;
+    const float baseline = vBaseline.norm();
+    // 判断两帧视差，足够大才能用来三角化
+    if(!mbMonocular)
     {
-        // 检测是否有新的关键帧，如果有则中断后续处理，优先处理新的关键帧，保证实时性
-        if(i>0 && CheckNewKeyFrames())
+        // 如果是双目，则同相机的基线比较
+        // 两帧基线长度短于相机基线长度则不用来三角化
+        if(baseline<pKF2->mb)
             return;
+    }
+    else
+    {
+        // 如果是单目，则计算特征点深度的中值，如果基线/中值<0.01则不用来三角化
+        const float medianDepthKF2 = pKF2->ComputeSceneMedianDepth(2);
+        const float ratioBaselineDepth = baseline/medianDepthKF2;
 
-        KeyFrame* pKF2 = vpNeighKFs[i];
-        
-        GeometricCamera* pCamera1 = mpCurrentKeyFrame->mpCamera, *pCamera2 = pKF2->mpCamera;
-
-        // Check first that baseline is not too short
-        Eigen::Vector3f Ow2 = pKF2->GetCameraCenter();
-        // 计算两帧基线向量和长度
-        Eigen::Vector3f vBaseline = Ow2-Ow1;
-        const float baseline = vBaseline.norm();
-        // 判断两帧视差，足够大才能用来三角化
-        if(!mbMonocular)
-        {
-            // 如果是双目，则同相机的基线比较
-            // 两帧基线长度短于相机基线长度则不用来三角化
-            if(baseline<pKF2->mb)
-                continue;
-        }
-        else
-        {
-            // 如果是单目，则计算特征点深度的中值，如果基线/中值<0.01则不用来三角化
-            const float medianDepthKF2 = pKF2->ComputeSceneMedianDepth(2);
-            const float ratioBaselineDepth = baseline/medianDepthKF2;
-
-            if(ratioBaselineDepth<0.01)
-                continue;
-        }
+        if(ratioBaselineDepth<0.01)
+            return;
+    }
 
-        // Search matches that fullfil epipolar constraint
-        vector<pair<size_t,size_t> > vMatchedIndices;
-        // IMU+RECENTLY_LOST+已初始化优化三次（TODO，给后面找匹配点用的一个状态位，还没看懒的看）
-        bool bCoarse = mbInertial && mpTracker->mState==Tracking::RECENTLY_LOST && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
-        // 通过对极约束找到两帧的匹配点（已经生成了地图点的特征点会跳过）
-        matcher.SearchForTriangulation(mpCurrentKeyFrame,pKF2,vMatchedIndices,false,bCoarse);
-        // 第二帧的位姿，参数初始化
-        Sophus::SE3<float> sophTcw2 = pKF2->GetPose();
-        Eigen::Matrix<float,3,4> eigTcw2 = sophTcw2.matrix3x4();
-        Eigen::Matrix<float,3,3> Rcw2 = eigTcw2.block<3,3>(0,0);
-        Eigen::Matrix<float,3,3> Rwc2 = Rcw2.transpose();
-        Eigen::Vector3f tcw2 = sophTcw2.translation();
-
-        const float &fx2 = pKF2->fx;
-        const float &fy2 = pKF2->fy;
-        const float &cx2 = pKF2->cx;
-        const float &cy2 = pKF2->cy;
-        const float &invfx2 = pKF2->invfx;
-        const float &invfy2 = pKF2->invfy;
-
-        // Triangulate each match
-        const int nmatches = vMatchedIndices.size();
-        // 对每个新得到的匹配点进行三角化得地图点
-        for(int ikp=0; ikp<nmatches; ikp++)
-        {
-            // 两点下标
-            const int &idx1 = vMatchedIndices[ikp].first;
-            const int &idx2 = vMatchedIndices[ikp].second;
-            // 根据相机类型，取出对应的特征点
-            const cv::KeyPoint &kp1 = (mpCurrentKeyFrame -> NLeft == -1) ? mpCurrentKeyFrame->mvKeysUn[idx1]
-                                                                         : (idx1 < mpCurrentKeyFrame -> NLeft) ? mpCurrentKeyFrame -> mvKeys[idx1]
-            // TODO 不知道是什么                                                                                                   : mpCurrentKeyFrame -> mvKeysRight[idx1 - mpCurrentKeyFrame -> NLeft];
-            const float kp1_ur=mpCurrentKeyFrame->mvuRight[idx1];
-            bool bStereo1 = (!mpCurrentKeyFrame->mpCamera2 && kp1_ur>=0);
-            const bool bRight1 = (mpCurrentKeyFrame -> NLeft == -1 || idx1 < mpCurrentKeyFrame -> NLeft) ? false
-                                                                                                         : true;
-
-            const cv::KeyPoint &kp2 = (pKF2 -> NLeft == -1) ? pKF2->mvKeysUn[idx2]
-                                                            : (idx2 < pKF2 -> NLeft) ? pKF2 -> mvKeys[idx2]
-                                                                                     : pKF2 -> mvKeysRight[idx2 - pKF2 -> NLeft];
-
-            const float kp2_ur = pKF2->mvuRight[idx2];
-            bool bStereo2 = (!pKF2->mpCamera2 && kp2_ur>=0);
-            const bool bRight2 = (pKF2 -> NLeft == -1 || idx2 < pKF2 -> NLeft) ? false
-                                                                               : true;
-            // 如果是两个相机时，根据不同情况获取两个相机的位姿和光心位置
-            if(mpCurrentKeyFrame->mpCamera2 && pKF2->mpCamera2){
-                if(bRight1 && bRight2){
-                    sophTcw1 = mpCurrentKeyFrame->GetRightPose();
-                    Ow1 = mpCurrentKeyFrame->GetRightCameraCenter();
-
-                    sophTcw2 = pKF2->GetRightPose();
-                    Ow2 = pKF2->GetRightCameraCenter();
-
-                    pCamera1 = mpCurrentKeyFrame->mpCamera2;
-                    pCamera2 = pKF2->mpCamera2;
-                }
-                else if(bRight1 && !bRight2){
-                    sophTcw1 = mpCurrentKeyFrame->GetRightPose();
-                    Ow1 = mpCurrentKeyFrame->GetRightCameraCenter();
+    // Search matches that fullfil epipolar constraint
+    vector<pair<size_t,size_t> > vMatchedIndices;
+    // IMU+RECENTLY_LOST+已初始化优化三次（TODO，给后面找匹配点用的一个状态位，还没看懒的看）
+    bool bCoarse = mbInertial && mpTracker->mState==Tracking::RECENTLY_LOST && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
+    // 通过对极约束找到两帧的匹配点（已经生成了地图点的特征点会跳过）
+    matcher.SearchForTriangulation(mpCurrentKeyFrame,pKF2,vMatchedIndices,false,bCoarse);
+    // 第二帧的位姿，参数初始化
+    Sophus::SE3<float> sophTcw2 = pKF2->GetPose();
+    Eigen::Matrix<float,3,4> eigTcw2 = sophTcw2.matrix3x4();
+    Eigen::Matrix<float,3,3> Rcw2 = eigTcw2.block<3,3>(0,0);
+    Eigen::Matrix<float,3,3> Rwc2 = Rcw2.transpose();
+    Eigen::Vector3f tcw2 = sophTcw2.translation();
+
+    const float &fx2 = pKF2->fx;
+    const float &fy2 = pKF2->fy;
+    const float &cx2 = pKF2->cx;
+    const float &cy2 = pKF2->cy;
+    const float &invfx2 = pKF2->invfx;
+    const float &invfy2 = pKF2->invfy;
+
+    // Triangulate each match
+    const int nmatches = vMatchedIndices.size();
+    // 对每个新得到的匹配点进行三角化得地图点
+    for(int ikp=0; ikp<nmatches; ikp++)
+    {
+        // 两点下标
+        const int &idx1 = vMatchedIndices[ikp].first;
+        const int &idx2 = vMatchedIndices[ikp].second;
+        // 根据相机类型，取出对应的特征点
+        const cv::KeyPoint &kp1 = (mpCurrentKeyFrame -> NLeft == -1) ? mpCurrentKeyFrame->mvKeysUn[idx1]
+                                                                     : (idx1 < mpCurrentKeyFrame -> NLeft) ? mpCurrentKeyFrame -> mvKeys[idx1]
+        // TODO 不知道是什么                                                                                                   : mpCurrentKeyFrame -> mvKeysRight[idx1 - mpCurrentKeyFrame -> NLeft];
+        const float kp1_ur=mpCurrentKeyFrame->mvuRight[idx1];
+        bool bStereo1 = (!mpCurrentKeyFrame->mpCamera2 && kp1_ur>=0);
+        const bool bRight1 = (mpCurrentKeyFrame -> NLeft == -1 || idx1 < mpCurrentKeyFrame -> NLeft) ? false
+                                                                                                     : true;
+
+        const cv::KeyPoint &kp2 = (pKF2 -> NLeft == -1) ? pKF2->mvKeysUn[idx2]
+                                                        : (idx2 < pKF2 -> NLeft) ? pKF2 -> mvKeys[idx2]
+                                                                                 : pKF2 -> mvKeysRight[idx2 - pKF2 -> NLeft];
+
+        const float kp2_ur = pKF2->mvuRight[idx2];
+        bool bStereo2 = (!pKF2->mpCamera2 && kp2_ur>=0);
+        const bool bRight2 = (pKF2 -> NLeft == -1 || idx2 < pKF2 -> NLeft) ? false
+                                                                           : true;
+        // 如果是两个相机时，根据不同情况获取两个相机的位姿和光心位置
+        if(mpCurrentKeyFrame->mpCamera2 && pKF2->mpCamera2){
+            if(bRight1 && bRight2){
+                sophTcw1 = mpCurrentKeyFrame->GetRightPose();
+                Ow1 = mpCurrentKeyFrame->GetRightCameraCenter();
+
+                sophTcw2 = pKF2->GetRightPose();
+                Ow2 = pKF2->GetRightCameraCenter();
+
+                pCamera1 = mpCurrentKeyFrame->mpCamera2;
+                pCamera2 = pKF2->mpCamera2;
+            }
+            else if(bRight1 && !bRight2){
+                sophTcw1 = mpCurrentKeyFrame->GetRightPose();
+                Ow1 = mpCurrentKeyFrame->GetRightCameraCenter();
 
-                    sophTcw2 = pKF2->GetPose();
-                    Ow2 = pKF2->GetCameraCenter();
+                sophTcw2 = pKF2->GetPose();
+                Ow2 = pKF2->GetCameraCenter();
 
-                    pCamera1 = mpCurrentKeyFrame->mpCamera2;
-                    pCamera2 = pKF2->mpCamera;
-                }
-                else if(!bRight1 && bRight2){
-                    sophTcw1 = mpCurrentKeyFrame->GetPose();
-                    Ow1 = mpCurrentKeyFrame->GetCameraCenter();
+                pCamera1 = mpCurrentKeyFrame->mpCamera2;
+                pCamera2 = pKF2->mpCamera;
+            }
+            else if(!bRight1 && bRight2){
+                sophTcw1 = mpCurrentKeyFrame->GetPose();
+                Ow1 = mpCurrentKeyFrame->GetCameraCenter();
 
-                    sophTcw2 = pKF2->GetRightPose();
-                    Ow2 = pKF2->GetRightCameraCenter();
+                sophTcw2 = pKF2->GetRightPose();
+                Ow2 = pKF2->GetRightCameraCenter();
 
-                    pCamera1 = mpCurrentKeyFrame->mpCamera;
-                    pCamera2 = pKF2->mpCamera2;
-                }
-                else{
-                    sophTcw1 = mpCurrentKeyFrame->GetPose();
-                    Ow1 = mpCurrentKeyFrame->GetCameraCenter();
-
-                    sophTcw2 = pKF2->GetPose();
-                    Ow2 = pKF2->GetCameraCenter();
- 
-                    pCamera1 = mpCurrentKeyFrame->mpCamera;
-                    pCamera2 = pKF2->mpCamera;
-                }
-                eigTcw1 = sophTcw1.matrix3x4();
-                Rcw1 = eigTcw1.block<3,3>(0,0);
-                Rwc1 = Rcw1.transpose();
-                tcw1 = sophTcw1.translation();
-
-                eigTcw2 = sophTcw2.matrix3x4();
-                Rcw2 = eigTcw2.block<3,3>(0,0);
-                Rwc2 = Rcw2.transpose();
-                tcw2 = sophTcw2.translation();
+                pCamera1 = mpCurrentKeyFrame->mpCamera;
+                pCamera2 = pKF2->mpCamera2;
             }
+            else{
+                sophTcw1 = mpCurrentKeyFrame->GetPose();
+                Ow1 = mpCurrentKeyFrame->GetCameraCenter();
 
-            // Check parallax between rays
-            // 将2D点反投影到相机坐标系下的3D点
-            Eigen::Vector3f xn1 = pCamera1->unprojectEig(kp1.pt);
-            Eigen::Vector3f xn2 = pCamera2->unprojectEig(kp2.pt);
-            // 通过位姿变换到世界坐标系下
-            Eigen::Vector3f ray1 = Rwc1 * xn1;
-            Eigen::Vector3f ray2 = Rwc2 * xn2;
-            // 两点射线的夹角余弦值
-            const float cosParallaxRays = ray1.dot(ray2)/(ray1.norm() * ray2.norm());
-
-            // 初始化用于双目时的夹角余弦值，+1超过cos的值域，方便后面取min
-            float cosParallaxStereo = cosParallaxRays+1;
-            float cosParallaxStereo1 = cosParallaxStereo;
-            float cosParallaxStereo2 = cosParallaxStereo;
-            // 若第一帧是双目，则计算第一帧通过双目自身计算的夹角余弦值
-            if(bStereo1)
-                cosParallaxStereo1 = cos(2*atan2(mpCurrentKeyFrame->mb/2,mpCurrentKeyFrame->mvDepth[idx1]));
-            // 若第二帧是双目，则计算第二帧通过双目自身计算的夹角余弦值
-            else if(bStereo2)
-                cosParallaxStereo2 = cos(2*atan2(pKF2->mb/2,pKF2->mvDepth[idx2]));
-
-            if (bStereo1 || bStereo2) totalStereoPts++;
-            // 取两帧中较大的视差角作为双目的视差角
-            cosParallaxStereo = min(cosParallaxStereo1,cosParallaxStereo2);
-
-            Eigen::Vector3f x3D;
-
-            bool goodProj = false;
-            bool bPointStereo = false;
-            // 如果两帧的视差角大于双目的视差角（余弦值更小），则通过两帧三角化来获得三维点
-            if(cosParallaxRays<cosParallaxStereo && cosParallaxRays>0 && (bStereo1 || bStereo2 ||
-                                                                          (cosParallaxRays<0.9996 && mbInertial) || (cosParallaxRays<0.9998 && !mbInertial)))
-            {
-                goodProj = GeometricTools::Triangulate(xn1, xn2, eigTcw1, eigTcw2, x3D);
-                if(!goodProj)
-                    continue;
-            }
-            // 否则通过视差角更大的那一帧双目相机来获得三维点
-            else if(bStereo1 && cosParallaxStereo1<cosParallaxStereo2)
-            {
-                countStereoAttempt++;
-                bPointStereo = true;
-                goodProj = mpCurrentKeyFrame->UnprojectStereo(idx1, x3D);
-            }
-            else if(bStereo2 && cosParallaxStereo2<cosParallaxStereo1)
-            {
-                countStereoAttempt++;
-                bPointStereo = true;
-                goodProj = pKF2->UnprojectStereo(idx2, x3D);
-            }
-            else
-            {
-                continue; //No stereo and very low parallax
-            }
+                sophTcw2 = pKF2->GetPose();
+                Ow2 = pKF2->GetCameraCenter();
 
-            if(goodProj && bPointStereo)
-                countStereoGoodProj++;
+                pCamera1 = mpCurrentKeyFrame->mpCamera;
+                pCamera2 = pKF2->mpCamera;
+            }
+            eigTcw1 = sophTcw1.matrix3x4();
+            Rcw1 = eigTcw1.block<3,3>(0,0);
+            Rwc1 = Rcw1.transpose();
+            tcw1 = sophTcw1.translation();
+
+            eigTcw2 = sophTcw2.matrix3x4();
+            Rcw2 = eigTcw2.block<3,3>(0,0);
+            Rwc2 = Rcw2.transpose();
+            tcw2 = sophTcw2.translation();
+        }
 
+        // Check parallax between rays
+        // 将2D点反投影到相机坐标系下的3D点
+        Eigen::Vector3f xn1 = pCamera1->unprojectEig(kp1.pt);
+        Eigen::Vector3f xn2 = pCamera2->unprojectEig(kp2.pt);
+        // 通过位姿变换到世界坐标系下
+        Eigen::Vector3f ray1 = Rwc1 * xn1;
+        Eigen::Vector3f ray2 = Rwc2 * xn2;
+        // 两点射线的夹角余弦值
+        const float cosParallaxRays = ray1.dot(ray2)/(ray1.norm() * ray2.norm());
+
+        // 初始化用于双目时的夹角余弦值，+1超过cos的值域，方便后面取min
+        float cosParallaxStereo = cosParallaxRays+1;
+        float cosParallaxStereo1 = cosParallaxStereo;
+        float cosParallaxStereo2 = cosParallaxStereo;
+        // 若第一帧是双目，则计算第一帧通过双目自身计算的夹角余弦值
+        if(bStereo1)
+            cosParallaxStereo1 = cos(2*atan2(mpCurrentKeyFrame->mb/2,mpCurrentKeyFrame->mvDepth[idx1]));
+        // 若第二帧是双目，则计算第二帧通过双目自身计算的夹角余弦值
+        else if(bStereo2)
+            cosParallaxStereo2 = cos(2*atan2(pKF2->mb/2,pKF2->mvDepth[idx2]));
+
+        if (bStereo1 || bStereo2) totalStereoPts++;
+        // 取两帧中较大的视差角作为双目的视差角
+        cosParallaxStereo = min(cosParallaxStereo1,cosParallaxStereo2);
+
+        Eigen::Vector3f x3D;
+
+        bool goodProj = false;
+        bool bPointStereo = false;
+        // 如果两帧的视差角大于双目的视差角（余弦值更小），则通过两帧三角化来获得三维点
+        if(cosParallaxRays<cosParallaxStereo && cosParallaxRays>0 && (bStereo1 || bStereo2 ||
+                                                                      (cosParallaxRays<0.9996 && mbInertial) || (cosParallaxRays<0.9998 && !mbInertial)))
+        {
+            goodProj = GeometricTools::Triangulate(xn1, xn2, eigTcw1, eigTcw2, x3D);
             if(!goodProj)
                 continue;
+        }
+        // 否则通过视差角更大的那一帧双目相机来获得三维点
+        else if(bStereo1 && cosParallaxStereo1<cosParallaxStereo2)
+        {
+            countStereoAttempt++;
+            bPointStereo = true;
+            goodProj = mpCurrentKeyFrame->UnprojectStereo(idx1, x3D);
+        }
+        else if(bStereo2 && cosParallaxStereo2<cosParallaxStereo1)
+        {
+            countStereoAttempt++;
+            bPointStereo = true;
+            goodProj = pKF2->UnprojectStereo(idx2, x3D);
+        }
+        else
+        {
+            continue; //No stereo and very low parallax
+        }
 
-            //Check triangulation in front of cameras
-            // 检测深度值是否>0
-            float z1 = Rcw1.row(2).dot(x3D) + tcw1(2);
-            if(z1<=0)
-                continue;
-
-            float z2 = Rcw2.row(2).dot(x3D) + tcw2(2);
-            if(z2<=0)
-                continue;
-
-            //Check reprojection error in first keyframe
-            // 计算第一帧的重投影误差
-            const float &sigmaSquare1 = mpCurrentKeyFrame->mvLevelSigma2[kp1.octave];
-            const float x1 = Rcw1.row(0).dot(x3D)+tcw1(0);
-            const float y1 = Rcw1.row(1).dot(x3D)+tcw1(1);
-            const float invz1 = 1.0/z1;
-            // 单目情况下
-            if(!bStereo1)
-            {
-                cv::Point2f uv1 = pCamera1->project(cv::Point3f(x1,y1,z1));
-                float errX1 = uv1.x - kp1.pt.x;
-                float errY1 = uv1.y - kp1.pt.y;
-                // x,y的误差要满足卡方校验阈值
-                if((errX1*errX1+errY1*errY1)>5.991*sigmaSquare1)
-                    continue;
+        if(goodProj && bPointStereo)
+            countStereoGoodProj++;
 
-            }
-            else
-            {
-                // 双目情况
-                float u1 = fx1*x1*invz1+cx1;
-                float u1_r = u1 - mpCurrentKeyFrame->mbf*invz1;
-                float v1 = fy1*y1*invz1+cy1;
-                float errX1 = u1 - kp1.pt.x;
-                float errY1 = v1 - kp1.pt.y;
-                float errX1_r = u1_r - kp1_ur;
-                if((errX1*errX1+errY1*errY1+errX1_r*errX1_r)>7.8*sigmaSquare1)
-                    continue;
-            }
+        if(!goodProj)
+            continue;
 
-            //Check reprojection error in second keyframe
-            // 第二帧重投影误差
-            const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
-            const float x2 = Rcw2.row(0).dot(x3D)+tcw2(0);
-            const float y2 = Rcw2.row(1).dot(x3D)+tcw2(1);
-            const float invz2 = 1.0/z2;
-            if(!bStereo2)
-            {
-                cv::Point2f uv2 = pCamera2->project(cv::Point3f(x2,y2,z2));
-                float errX2 = uv2.x - kp2.pt.x;
-                float errY2 = uv2.y - kp2.pt.y;
-                if((errX2*errX2+errY2*errY2)>5.991*sigmaSquare2)
-                    continue;
-            }
-            else
-            {
-                float u2 = fx2*x2*invz2+cx2;
-                float u2_r = u2 - mpCurrentKeyFrame->mbf*invz2;
-                float v2 = fy2*y2*invz2+cy2;
-                float errX2 = u2 - kp2.pt.x;
-                float errY2 = v2 - kp2.pt.y;
-                float errX2_r = u2_r - kp2_ur;
-                if((errX2*errX2+errY2*errY2+errX2_r*errX2_r)>7.8*sigmaSquare2)
-                    continue;
-            }
+        //Check triangulation in front of cameras
+        // 检测深度值是否>0
+        float z1 = Rcw1.row(2).dot(x3D) + tcw1(2);
+        if(z1<=0)
+            continue;
 
-            //Check scale consistency
-            // 检测尺度一致性
-            // 获取相机光心到3D点的两个向量及长度
-            Eigen::Vector3f normal1 = x3D - Ow1;
-            float dist1 = normal1.norm();
+        float z2 = Rcw2.row(2).dot(x3D) + tcw2(2);
+        if(z2<=0)
+            continue;
 
-            Eigen::Vector3f normal2 = x3D - Ow2;
-            float dist2 = normal2.norm();
+        //Check reprojection error in first keyframe
+        // 计算第一帧的重投影误差
+        const float &sigmaSquare1 = mpCurrentKeyFrame->mvLevelSigma2[kp1.octave];
+        const float x1 = Rcw1.row(0).dot(x3D)+tcw1(0);
+        const float y1 = Rcw1.row(1).dot(x3D)+tcw1(1);
+        const float invz1 = 1.0/z1;
+        // 单目情况下
+        if(!bStereo1)
+        {
+            cv::Point2f uv1 = pCamera1->project(cv::Point3f(x1,y1,z1));
+            float errX1 = uv1.x - kp1.pt.x;
+            float errY1 = uv1.y - kp1.pt.y;
+            // x,y的误差要满足卡方校验阈值
+            if((errX1*errX1+errY1*errY1)>5.991*sigmaSquare1)
+                continue;
 
-            if(dist1==0 || dist2==0)
+        }
+        else
+        {
+            // 双目情况
+            float u1 = fx1*x1*invz1+cx1;
+            float u1_r = u1 - mpCurrentKeyFrame->mbf*invz1;
+            float v1 = fy1*y1*invz1+cy1;
+            float errX1 = u1 - kp1.pt.x;
+            float errY1 = v1 - kp1.pt.y;
+            float errX1_r = u1_r - kp1_ur;
+            if((errX1*errX1+errY1*errY1+errX1_r*errX1_r)>7.8*sigmaSquare1)
                 continue;
+        }
 
-            if(mbFarPoints && (dist1>=mThFarPoints||dist2>=mThFarPoints)) // MODIFICATION
+        //Check reprojection error in second keyframe
+        // 第二帧重投影误差
+        const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
+        const float x2 = Rcw2.row(0).dot(x3D)+tcw2(0);
+        const float y2 = Rcw2.row(1).dot(x3D)+tcw2(1);
+        const float invz2 = 1.0/z2;
+        if(!bStereo2)
+        {
+            cv::Point2f uv2 = pCamera2->project(cv::Point3f(x2,y2,z2));
+            float errX2 = uv2.x - kp2.pt.x;
+            float errY2 = uv2.y - kp2.pt.y;
+            if((errX2*errX2+errY2*errY2)>5.991*sigmaSquare2)
                 continue;
-            // 距离比例
-            const float ratioDist = dist2/dist1;
-            // 金字塔比例
-            const float ratioOctave = mpCurrentKeyFrame->mvScaleFactors[kp1.octave]/pKF2->mvScaleFactors[kp2.octave];
-            // 距离比例不应该和金字塔比例差太多
-            if(ratioDist*ratioFactor<ratioOctave || ratioDist>ratioOctave*ratioFactor)
+        }
+        else
+        {
+            float u2 = fx2*x2*invz2+cx2;
+            float u2_r = u2 - mpCurrentKeyFrame->mbf*invz2;
+            float v2 = fy2*y2*invz2+cy2;
+            float errX2 = u2 - kp2.pt.x;
+            float errY2 = v2 - kp2.pt.y;
+            float errX2_r = u2_r - kp2_ur;
+            if((errX2*errX2+errY2*errY2+errX2_r*errX2_r)>7.8*sigmaSquare2)
                 continue;
+        }
 
-            // Triangulation is succesfull
-            // 检查完毕，质量不错，作为地图点加入地图
-            MapPoint* pMP = new MapPoint(x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
-            if (bPointStereo)
-                countStereo++;
-            
-            pMP->AddObservation(mpCurrentKeyFrame,idx1);
-            pMP->AddObservation(pKF2,idx2);
+        //Check scale consistency
+        // 检测尺度一致性
+        // 获取相机光心到3D点的两个向量及长度
+        Eigen::Vector3f normal1 = x3D - Ow1;
+        float dist1 = normal1.norm();
 
-            mpCurrentKeyFrame->AddMapPoint(pMP,idx1);
-            pKF2->AddMapPoint(pMP,idx2);
+        Eigen::Vector3f normal2 = x3D - Ow2;
+        float dist2 = normal2.norm();
 
-            pMP->ComputeDistinctiveDescriptors();
+        if(dist1==0 || dist2==0)
+            continue;
 
-            pMP->UpdateNormalAndDepth();
+        if(mbFarPoints && (dist1>=mThFarPoints||dist2>=mThFarPoints)) // MODIFICATION
+            continue;
+        // 距离比例
+        const float ratioDist = dist2/dist1;
+        // 金字塔比例
+        const float ratioOctave = mpCurrentKeyFrame->mvScaleFactors[kp1.octave]/pKF2->mvScaleFactors[kp2.octave];
+        // 距离比例不应该和金字塔比例差太多
+        if(ratioDist*ratioFactor<ratioOctave || ratioDist>ratioOctave*ratioFactor)
+            continue;
 
-            mpAtlas->AddMapPoint(pMP);
-            mlpRecentAddedMapPoints.push_back(pMP);
-        }
-    }    
+        // Triangulation is succesfull
+        TriangulatedPoint point;
+        point.x3D = x3D;
+        point.idx1 = idx1;
+        point.idx2 = idx2;
+        vTriangulated.push_back(point);
+
+        if (bPointStereo)
+            countStereo++;
+    }
 }
 
 void LocalMapping::SearchInNeighbors()
@@ -818,14 +928,32 @@ void LocalMapping::SearchInNeighbors()
 
     // Search matches by projection from current KF in target KFs
     // 将当前帧的地图点投影到相邻帧中，寻找相同的地图点，进行融合
+    // The searches only read the map and run in parallel over the target keyframes, the fusions are
+    // then applied one keyframe after another in the order of vpTargetKFs
     ORBmatcher matcher;
+    ThreadPool* pThreadPool = ThreadPool::GetInstance();
     vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
-    for(vector<KeyFrame*>::iterator vit=vpTargetKFs.begin(), vend=vpTargetKFs.end(); vit!=vend; vit++)
+    const int nTargetKFs = vpTargetKFs.size();
+    vector<vector<pair<MapPoint*,size_t> > > vvFuse(nTargetKFs), vvFuseRight(nTargetKFs);
+
+    auto searchTarget = [&](const int i)
     {
-        KeyFrame* pKFi = *vit;
+        KeyFrame* pKFi = vpTargetKFs[i];
+        ORBmatcher matcheri;
+        matcheri.SearchFuse(pKFi,vpMapPointMatches,vvFuse[i]);
+        if(pKFi->NLeft != -1) matcheri.SearchFuse(pKFi,vpMapPointMatches,vvFuseRight[i],3.0,true);
+    };
+
+    if(pThreadPool)
+        pThreadPool->ParallelFor(0,nTargetKFs,searchTarget);
+    else
+        for(int i=0; i<nTargetKFs; i++)
+            searchTarget(i);
 
-        matcher.Fuse(pKFi,vpMapPointMatches);
-        if(pKFi->NLeft != -1) matcher.Fuse(pKFi,vpMapPointMatches,true);
+    for(int i=0; i<nTargetKFs; i++)
+    {
+        matcher.ApplyFuse(vpTargetKFs[i],vvFuse[i]);
+        matcher.ApplyFuse(vpTargetKFs[i],vvFuseRight[i]);
     }
 
 
@@ -856,9 +984,37 @@ void LocalMapping::SearchInNeighbors()
         }
     }
     // 将候选列表的地图点投影到当前帧，进行融合
-    matcher.Fuse(mpCurrentKeyFrame,vpFuseCandidates);
     // 如果是双目，额外再投影到右目，进行融合
-    if(mpCurrentKeyFrame->NLeft != -1) matcher.Fuse(mpCurrentKeyFrame,vpFuseCandidates,true);
+    // Searched in parallel over blocks of candidates, applied in the order of vpFuseCandidates
+    const int nBlockSize = 128;
+    const int nBlocks = (vpFuseCandidates.size()+nBlockSize-1)/nBlockSize;
+    vector<vector<pair<MapPoint*,size_t> > > vvFuseBlocks(nBlocks), vvFuseBlocksRight(nBlocks);
+
+    auto searchBlock = [&](const int iBlock)
+    {
+        const vector<MapPoint*>::const_iterator itBegin = vpFuseCandidates.begin() + iBlock*nBlockSize;
+        const vector<MapPoint*>::const_iterator itEnd = vpFuseCandidates.begin() + min((iBlock+1)*nBlockSize,(int)vpFuseCandidates.size());
+        const vector<MapPoint*> vpBlock(itBegin,itEnd);
+
+        ORBmatcher matcheri;
+        matcheri.SearchFuse(mpCurrentKeyFrame,vpBlock,vvFuseBlocks[iBlock]);
+        if(mpCurrentKeyFrame->NLeft != -1) matcheri.SearchFuse(mpCurrentKeyFrame,vpBlock,vvFuseBlocksRight[iBlock],3.0,true);
+    };
+
+    if(pThreadPool)
+        pThreadPool->ParallelFor(0,nBlocks,searchBlock);
+    else
+        for(int iBlock=0; iBlock<nBlocks; iBlock++)
+            searchBlock(iBlock);
+
+    vector<pair<MapPoint*,size_t> > vFuse, vFuseRight;
+    for(int iBlock=0; iBlock<nBlocks; iBlock++)
+    {
+        vFuse.insert(vFuse.end(),vvFuseBlocks[iBlock].begin(),vvFuseBlocks[iBlock].end());
+        vFuseRight.insert(vFuseRight.end(),vvFuseBlocksRight[iBlock].begin(),vvFuseBlocksRight[iBlock].end());
+    }
+    matcher.ApplyFuse(mpCurrentKeyFrame,vFuse);
+    matcher.ApplyFuse(mpCurrentKeyFrame,vFuseRight);
 
 
     // Update points
@@ -888,6 +1044,8 @@ void LocalMapping::RequestStop()
     mbStopRequested = true;
     unique_lock<mutex> lock2(mMutexNewKFs);
     mbAbortBA = true;
+    mbWakeUp = true;
+    mcvNewKFs.notify_one();
 }
 
 bool LocalMapping::Stop()
@@ -896,6 +1054,7 @@ bool LocalMapping::Stop()
     if(mbStopRequested && !mbNotStop)
     {
         mbStopped = true;
+        mcvStop.notify_all();
         cout << "Local Mapping STOP" << endl;
         return true;
     }
@@ -915,6 +1074,12 @@ bool LocalMapping::stopRequested()
     return mbStopRequested;
 }
 
+void LocalMapping::WaitUntilStopped()
+{
+    unique_lock<mutex> lock(mMutexStop);
+    mcvStop.wait(lock, [&]{ return mbStopped; });
+}
+
 void LocalMapping::Release()
 {
     unique_lock<mutex> lock(mMutexStop);
@@ -926,6 +1091,7 @@ void LocalMapping::Release()
     for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
         delete *lit;
     mlNewKeyFrames.clear();
+    mcvStop.notify_all();
 
     cout << "Local Mapping RELEASE" << endl;
 }
@@ -950,6 +1116,11 @@ bool LocalMapping::SetNotStop(bool flag)
         return false;
 
     mbNotStop = flag;
+    lock.unlock();
+
+    // A pending stop request can be served now
+    if(!flag)
+        WakeUp();
 
     return true;
 }
@@ -959,6 +1130,11 @@ void LocalMapping::InterruptBA()
     mbAbortBA = true;
 }
 
+void LocalMapping::InformGlobalBASolution()
+{
+    WakeUp();
+}
+
 void LocalMapping::KeyFrameCulling()
 {
     """删除冗余关键帧，90%以上地图点能被其他3个以上的关键帧看到的关键帧为冗余关键帧
@@ -1144,16 +1320,12 @@ void LocalMapping::RequestReset()
         cout << "LM: Map reset recieved" << endl;
         mbResetRequested = true;
     }
+    WakeUp();
     cout << "LM: Map reset, waiting..." << endl;
 
-    while(1)
     {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequested)
-                break;
-        }
-        usleep(3000);
+        unique_lock<mutex> lock2(mMutexReset);
+        mcvReset.wait(lock2, [&]{ return !mbResetRequested; });
     }
     cout << "LM: Map reset, Done!!!" << endl;
 }
@@ -1166,16 +1338,12 @@ void LocalMapping::RequestResetActiveMap(Map* pMap)
         mbResetRequestedActiveMap = true;
         mpMapToReset = pMap;
     }
+    WakeUp();
     cout << "LM: Active map reset, waiting..." << endl;
 
-    while(1)
     {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequestedActiveMap)
-                break;
-        }
-        usleep(3000);
+        unique_lock<mutex> lock2(mMutexReset);
+        mcvReset.wait(lock2, [&]{ return !mbResetRequestedActiveMap; });
     }
     cout << "LM: Active map reset, Done!!!" << endl;
 }
@@ -1203,6 +1371,9 @@ void LocalMapping::ResetIfRequested()
 
             mIdxInit=0;
 
+            infoInertial.setZero(9,9);
+            mpInertialPriorMap = static_cast<Map*>(NULL);
+
             cout << "LM: End reseting Local Mapping..." << endl;
         }
 
@@ -1218,20 +1389,33 @@ void LocalMapping::ResetIfRequested()
             mbNotBA1 = true;
             mbBadImu=false;
 
+            infoInertial.setZero(9,9);
+            mpInertialPriorMap = static_cast<Map*>(NULL);
+
             mbResetRequested = false;
             mbResetRequestedActiveMap = false;
             cout << "LM: End reseting Local Mapping..." << endl;
         }
     }
     if(executed_reset)
+    {
+        mcvReset.notify_all();
         cout << "LM: Reset free the mutex" << endl;
+    }
 
 }
 
 void LocalMapping::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    WakeUp();
+
+    // Also leave the stopped state
+    unique_lock<mutex> lock(mMutexStop);
+    mcvStop.notify_all();
 }
 
 bool LocalMapping::CheckFinish()
@@ -1246,6 +1430,7 @@ void LocalMapping::SetFinish()
     mbFinished = true;    
     unique_lock<mutex> lock2(mMutexStop);
     mbStopped = true;
+    mcvStop.notify_all();
 }
 
 bool LocalMapping::isFinished()
@@ -1347,14 +1532,39 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
 
     mInitTime = mpTracker->mLastFrame.mTimeStamp-vpKF.front()->mTimeStamp;
 
+    // Full inertial BA of a fixed-lag stage: keyframes before the window stay fixed, the prior they left
+    // before this stage is used on the common biases
+    unsigned long nFirstFreeKFid = 0;
+    Eigen::MatrixXd infoInertialBefore;
+
     std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
-    Optimizer::InertialOptimization(mpAtlas->GetCurrentMap(), mRwg, mScale, mbg, mba, mbMonocular, infoInertial, false, false, priorG, priorA);
+    if(mbFixedLagInertialInit)
+    {
+        // The prior is only valid for the map it comes from, the first stage starts from scratch
+        vector<KeyFrame*> vpWindowKF = vpKF;
+        if(mpCurrentKeyFrame->GetMap()->isImuInitialized() && mpInertialPriorMap==mpCurrentKeyFrame->GetMap())
+            vpWindowKF = GetInertialWindow(vpKF);
+        if(vpWindowKF.size()==vpKF.size())
+            infoInertial.setZero(9,9);
+        else
+        {
+            nFirstFreeKFid = vpWindowKF.front()->mnId+1;
+            infoInertialBefore = infoInertial;
+        }
+
+        Optimizer::FixedLagInertialOptimization(mpAtlas->GetCurrentMap(), vpWindowKF, mRwg, mScale, mbg, mba, mbMonocular, infoInertial, priorG, priorA);
+        mpInertialPriorMap = mpCurrentKeyFrame->GetMap();
+        mnInertialPriorKFId = vpKF.back()->mnId;
+    }
+    else
+        Optimizer::InertialOptimization(mpAtlas->GetCurrentMap(), mRwg, mScale, mbg, mba, mbMonocular, infoInertial, false, false, priorG, priorA);
 
     std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
 
     if (mScale<1e-1)
     {
         cout << "scale too small" << endl;
+        mpInertialPriorMap = static_cast<Map*>(NULL);
         bInitializing=false;
         return;
     }
@@ -1388,13 +1598,19 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
     if (bFIBA)
     {
         if (priorA!=0.f)
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA, NULL, NULL, nFirstFreeKFid, &infoInertialBefore);
         else
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false, 1e2, 1e6, NULL, NULL, nFirstFreeKFid);
     }
 
     std::chrono::steady_clock::time_point t5 = std::chrono::steady_clock::now();
 
+    const double t_inertial_only = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t1 - t0).count();
+    const double t_full_inertial_BA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t5 - t4).count();
+    Verbose::PrintMess("IMU init stage " + to_string(mIdxInit) + ": inertial-only " + to_string(t_inertial_only) +
+                       " ms, full inertial BA " + to_string(t_full_inertial_BA) + " ms over " + to_string(N) + " KFs" +
+                       (nFirstFreeKFid ? " (fixed before KF " + to_string(nFirstFreeKFid) + ")" : ""), Verbose::VERBOSITY_NORMAL);
+
     Verbose::PrintMess("Global Bundle Adjustment finished\nUpdating map ...", Verbose::VERBOSITY_NORMAL);
 
     // Get Map Mutex
@@ -1542,7 +1758,16 @@ void LocalMapping::ScaleRefinement()
     mScale=1.0;
 
     std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
-    Optimizer::InertialOptimization(mpAtlas->GetCurrentMap(), mRwg, mScale);
+    vector<KeyFrame*> vpWindowKF;
+    if(mbFixedLagInertialInit && mpInertialPriorMap==mpCurrentKeyFrame->GetMap())
+        vpWindowKF = GetInertialWindow(vpKF);
+    if(vpWindowKF.size()>1 && vpWindowKF.size()<vpKF.size())
+    {
+        Optimizer::FixedLagInertialOptimization(vpWindowKF, mRwg, mScale, infoInertial);
+        mnInertialPriorKFId = vpKF.back()->mnId;
+    }
+    else
+        Optimizer::InertialOptimization(mpAtlas->GetCurrentMap(), mRwg, mScale);
     std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
 
     if (mScale<1e-1) // 1e-1
@@ -1581,6 +1806,16 @@ void LocalMapping::ScaleRefinement()
 
 
 
+vector<KeyFrame*> LocalMapping::GetInertialWindow(const vector<KeyFrame*> &vpKF)
+{
+    // vpKF is in temporal order, so are the ids
+    int first = vpKF.size()-1;
+    while(first>0 && vpKF[first]->mnId>mnInertialPriorKFId)
+        first--;
+
+    return vector<KeyFrame*>(vpKF.begin()+first,vpKF.end());
+}
+
 bool LocalMapping::IsInitializing()
 {
     return bInitializing;
@@ -27,6 +27,7 @@
 
 #include<mutex>
 #include<thread>
+#include<algorithm>
 
 
 namespace ORB_SLAM3
@@ -34,13 +35,19 @@ namespace ORB_SLAM3
 
 LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale, const bool bActiveLC):
     mbResetRequested(false), mbResetActiveMapRequested(false), mbFinishRequested(false), mbFinished(true), mpAtlas(pAtlas),
-    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
-    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), mnLoopNumCoincidences(0), mnMergeNumCoincidences(0),
-    mbLoopDetected(false), mbMergeDetected(false), mnLoopNumNotFound(0), mnMergeNumNotFound(0), mbActiveLC(bActiveLC)
+    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mbWakeUp(false), mpMatchedKF(NULL), mbLoopDetected(false), mnLoopNumCoincidences(0),
+    mnLoopNumNotFound(0), mbMergeDetected(false), mnMergeNumCoincidences(0), mnMergeNumNotFound(0), mLastLoopKFid(0),
+    mbRunningGBA(false), mbFinishedGBA(true), mbStopGBA(false), mpThreadGBA(NULL), mbGBASolutionReady(false), mpGBAMap(NULL),
+    mnGBALoopKF(0), mbGBAImuInit(false), mbGBAAborted(false), mnGBAIterations(0), mbFixScale(bFixScale), mbActiveLC(bActiveLC)
 {
     mnCovisibilityConsistencyTh = 3;
     mpLastCurrentKF = static_cast<KeyFrame*>(NULL);
 
+    mpReclaimer = EpochReclaimer::GetInstance();
+    mnReclaimerId = -1;
+    if(mpReclaimer)
+        mnReclaimerId = mpReclaimer->Register("Loop Closing",[this]{ WakeUp(); });
+
 #ifdef REGISTER_TIMES
 
     vdDataQuery_ms.clear();
@@ -68,6 +75,8 @@ LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pV
     vnGBAMPs.clear();
     nFGBA_exec = 0;
     nFGBA_abort = 0;
+    nFGBA_applied = 0;
+    nFGBA_appliedAborted = 0;
 
 #endif
 
@@ -302,9 +311,16 @@ void LoopClosing::Run()
             break;
         }
 
-        usleep(5000);
+        EnterQuiescentState();
+
+        WaitForWork();
     }
 
+    StopGlobalBundleAdjustment();
+
+    if(mpReclaimer)
+        mpReclaimer->Unregister(mnReclaimerId);
+
     SetFinish();
 }
 
@@ -312,7 +328,52 @@ void LoopClosing::InsertKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexLoopQueue);
     if(pKF->mnId!=0)
+    {
         mlpLoopKeyFrameQueue.push_back(pKF);
+        mcvLoopQueue.notify_one();
+    }
+}
+
+void LoopClosing::WaitForWork()
+{
+    unique_lock<mutex> lock(mMutexLoopQueue);
+    mcvLoopQueue.wait(lock, [&]{ return mbWakeUp || !mlpLoopKeyFrameQueue.empty(); });
+    mbWakeUp = false;
+}
+
+void LoopClosing::EnterQuiescentState()
+{
+    if(!mpReclaimer)
+        return;
+
+    vector<MapPoint*>* vpPoints[] = {&mvpLoopMapPoints, &mvpLoopMPs, &mvpMergeMPs};
+    for(int k=0; k<3; k++)
+    {
+        vector<MapPoint*> &vpMPs = *vpPoints[k];
+        vector<MapPoint*>::iterator vend = remove_if(vpMPs.begin(), vpMPs.end(), [](MapPoint* pMP){ return !pMP || pMP->isBad(); });
+        vpMPs.erase(vend, vpMPs.end());
+    }
+
+    // Matches are indexed by keypoint, only clear them
+    vector<MapPoint*>* vpMatches[] = {&mvpCurrentMatchedPoints, &mvpLoopMatchedMPs, &mvpMergeMatchedMPs};
+    for(int k=0; k<3; k++)
+    {
+        vector<MapPoint*> &vpMPs = *vpMatches[k];
+        for(size_t i=0; i<vpMPs.size(); i++)
+        {
+            if(vpMPs[i] && vpMPs[i]->isBad())
+                vpMPs[i] = static_cast<MapPoint*>(NULL);
+        }
+    }
+
+    mpReclaimer->Quiesce(mnReclaimerId);
+}
+
+void LoopClosing::WakeUp()
+{
+    unique_lock<mutex> lock(mMutexLoopQueue);
+    mbWakeUp = true;
+    mcvLoopQueue.notify_one();
 }
 
 bool LoopClosing::CheckNewKeyFrames()
@@ -983,6 +1044,9 @@ void LoopClosing::CorrectLoop()
 {
     //cout << "Loop detected!" << endl;
 
+    // The loop has been measured against this pose of the matched keyframe
+    const Sophus::SE3d Tmw = mpLoopMatchedKF->GetPose().cast<double>();
+
     // Send a stop signal to Local Mapping
     // Avoid new keyframes are inserted while correcting the loop
     mpLocalMapper->RequestStop();
@@ -992,24 +1056,17 @@ void LoopClosing::CorrectLoop()
     if(isRunningGBA())
     {
         cout << "Stoping Global Bundle Adjustment...";
-        unique_lock<mutex> lock(mMutexGBA);
-        mbStopGBA = true;
-
-        mnFullBAIdx++;
-
-        if(mpThreadGBA)
-        {
-            mpThreadGBA->detach();
-            delete mpThreadGBA;
-        }
+        StopGlobalBundleAdjustment();
         cout << "  Done!!" << endl;
     }
 
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
+
+    // Keep the work done by the global BA, the next one starts from it. The loop moves with the matched keyframe.
+    ApplyGlobalBundleAdjustment();
+    const Sophus::SE3d Tww = Tmw.inverse()*mpLoopMatchedKF->GetPose().cast<double>();
+    mg2oLoopScw = mg2oLoopScw*g2o::Sim3(Tww.unit_quaternion(),Tww.translation(),1.0);
 
     // Ensure current keyframe is updated
     //cout << "Start updating connections" << endl;
@@ -1211,12 +1268,9 @@ void LoopClosing::CorrectLoop()
     // Launch a new thread to perform Global Bundle Adjustment (Only if few keyframes, if not it would take too much time)
     if(!pLoopMap->isImuInitialized() || (pLoopMap->KeyFramesInMap()<200 && mpAtlas->CountMaps()==1))
     {
-        mbRunningGBA = true;
-        mbFinishedGBA = false;
-        mbStopGBA = false;
         mnCorrectionGBA = mnNumCorrection;
 
-        mpThreadGBA = new thread(&LoopClosing::RunGlobalBundleAdjustment, this, pLoopMap, mpCurrentKF->mnId);
+        LaunchGlobalBundleAdjustment(pLoopMap, mpCurrentKF->mnId);
     }
 
     // Loop closed. Release Local Mapping.
@@ -1243,16 +1297,7 @@ void LoopClosing::MergeLocal()
     // If a Global Bundle Adjustment is running, abort it
     if(isRunningGBA())
     {
-        unique_lock<mutex> lock(mMutexGBA);
-        mbStopGBA = true;
-
-        mnFullBAIdx++;
-
-        if(mpThreadGBA)
-        {
-            mpThreadGBA->detach();
-            delete mpThreadGBA;
-        }
+        StopGlobalBundleAdjustment();
         bRelaunchBA = true;
     }
 
@@ -1260,12 +1305,12 @@ void LoopClosing::MergeLocal()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     //cout << "Local Map stopped" << endl;
 
+    // Keep the work done by the global BA. The merge is measured against the merge map, which it does not move.
+    ApplyGlobalBundleAdjustment();
+
     mpLocalMapper->EmptyQueue();
 
     // Merge map will become in the new active map with the local window of KFs and MPs from the current map.
@@ -1719,10 +1764,7 @@ void LoopClosing::MergeLocal()
 
         mpLocalMapper->RequestStop();
         // Wait until Local Mapping has effectively stopped
-        while(!mpLocalMapper->isStopped())
-        {
-            usleep(1000);
-        }
+        mpLocalMapper->WaitUntilStopped();
 
         // Optimize graph (and update the loop position for each element form the begining to the end)
         if(mpTracker->mSensor != System::MONOCULAR)
@@ -1776,10 +1818,7 @@ void LoopClosing::MergeLocal()
     if(bRelaunchBA && (!pCurrentMap->isImuInitialized() || (pCurrentMap->KeyFramesInMap()<200 && mpAtlas->CountMaps()==1)))
     {
         // Launch a new thread to perform Global Bundle Adjustment
-        mbRunningGBA = true;
-        mbFinishedGBA = false;
-        mbStopGBA = false;
-        mpThreadGBA = new thread(&LoopClosing::RunGlobalBundleAdjustment,this, pMergeMap, mpCurrentKF->mnId);
+        LaunchGlobalBundleAdjustment(pMergeMap, mpCurrentKF->mnId);
     }
 
     mpMergeMatchedKF->AddMergeEdge(mpCurrentKF);
@@ -1812,20 +1851,14 @@ void LoopClosing::MergeLocal2()
     // Flag that is true only when we stopped a running BA, in this case we need relaunch at the end of the merge
     bool bRelaunchBA = false;
 
+    // mSold_new has been measured with this pose of the current keyframe
+    const Sophus::SE3d Tcw = mpCurrentKF->GetPose().cast<double>();
+
     //cout << "Check Full Bundle Adjustment" << endl;
     // If a Global Bundle Adjustment is running, abort it
     if(isRunningGBA())
     {
-        unique_lock<mutex> lock(mMutexGBA);
-        mbStopGBA = true;
-
-        mnFullBAIdx++;
-
-        if(mpThreadGBA)
-        {
-            mpThreadGBA->detach();
-            delete mpThreadGBA;
-        }
+        StopGlobalBundleAdjustment();
         bRelaunchBA = true;
     }
 
@@ -1833,12 +1866,14 @@ void LoopClosing::MergeLocal2()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     //cout << "Local Map stopped" << endl;
 
+    // Keep the work done by the global BA, the current map moves with it
+    ApplyGlobalBundleAdjustment();
+    const Sophus::SE3d Tww = Tcw.inverse()*mpCurrentKF->GetPose().cast<double>();
+    mSold_new = mSold_new*g2o::Sim3(Tww.unit_quaternion(),Tww.translation(),1.0);
+
     Map* pCurrentMap = mpCurrentKF->GetMap();
     Map* pMergeMap = mpMergeMatchedKF->GetMap();
 
@@ -2216,16 +2251,10 @@ void LoopClosing::RequestReset()
         unique_lock<mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    WakeUp();
 
-    while(1)
-    {
-        {
-        unique_lock<mutex> lock2(mMutexReset);
-        if(!mbResetRequested)
-            break;
-        }
-        usleep(5000);
-    }
+    unique_lock<mutex> lock2(mMutexReset);
+    mcvReset.wait(lock2, [&]{ return !mbResetRequested; });
 }
 
 void LoopClosing::RequestResetActiveMap(Map *pMap)
@@ -2235,16 +2264,10 @@ void LoopClosing::RequestResetActiveMap(Map *pMap)
         mbResetActiveMapRequested = true;
         mpMapToReset = pMap;
     }
+    WakeUp();
 
-    while(1)
-    {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetActiveMapRequested)
-                break;
-        }
-        usleep(3000);
-    }
+    unique_lock<mutex> lock2(mMutexReset);
+    mcvReset.wait(lock2, [&]{ return !mbResetActiveMapRequested; });
 }
 
 void LoopClosing::ResetIfRequested()
@@ -2254,12 +2277,32 @@ void LoopClosing::ResetIfRequested()
     {
         cout << "Loop closer reset requested..." << endl;
         mlpLoopKeyFrameQueue.clear();
+
+        // The global BA and its solution belong to a map that is going to be erased
+        StopGlobalBundleAdjustment();
+        {
+            unique_lock<mutex> lock2(mMutexGBA);
+            mbGBASolutionReady = false;
+        }
+
         mLastLoopKFid=0;  //TODO old variable, it is not use in the new algorithm
         mbResetRequested=false;
         mbResetActiveMapRequested = false;
+        mcvReset.notify_all();
     }
     else if(mbResetActiveMapRequested)
     {
+        bool bGBAOnMap;
+        {
+            unique_lock<mutex> lock2(mMutexGBA);
+            bGBAOnMap = mpGBAMap==mpMapToReset;
+        }
+        if(bGBAOnMap)
+        {
+            StopGlobalBundleAdjustment();
+            unique_lock<mutex> lock2(mMutexGBA);
+            mbGBASolutionReady = false;
+        }
 
         for (list<KeyFrame*>::const_iterator it=mlpLoopKeyFrameQueue.begin(); it != mlpLoopKeyFrameQueue.end();)
         {
@@ -2274,6 +2317,7 @@ void LoopClosing::ResetIfRequested()
 
         mLastLoopKFid=mpAtlas->GetLastInitKFid(); //TODO old variable, it is not use in the new algorithm
         mbResetActiveMapRequested=false;
+        mcvReset.notify_all();
 
     }
 }
@@ -2282,6 +2326,9 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 {  
     Verbose::PrintMess("Starting Global Bundle Adjustment", Verbose::VERBOSITY_NORMAL);
 
+    // The optimization keeps pointers to all the points of the map until it returns
+    ReclaimerScope reclaimerScope("Global BA");
+
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartFGBA = std::chrono::steady_clock::now();
 
@@ -2293,10 +2340,11 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
     const bool bImuInit = pActiveMap->isImuInitialized();
 
+    int nIterations;
     if(!bImuInit)
-        Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false);
+        nIterations = Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false);
     else
-        Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA);
+        nIterations = Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA);
 
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndGBA = std::chrono::steady_clock::now();
@@ -2310,224 +2358,299 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
     }
 #endif
 
-    int idx =  mnFullBAIdx;
-    // Optimizer::GlobalBundleAdjustemnt(mpMap,10,&mbStopGBA,nLoopKF,false);
+    // Publish the solution, also when the BA has been aborted: its iterations only lowered the error, and once
+    // applied the next BA starts from them instead of from scratch. Local Mapping applies a finished solution
+    // between keyframes, Loop Closing applies an aborted one before the correction that aborted it.
+    const bool bAborted = mbStopGBA;
+    {
+        unique_lock<mutex> lock(mMutexGBA);
+        if(nIterations>0)
+        {
+            mbGBASolutionReady = true;
+            mbGBAImuInit = bImuInit;
+            mbGBAAborted = bAborted;
+            mnGBAIterations = nIterations;
+#ifdef REGISTER_TIMES
+            mTimeStartGBA = time_StartFGBA;
+#endif
+        }
 
-    // Update all MapPoints and KeyFrames
-    // Local Mapping was active during BA, that means that there might be new keyframes
-    // not included in the Global BA and they are not consistent with the updated map.
-    // We need to propagate the correction through the spanning tree
+        mbFinishedGBA = true;
+        mbRunningGBA = false;
+    }
+
+    if(bAborted)
+    {
+        Verbose::PrintMess("Global Bundle Adjustment aborted after " + to_string(nIterations) + " iterations", Verbose::VERBOSITY_NORMAL);
+    }
+    else if(nIterations>0)
+    {
+        Verbose::PrintMess("Global Bundle Adjustment finished", Verbose::VERBOSITY_NORMAL);
+        mpLocalMapper->InformGlobalBASolution();
+    }
+}
+
+void LoopClosing::LaunchGlobalBundleAdjustment(Map* pMap, unsigned long nLoopKF)
+{
+    // The previous BA has returned, only its thread is left
+    if(mpThreadGBA)
+    {
+        mpThreadGBA->join();
+        delete mpThreadGBA;
+        mpThreadGBA = NULL;
+    }
+
+    unique_lock<mutex> lock(mMutexGBA);
+    mbRunningGBA = true;
+    mbFinishedGBA = false;
+    mbStopGBA = false;
+    mbGBASolutionReady = false;
+    mpGBAMap = pMap;
+    mnGBALoopKF = nLoopKF;
+    mpThreadGBA = new thread(&LoopClosing::RunGlobalBundleAdjustment, this, pMap, nLoopKF);
+}
+
+void LoopClosing::StopGlobalBundleAdjustment()
+{
+    if(!mpThreadGBA)
+        return;
+
+    // g2o checks the flag between iterations and between the trials of an iteration
+    mbStopGBA = true;
+    mpThreadGBA->join();
+    delete mpThreadGBA;
+    mpThreadGBA = NULL;
+}
+
+void LoopClosing::ApplyGlobalBundleAdjustment()
+{
+    Map* pActiveMap;
+    unsigned long nLoopKF;
+    bool bAborted;
+    int nIterations;
     {
         unique_lock<mutex> lock(mMutexGBA);
-        if(idx!=mnFullBAIdx)
+        if(!mbGBASolutionReady)
             return;
+        mbGBASolutionReady = false;
 
-        if(!bImuInit && pActiveMap->isImuInitialized())
-            return;
+        pActiveMap = mpGBAMap;
+        nLoopKF = mnGBALoopKF;
+        bAborted = mbGBAAborted;
+        nIterations = mnGBAIterations;
 
-        if(!mbStopGBA)
+        // The IMU has been initialized since the BA started, the solution has no inertial values
+        if(!mbGBAImuInit && pActiveMap->isImuInitialized())
         {
-            Verbose::PrintMess("Global Bundle Adjustment finished", Verbose::VERBOSITY_NORMAL);
-            Verbose::PrintMess("Updating map ...", Verbose::VERBOSITY_NORMAL);
+            Verbose::PrintMess("Global BA solution dropped, the IMU was initialized meanwhile", Verbose::VERBOSITY_NORMAL);
+            return;
+        }
+    }
 
-            mpLocalMapper->RequestStop();
-            // Wait until Local Mapping has effectively stopped
+#ifdef REGISTER_TIMES
+    std::chrono::steady_clock::time_point time_StartUpdateMap = std::chrono::steady_clock::now();
+#endif
 
-            while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-                usleep(1000);
-            }
+    Verbose::PrintMess(string("Updating map with the ") + (bAborted ? "aborted" : "finished") + " Global BA (" +
+                       to_string(nIterations) + " iterations, loop KF " + to_string(nLoopKF) + ") ...", Verbose::VERBOSITY_NORMAL);
 
-            // Get Map Mutex
-            unique_lock<mutex> lock(pActiveMap->mMutexMapUpdate);
-            // cout << "LC: Update Map Mutex adquired" << endl;
+    // Update all MapPoints and KeyFrames
+    // Local Mapping was active during BA, that means that there might be new keyframes
+    // not included in the Global BA and they are not consistent with the updated map.
+    // We need to propagate the correction through the spanning tree
+    {
+        // Get Map Mutex
+        unique_lock<mutex> lock(pActiveMap->mMutexMapUpdate);
+        // cout << "LC: Update Map Mutex adquired" << endl;
 
-            //pActiveMap->PrintEssentialGraph();
-            // Correct keyframes starting at map first keyframe
-            list<KeyFrame*> lpKFtoCheck(pActiveMap->mvpKeyFrameOrigins.begin(),pActiveMap->mvpKeyFrameOrigins.end());
+        //pActiveMap->PrintEssentialGraph();
+        // Correct keyframes starting at map first keyframe
+        list<KeyFrame*> lpKFtoCheck(pActiveMap->mvpKeyFrameOrigins.begin(),pActiveMap->mvpKeyFrameOrigins.end());
 
-            while(!lpKFtoCheck.empty())
+        while(!lpKFtoCheck.empty())
+        {
+            KeyFrame* pKF = lpKFtoCheck.front();
+            const set<KeyFrame*> sChilds = pKF->GetChilds();
+            //cout << "---Updating KF " << pKF->mnId << " with " << sChilds.size() << " childs" << endl;
+            //cout << " KF mnBAGlobalForKF: " << pKF->mnBAGlobalForKF << endl;
+            Sophus::SE3f Twc = pKF->GetPoseInverse();
+            //cout << "Twc: " << Twc << endl;
+            //cout << "GBA: Correct KeyFrames" << endl;
+            for(set<KeyFrame*>::const_iterator sit=sChilds.begin();sit!=sChilds.end();sit++)
             {
-                KeyFrame* pKF = lpKFtoCheck.front();
-                const set<KeyFrame*> sChilds = pKF->GetChilds();
-                //cout << "---Updating KF " << pKF->mnId << " with " << sChilds.size() << " childs" << endl;
-                //cout << " KF mnBAGlobalForKF: " << pKF->mnBAGlobalForKF << endl;
-                Sophus::SE3f Twc = pKF->GetPoseInverse();
-                //cout << "Twc: " << Twc << endl;
-                //cout << "GBA: Correct KeyFrames" << endl;
-                for(set<KeyFrame*>::const_iterator sit=sChilds.begin();sit!=sChilds.end();sit++)
-                {
-                    KeyFrame* pChild = *sit;
-                    if(!pChild || pChild->isBad())
-                        continue;
+                KeyFrame* pChild = *sit;
+                if(!pChild || pChild->isBad())
+                    continue;
 
-                    if(pChild->mnBAGlobalForKF!=nLoopKF)
-                    {
-                        //cout << "++++New child with flag " << pChild->mnBAGlobalForKF << "; LoopKF: " << nLoopKF << endl;
-                        //cout << " child id: " << pChild->mnId << endl;
-                        Sophus::SE3f Tchildc = pChild->GetPose() * Twc;
-                        //cout << "Child pose: " << Tchildc << endl;
-                        //cout << "pKF->mTcwGBA: " << pKF->mTcwGBA << endl;
-                        pChild->mTcwGBA = Tchildc * pKF->mTcwGBA;//*Tcorc*pKF->mTcwGBA;
-
-                        Sophus::SO3f Rcor = pChild->mTcwGBA.so3().inverse() * pChild->GetPose().so3();
-                        if(pChild->isVelocitySet()){
-                            pChild->mVwbGBA = Rcor * pChild->GetVelocity();
-                        }
-                        else
-                            Verbose::PrintMess("Child velocity empty!! ", Verbose::VERBOSITY_NORMAL);
+                if(pChild->mnBAGlobalForKF!=nLoopKF)
+                {
+                    //cout << "++++New child with flag " << pChild->mnBAGlobalForKF << "; LoopKF: " << nLoopKF << endl;
+                    //cout << " child id: " << pChild->mnId << endl;
+                    Sophus::SE3f Tchildc = pChild->GetPose() * Twc;
+                    //cout << "Child pose: " << Tchildc << endl;
+                    //cout << "pKF->mTcwGBA: " << pKF->mTcwGBA << endl;
+                    pChild->mTcwGBA = Tchildc * pKF->mTcwGBA;//*Tcorc*pKF->mTcwGBA;
+
+                    Sophus::SO3f Rcor = pChild->mTcwGBA.so3().inverse() * pChild->GetPose().so3();
+                    if(pChild->isVelocitySet()){
+                        pChild->mVwbGBA = Rcor * pChild->GetVelocity();
+                    }
+                    else
+                        Verbose::PrintMess("Child velocity empty!! ", Verbose::VERBOSITY_NORMAL);
 
 
-                        //cout << "Child bias: " << pChild->GetImuBias() << endl;
-                        pChild->mBiasGBA = pChild->GetImuBias();
+                    //cout << "Child bias: " << pChild->GetImuBias() << endl;
+                    pChild->mBiasGBA = pChild->GetImuBias();
 
 
-                        pChild->mnBAGlobalForKF = nLoopKF;
+                    pChild->mnBAGlobalForKF = nLoopKF;
 
-                    }
-                    lpKFtoCheck.push_back(pChild);
                 }
+                lpKFtoCheck.push_back(pChild);
+            }
 
-                //cout << "-------Update pose" << endl;
-                pKF->mTcwBefGBA = pKF->GetPose();
-                //cout << "pKF->mTcwBefGBA: " << pKF->mTcwBefGBA << endl;
-                pKF->SetPose(pKF->mTcwGBA);
-                /*cv::Mat Tco_cn = pKF->mTcwBefGBA * pKF->mTcwGBA.inv();
-                cv::Vec3d trasl = Tco_cn.rowRange(0,3).col(3);
-                double dist = cv::norm(trasl);
-                cout << "GBA: KF " << pKF->mnId << " had been moved " << dist << " meters" << endl;
-                double desvX = 0;
-                double desvY = 0;
-                double desvZ = 0;
-                if(pKF->mbHasHessian)
-                {
-                    cv::Mat hessianInv = pKF->mHessianPose.inv();
-
-                    double covX = hessianInv.at<double>(3,3);
-                    desvX = std::sqrt(covX);
-                    double covY = hessianInv.at<double>(4,4);
-                    desvY = std::sqrt(covY);
-                    double covZ = hessianInv.at<double>(5,5);
-                    desvZ = std::sqrt(covZ);
-                    pKF->mbHasHessian = false;
-                }
-                if(dist > 1)
-                {
-                    cout << "--To much distance correction: It has " << pKF->GetConnectedKeyFrames().size() << " connected KFs" << endl;
-                    cout << "--It has " << pKF->GetCovisiblesByWeight(80).size() << " connected KF with 80 common matches or more" << endl;
-                    cout << "--It has " << pKF->GetCovisiblesByWeight(50).size() << " connected KF with 50 common matches or more" << endl;
-                    cout << "--It has " << pKF->GetCovisiblesByWeight(20).size() << " connected KF with 20 common matches or more" << endl;
+            //cout << "-------Update pose" << endl;
+            pKF->mTcwBefGBA = pKF->GetPose();
+            //cout << "pKF->mTcwBefGBA: " << pKF->mTcwBefGBA << endl;
+            pKF->SetPose(pKF->mTcwGBA);
+            /*cv::Mat Tco_cn = pKF->mTcwBefGBA * pKF->mTcwGBA.inv();
+            cv::Vec3d trasl = Tco_cn.rowRange(0,3).col(3);
+            double dist = cv::norm(trasl);
+            cout << "GBA: KF " << pKF->mnId << " had been moved " << dist << " meters" << endl;
+            double desvX = 0;
+            double desvY = 0;
+            double desvZ = 0;
+            if(pKF->mbHasHessian)
+            {
+                cv::Mat hessianInv = pKF->mHessianPose.inv();
+
+                double covX = hessianInv.at<double>(3,3);
+                desvX = std::sqrt(covX);
+                double covY = hessianInv.at<double>(4,4);
+                desvY = std::sqrt(covY);
+                double covZ = hessianInv.at<double>(5,5);
+                desvZ = std::sqrt(covZ);
+                pKF->mbHasHessian = false;
+            }
+            if(dist > 1)
+            {
+                cout << "--To much distance correction: It has " << pKF->GetConnectedKeyFrames().size() << " connected KFs" << endl;
+                cout << "--It has " << pKF->GetCovisiblesByWeight(80).size() << " connected KF with 80 common matches or more" << endl;
+                cout << "--It has " << pKF->GetCovisiblesByWeight(50).size() << " connected KF with 50 common matches or more" << endl;
+                cout << "--It has " << pKF->GetCovisiblesByWeight(20).size() << " connected KF with 20 common matches or more" << endl;
 
-                    cout << "--STD in meters(x, y, z): " << desvX << ", " << desvY << ", " << desvZ << endl;
+                cout << "--STD in meters(x, y, z): " << desvX << ", " << desvY << ", " << desvZ << endl;
 
 
-                    string strNameFile = pKF->mNameFile;
-                    cv::Mat imLeft = cv::imread(strNameFile, CV_LOAD_IMAGE_UNCHANGED);
+                string strNameFile = pKF->mNameFile;
+                cv::Mat imLeft = cv::imread(strNameFile, CV_LOAD_IMAGE_UNCHANGED);
 
-                    cv::cvtColor(imLeft, imLeft, CV_GRAY2BGR);
+                cv::cvtColor(imLeft, imLeft, CV_GRAY2BGR);
 
-                    vector<MapPoint*> vpMapPointsKF = pKF->GetMapPointMatches();
-                    int num_MPs = 0;
-                    for(int i=0; i<vpMapPointsKF.size(); ++i)
+                vector<MapPoint*> vpMapPointsKF = pKF->GetMapPointMatches();
+                int num_MPs = 0;
+                for(int i=0; i<vpMapPointsKF.size(); ++i)
+                {
+                    if(!vpMapPointsKF[i] || vpMapPointsKF[i]->isBad())
                     {
-                        if(!vpMapPointsKF[i] || vpMapPointsKF[i]->isBad())
-                        {
-                            continue;
-                        }
-                        num_MPs += 1;
-                        string strNumOBs = to_string(vpMapPointsKF[i]->Observations());
-                        cv::circle(imLeft, pKF->mvKeys[i].pt, 2, cv::Scalar(0, 255, 0));
-                        cv::putText(imLeft, strNumOBs, pKF->mvKeys[i].pt, CV_FONT_HERSHEY_DUPLEX, 1, cv::Scalar(255, 0, 0));
+                        continue;
                     }
-                    cout << "--It has " << num_MPs << " MPs matched in the map" << endl;
-
-                    string namefile = "./test_GBA/GBA_" + to_string(nLoopKF) + "_KF" + to_string(pKF->mnId) +"_D" + to_string(dist) +".png";
-                    cv::imwrite(namefile, imLeft);
-                }*/
+                    num_MPs += 1;
+                    string strNumOBs = to_string(vpMapPointsKF[i]->Observations());
+                    cv::circle(imLeft, pKF->mvKeys[i].pt, 2, cv::Scalar(0, 255, 0));
+                    cv::putText(imLeft, strNumOBs, pKF->mvKeys[i].pt, CV_FONT_HERSHEY_DUPLEX, 1, cv::Scalar(255, 0, 0));
+                }
+                cout << "--It has " << num_MPs << " MPs matched in the map" << endl;
 
+                string namefile = "./test_GBA/GBA_" + to_string(nLoopKF) + "_KF" + to_string(pKF->mnId) +"_D" + to_string(dist) +".png";
+                cv::imwrite(namefile, imLeft);
+            }*/
 
-                if(pKF->bImu)
-                {
-                    //cout << "-------Update inertial values" << endl;
-                    pKF->mVwbBefGBA = pKF->GetVelocity();
-                    //if (pKF->mVwbGBA.empty())
-                    //    Verbose::PrintMess("pKF->mVwbGBA is empty", Verbose::VERBOSITY_NORMAL);
-
-                    //assert(!pKF->mVwbGBA.empty());
-                    pKF->SetVelocity(pKF->mVwbGBA);
-                    pKF->SetNewBias(pKF->mBiasGBA);                    
-                }
 
-                lpKFtoCheck.pop_front();
+            if(pKF->bImu)
+            {
+                //cout << "-------Update inertial values" << endl;
+                pKF->mVwbBefGBA = pKF->GetVelocity();
+                //if (pKF->mVwbGBA.empty())
+                //    Verbose::PrintMess("pKF->mVwbGBA is empty", Verbose::VERBOSITY_NORMAL);
+
+                //assert(!pKF->mVwbGBA.empty());
+                pKF->SetVelocity(pKF->mVwbGBA);
+                pKF->SetNewBias(pKF->mBiasGBA);                    
             }
 
-            //cout << "GBA: Correct MapPoints" << endl;
-            // Correct MapPoints
-            const vector<MapPoint*> vpMPs = pActiveMap->GetAllMapPoints();
+            lpKFtoCheck.pop_front();
+        }
 
-            for(size_t i=0; i<vpMPs.size(); i++)
-            {
-                MapPoint* pMP = vpMPs[i];
+        //cout << "GBA: Correct MapPoints" << endl;
+        // Correct MapPoints
+        const vector<MapPoint*> vpMPs = pActiveMap->GetAllMapPoints();
 
-                if(pMP->isBad())
-                    continue;
+        for(size_t i=0; i<vpMPs.size(); i++)
+        {
+            MapPoint* pMP = vpMPs[i];
 
-                if(pMP->mnBAGlobalForKF==nLoopKF)
-                {
-                    // If optimized by Global BA, just update
-                    pMP->SetWorldPos(pMP->mPosGBA);
-                }
-                else
-                {
-                    // Update according to the correction of its reference keyframe
-                    KeyFrame* pRefKF = pMP->GetReferenceKeyFrame();
+            if(pMP->isBad())
+                continue;
 
-                    if(pRefKF->mnBAGlobalForKF!=nLoopKF)
-                        continue;
+            if(pMP->mnBAGlobalForKF==nLoopKF)
+            {
+                // If optimized by Global BA, just update
+                pMP->SetWorldPos(pMP->mPosGBA);
+            }
+            else
+            {
+                // Update according to the correction of its reference keyframe
+                KeyFrame* pRefKF = pMP->GetReferenceKeyFrame();
 
-                    /*if(pRefKF->mTcwBefGBA.empty())
-                        continue;*/
+                if(pRefKF->mnBAGlobalForKF!=nLoopKF)
+                    continue;
 
-                    // Map to non-corrected camera
-                    // cv::Mat Rcw = pRefKF->mTcwBefGBA.rowRange(0,3).colRange(0,3);
-                    // cv::Mat tcw = pRefKF->mTcwBefGBA.rowRange(0,3).col(3);
-                    Eigen::Vector3f Xc = pRefKF->mTcwBefGBA * pMP->GetWorldPos();
+                /*if(pRefKF->mTcwBefGBA.empty())
+                    continue;*/
 
-                    // Backproject using corrected camera
-                    pMP->SetWorldPos(pRefKF->GetPoseInverse() * Xc);
-                }
-            }
+                // Map to non-corrected camera
+                // cv::Mat Rcw = pRefKF->mTcwBefGBA.rowRange(0,3).colRange(0,3);
+                // cv::Mat tcw = pRefKF->mTcwBefGBA.rowRange(0,3).col(3);
+                Eigen::Vector3f Xc = pRefKF->mTcwBefGBA * pMP->GetWorldPos();
 
-            pActiveMap->InformNewBigChange();
-            pActiveMap->IncreaseChangeIndex();
+                // Backproject using corrected camera
+                pMP->SetWorldPos(pRefKF->GetPoseInverse() * Xc);
+            }
+        }
 
-            // TODO Check this update
-            // mpTracker->UpdateFrameIMU(1.0f, mpTracker->GetLastKeyFrame()->GetImuBias(), mpTracker->GetLastKeyFrame());
+        pActiveMap->InformNewBigChange();
+        pActiveMap->IncreaseChangeIndex();
 
-            mpLocalMapper->Release();
+        // TODO Check this update
+        // mpTracker->UpdateFrameIMU(1.0f, mpTracker->GetLastKeyFrame()->GetImuBias(), mpTracker->GetLastKeyFrame());
+    }
 
 #ifdef REGISTER_TIMES
-            std::chrono::steady_clock::time_point time_EndUpdateMap = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point time_EndUpdateMap = std::chrono::steady_clock::now();
 
-            double timeUpdateMap = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - time_EndGBA).count();
-            vdUpdateMap_ms.push_back(timeUpdateMap);
+    double timeUpdateMap = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - time_StartUpdateMap).count();
+    vdUpdateMap_ms.push_back(timeUpdateMap);
 
-            double timeFGBA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - time_StartFGBA).count();
-            vdFGBATotal_ms.push_back(timeFGBA);
-#endif
-            Verbose::PrintMess("Map updated!", Verbose::VERBOSITY_NORMAL);
-        }
+    double timeFGBA = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndUpdateMap - mTimeStartGBA).count();
+    vdFGBATotal_ms.push_back(timeFGBA);
 
-        mbFinishedGBA = true;
-        mbRunningGBA = false;
-    }
+    if(bAborted)
+        nFGBA_appliedAborted += 1;
+    else
+        nFGBA_applied += 1;
+#endif
+    Verbose::PrintMess("Map updated!", Verbose::VERBOSITY_NORMAL);
 }
 
 void LoopClosing::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    // cout << "LC: Finish requested" << endl;
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        // cout << "LC: Finish requested" << endl;
+        mbFinishRequested = true;
+    }
+    WakeUp();
 }
 
 bool LoopClosing::CheckFinish()
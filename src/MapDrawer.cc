@@ -150,10 +150,20 @@ void MapDrawer::DrawMapPoints()
     glBegin(GL_POINTS);
     glColor3f(0.0,0.0,0.0);
 
+    // Reference points are only compared, never dereferenced: the list is refreshed by the tracking
+    // and may keep points that were deleted since then (System.ReclaimMemory)
+    vector<MapPoint*> vpLocalMPs;
+    vpLocalMPs.reserve(spRefMPs.size());
+
     for(size_t i=0, iend=vpMPs.size(); i<iend;i++)
     {
-        if(vpMPs[i]->isBad() || spRefMPs.count(vpMPs[i]))
+        if(vpMPs[i]->isBad())
+            continue;
+        if(spRefMPs.count(vpMPs[i]))
+        {
+            vpLocalMPs.push_back(vpMPs[i]);
             continue;
+        }
         Eigen::Matrix<float,3,1> pos = vpMPs[i]->GetWorldPos();
         glVertex3f(pos(0),pos(1),pos(2));
     }
@@ -163,11 +173,9 @@ void MapDrawer::DrawMapPoints()
     glBegin(GL_POINTS);
     glColor3f(1.0,0.0,0.0);
 
-    for(set<MapPoint*>::iterator sit=spRefMPs.begin(), send=spRefMPs.end(); sit!=send; sit++)
+    for(size_t i=0, iend=vpLocalMPs.size(); i<iend; i++)
     {
-        if((*sit)->isBad())
-            continue;
-        Eigen::Matrix<float,3,1> pos = (*sit)->GetWorldPos();
+        Eigen::Matrix<float,3,1> pos = vpLocalMPs[i]->GetWorldPos();
         glVertex3f(pos(0),pos(1),pos(2));
 
     }
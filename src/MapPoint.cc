@@ -18,19 +18,37 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "EpochReclaimer.h"
 
 #include<mutex>
+#include<cstring>
+#include<algorithm>
 
 namespace ORB_SLAM3
 {
 
 long unsigned int MapPoint::nNextId=0;
 mutex MapPoint::mGlobalMutex;
+ObjectPool MapPoint::mPool("MapPoint",sizeof(MapPoint),1024);
+MutexStripes<1024> MapPoint::mPosMutexes;
+MutexStripes<1024> MapPoint::mFeaturesMutexes;
+MutexStripes<256> MapPoint::mMapMutexes;
+MutexStripes<256> MapPoint::mDescriptorsMutexes;
+const size_t MapPoint::MAX_CACHED_DESCRIPTORS = 512;
+
+namespace
+{
+    // Order of the observations in ComputeDistinctiveDescriptors: by keyframe, then by keypoint index
+    bool LessDescriptorKey(const pair<KeyFrame*,int> &a, const pair<KeyFrame*,int> &b)
+    {
+        return less<KeyFrame*>()(a.first,b.first) || (a.first==b.first && a.second<b.second);
+    }
+}
 
 MapPoint::MapPoint():
     mnFirstKFid(0), mnFirstFrame(0), nObs(0), mnTrackReferenceForFrame(0),
     mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
-    mnCorrectedReference(0), mnBAGlobalForKF(0), mnVisible(1), mnFound(1), mbBad(false),
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mnDescriptorStride(0), mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL))
 {
     mpReplaced = static_cast<MapPoint*>(NULL);
@@ -39,7 +57,7 @@ MapPoint::MapPoint():
 MapPoint::MapPoint(const Eigen::Vector3f &Pos, KeyFrame *pRefKF, Map* pMap):
     mnFirstKFid(pRefKF->mnId), mnFirstFrame(pRefKF->mnFrameId), nObs(0), mnTrackReferenceForFrame(0),
     mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
-    mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mnDescriptorStride(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap),
     mnOriginMapId(pMap->GetId())
 {
@@ -58,7 +76,7 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, KeyFrame *pRefKF, Map* pMap):
 MapPoint::MapPoint(const double invDepth, cv::Point2f uv_init, KeyFrame* pRefKF, KeyFrame* pHostKF, Map* pMap):
     mnFirstKFid(pRefKF->mnId), mnFirstFrame(pRefKF->mnFrameId), nObs(0), mnTrackReferenceForFrame(0),
     mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
-    mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mnDescriptorStride(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap),
     mnOriginMapId(pMap->GetId())
 {
@@ -78,7 +96,7 @@ MapPoint::MapPoint(const double invDepth, cv::Point2f uv_init, KeyFrame* pRefKF,
 MapPoint::MapPoint(const Eigen::Vector3f &Pos, Map* pMap, Frame* pFrame, const int &idxF):
     mnFirstKFid(-1), mnFirstFrame(pFrame->mnId), nObs(0), mnTrackReferenceForFrame(0), mnLastFrameSeen(0),
     mnBALocalForKF(0), mnFuseCandidateForKF(0),mnLoopPointForKF(0), mnCorrectedByKF(0),
-    mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
+    mnCorrectedReference(0), mnBAGlobalForKF(0), mnDescriptorStride(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
     mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap), mnOriginMapId(pMap->GetId())
 {
     SetWorldPos(Pos);
@@ -117,30 +135,44 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, Map* pMap, Frame* pFrame, const i
 
 void MapPoint::SetWorldPos(const Eigen::Vector3f &Pos) {
     unique_lock<mutex> lock2(mGlobalMutex);
-    unique_lock<mutex> lock(mMutexPos);
+    unique_lock<StripedMutex> lock(MutexPos());
+    mPosSeq.BeginWrite();
     mWorldPos = Pos;
+    mPosSeq.EndWrite();
 }
 
 Eigen::Vector3f MapPoint::GetWorldPos() {
-    unique_lock<mutex> lock(mMutexPos);
-    return mWorldPos;
+    Eigen::Vector3f Pos;
+    unsigned int seq;
+    do
+    {
+        seq = mPosSeq.BeginRead();
+        Pos = mWorldPos;
+    } while(mPosSeq.Retry(seq));
+    return Pos;
 }
 
 Eigen::Vector3f MapPoint::GetNormal() {
-    unique_lock<mutex> lock(mMutexPos);
-    return mNormalVector;
+    Eigen::Vector3f normal;
+    unsigned int seq;
+    do
+    {
+        seq = mPosSeq.BeginRead();
+        normal = mNormalVector;
+    } while(mPosSeq.Retry(seq));
+    return normal;
 }
 
 
 KeyFrame* MapPoint::GetReferenceKeyFrame()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return mpRefKF;
 }
 
 void MapPoint::AddObservation(KeyFrame* pKF, int idx)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     tuple<int,int> indexes;
 
     if(mObservations.count(pKF)){
@@ -169,7 +201,7 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
 {
     bool bBad=false;
     {
-        unique_lock<mutex> lock(mMutexFeatures);
+        unique_lock<StripedMutex> lock(MutexFeatures());
         if(mObservations.count(pKF))
         {
             tuple<int,int> indexes = mObservations[pKF];
@@ -203,22 +235,24 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
 
 std::map<KeyFrame*, std::tuple<int,int>>  MapPoint::GetObservations()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return mObservations;
 }
 
 int MapPoint::Observations()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return nObs;
 }
 
 void MapPoint::SetBadFlag()
 {
     map<KeyFrame*, tuple<int,int>> obs;
+    bool bWasBad;
     {
-        unique_lock<mutex> lock1(mMutexFeatures);
-        unique_lock<mutex> lock2(mMutexPos);
+        unique_lock<StripedMutex> lock1(MutexFeatures());
+        unique_lock<StripedMutex> lock2(MutexPos());
+        bWasBad = mbBad;
         mbBad=true;
         obs = mObservations;
         mObservations.clear();
@@ -235,13 +269,22 @@ void MapPoint::SetBadFlag()
         }
     }
 
+    {
+        unique_lock<StripedMutex> lock(MutexDescriptors());
+        ClearDescriptorCache();
+    }
+
     mpMap->EraseMapPoint(this);
+
+    EpochReclaimer* pReclaimer = EpochReclaimer::GetInstance();
+    if(pReclaimer && !bWasBad)
+        pReclaimer->Retire(this);
 }
 
 MapPoint* MapPoint::GetReplaced()
 {
-    unique_lock<mutex> lock1(mMutexFeatures);
-    unique_lock<mutex> lock2(mMutexPos);
+    unique_lock<StripedMutex> lock1(MutexFeatures());
+    unique_lock<StripedMutex> lock2(MutexPos());
     return mpReplaced;
 }
 
@@ -252,11 +295,13 @@ void MapPoint::Replace(MapPoint* pMP)
 
     int nvisible, nfound;
     map<KeyFrame*,tuple<int,int>> obs;
+    bool bWasBad;
     {
-        unique_lock<mutex> lock1(mMutexFeatures);
-        unique_lock<mutex> lock2(mMutexPos);
+        unique_lock<StripedMutex> lock1(MutexFeatures());
+        unique_lock<StripedMutex> lock2(MutexPos());
         obs=mObservations;
         mObservations.clear();
+        bWasBad = mbBad;
         mbBad=true;
         nvisible = mnVisible;
         nfound = mnFound;
@@ -296,13 +341,23 @@ void MapPoint::Replace(MapPoint* pMP)
     pMP->IncreaseVisible(nvisible);
     pMP->ComputeDistinctiveDescriptors();
 
+    {
+        unique_lock<StripedMutex> lock(MutexDescriptors());
+        ClearDescriptorCache();
+    }
+
     mpMap->EraseMapPoint(this);
+
+    // Frames that still hold this point follow mpReplaced, which stays valid until the point is deleted
+    EpochReclaimer* pReclaimer = EpochReclaimer::GetInstance();
+    if(pReclaimer && !bWasBad)
+        pReclaimer->Retire(this);
 }
 
 bool MapPoint::isBad()
 {
-    unique_lock<mutex> lock1(mMutexFeatures,std::defer_lock);
-    unique_lock<mutex> lock2(mMutexPos,std::defer_lock);
+    unique_lock<StripedMutex> lock1(MutexFeatures(),std::defer_lock);
+    unique_lock<StripedMutex> lock2(MutexPos(),std::defer_lock);
     lock(lock1, lock2);
 
     return mbBad;
@@ -310,31 +365,29 @@ bool MapPoint::isBad()
 
 void MapPoint::IncreaseVisible(int n)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     mnVisible+=n;
 }
 
 void MapPoint::IncreaseFound(int n)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     mnFound+=n;
 }
 
 float MapPoint::GetFoundRatio()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return static_cast<float>(mnFound)/mnVisible;
 }
 
 void MapPoint::ComputeDistinctiveDescriptors()
 {
     // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
-
     map<KeyFrame*,tuple<int,int>> observations;
 
     {
-        unique_lock<mutex> lock1(mMutexFeatures);
+        unique_lock<StripedMutex> lock1(MutexFeatures());
         if(mbBad)
             return;
         observations=mObservations;
@@ -343,7 +396,8 @@ void MapPoint::ComputeDistinctiveDescriptors()
     if(observations.empty())
         return;
 
-    vDescriptors.reserve(observations.size());
+    vector<pair<KeyFrame*,int> > vKeys;
+    vKeys.reserve(2*observations.size());
 
     for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
     {
@@ -354,63 +408,224 @@ void MapPoint::ComputeDistinctiveDescriptors()
             int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
 
             if(leftIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(leftIndex));
+                vKeys.push_back(make_pair(pKF,leftIndex));
             }
             if(rightIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(rightIndex));
+                vKeys.push_back(make_pair(pKF,rightIndex));
             }
         }
     }
 
-    if(vDescriptors.empty())
+    if(vKeys.empty())
         return;
 
-    // Compute distances between them
-    const size_t N = vDescriptors.size();
+    const size_t N = vKeys.size();
+    const size_t nMedian = (N-1)/2;
+    int BestMedian = INT_MAX;
+    int BestIdx = 0;
+
+    unique_lock<StripedMutex> lockDesc(MutexDescriptors());
 
-    float Distances[N][N];
-    for(size_t i=0;i<N;i++)
+    if(N>MAX_CACHED_DESCRIPTORS)
     {
-        Distances[i][i]=0;
-        for(size_t j=i+1;j<N;j++)
+        // Too many observations to keep the tables, compute the distances row by row
+        ClearDescriptorCache();
+
+        vector<const uint8_t*> vpDescriptors(N);
+        for(size_t i=0;i<N;i++)
+            vpDescriptors[i] = vKeys[i].first->mDescriptors.ptr<uint8_t>(vKeys[i].second);
+
+        vector<int> vRow(N);
+        for(size_t i=0;i<N;i++)
         {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
+            ORBmatcher::DescriptorDistances(vpDescriptors[i],&vpDescriptors[0],N,&vRow[0]);
+            nth_element(vRow.begin(),vRow.begin()+nMedian,vRow.end());
+            if(vRow[nMedian]<BestMedian)
+            {
+                BestMedian = vRow[nMedian];
+                BestIdx = i;
+            }
         }
     }
+    else
+    {
+        // Match the observations against the cached rows. vKeys is sorted by keyframe and then by keypoint
+        // index (right indices come after the left ones), the rows are sorted the same way for one merge pass.
+        // vRowOfKey[i] is the row of vKeys[i], -1 if it is a new observation.
+        size_t nRows = mvDescriptorKeys.size();
+        vector<int> vSortedRows(nRows);
+        for(size_t r=0;r<nRows;r++)
+            vSortedRows[r] = r;
+        sort(vSortedRows.begin(),vSortedRows.end(),[this](const int a, const int b){
+            return LessDescriptorKey(mvDescriptorKeys[a],mvDescriptorKeys[b]); });
+
+        vector<int> vRowOfKey(N,-1);
+        vector<int> vKeyOfRow(nRows,-1);
+        for(size_t i=0, j=0; i<N && j<nRows; )
+        {
+            const int row = vSortedRows[j];
+            if(vKeys[i]==mvDescriptorKeys[row])
+            {
+                vRowOfKey[i] = row;
+                vKeyOfRow[row] = i;
+                i++; j++;
+            }
+            else if(LessDescriptorKey(vKeys[i],mvDescriptorKeys[row]))
+                i++;
+            else
+                j++;
+        }
 
-    // Take the descriptor with least median distance to the rest
-    int BestMedian = INT_MAX;
-    int BestIdx = 0;
-    for(size_t i=0;i<N;i++)
+        // Drop the observations that are gone. Going down, the row moved into a freed slot is always a kept one.
+        for(int r=nRows-1;r>=0;r--)
+        {
+            if(vKeyOfRow[r]>=0)
+                continue;
+            RemoveDescriptorRow(r);
+            nRows--;
+            if((size_t)r<nRows)
+            {
+                vKeyOfRow[r] = vKeyOfRow[nRows];
+                vRowOfKey[vKeyOfRow[r]] = r;
+            }
+        }
+
+        // Append the new ones, one row and one column each
+        for(size_t i=0;i<N;i++)
+        {
+            if(vRowOfKey[i]<0)
+            {
+                AddDescriptorRow(vKeys[i]);
+                vRowOfKey[i] = nRows++;
+            }
+        }
+
+        // Take the descriptor with least median distance to the rest, read from the sorted rows
+        for(size_t i=0;i<N;i++)
+        {
+            const int median = mvDescriptorSortedDistances[vRowOfKey[i]*mnDescriptorStride+nMedian];
+            if(median<BestMedian)
+            {
+                BestMedian = median;
+                BestIdx = i;
+            }
+        }
+    }
+
+    cv::Mat bestDescriptor = vKeys[BestIdx].first->mDescriptors.row(vKeys[BestIdx].second).clone();
+
+    lockDesc.unlock();
+
+    {
+        unique_lock<StripedMutex> lock(MutexFeatures());
+        mDescriptor = bestDescriptor;
+    }
+}
+
+void MapPoint::ClearDescriptorCache()
+{
+    vector<pair<KeyFrame*,int> >().swap(mvDescriptorKeys);
+    vector<uint8_t>().swap(mvDescriptorDistances);
+    vector<uint8_t>().swap(mvDescriptorSortedDistances);
+    mnDescriptorStride = 0;
+}
+
+void MapPoint::RemoveDescriptorRow(const size_t r)
+{
+    const size_t n = mvDescriptorKeys.size();
+    const size_t last = n-1;
+    const size_t S = mnDescriptorStride;
+
+    // Take the distance to r out of the order statistics of every other row
+    for(size_t i=0;i<n;i++)
     {
-        vector<int> vDists(Distances[i],Distances[i]+N);
-        sort(vDists.begin(),vDists.end());
-        int median = vDists[0.5*(N-1)];
+        if(i==r)
+            continue;
+        uint8_t* pRow = &mvDescriptorSortedDistances[i*S];
+        uint8_t* pos = lower_bound(pRow,pRow+n,mvDescriptorDistances[i*S+r]);
+        copy(pos+1,pRow+n,pos);
+    }
+
+    // Move the last row and column into r
+    if(r!=last)
+    {
+        copy(&mvDescriptorDistances[last*S],&mvDescriptorDistances[last*S]+n,&mvDescriptorDistances[r*S]);
+        copy(&mvDescriptorSortedDistances[last*S],&mvDescriptorSortedDistances[last*S]+last,&mvDescriptorSortedDistances[r*S]);
+        for(size_t i=0;i<last;i++)
+            mvDescriptorDistances[i*S+r] = mvDescriptorDistances[i*S+last];
+        mvDescriptorKeys[r] = mvDescriptorKeys[last];
+    }
+    mvDescriptorKeys.pop_back();
+}
+
+void MapPoint::AddDescriptorRow(const pair<KeyFrame*,int> &key)
+{
+    const size_t n = mvDescriptorKeys.size();
 
-        if(median<BestMedian)
+    if(n+1>mnDescriptorStride)
+    {
+        // Grow both tables, keeping the rows in place
+        const size_t S = mnDescriptorStride;
+        const size_t newS = min(max((size_t)8,2*S),MAX_CACHED_DESCRIPTORS);
+        vector<uint8_t> vDistances(newS*newS), vSorted(newS*newS);
+        for(size_t i=0;i<n;i++)
         {
-            BestMedian = median;
-            BestIdx = i;
+            copy(&mvDescriptorDistances[i*S],&mvDescriptorDistances[i*S]+n,&vDistances[i*newS]);
+            copy(&mvDescriptorSortedDistances[i*S],&mvDescriptorSortedDistances[i*S]+n,&vSorted[i*newS]);
         }
+        mvDescriptorDistances.swap(vDistances);
+        mvDescriptorSortedDistances.swap(vSorted);
+        mnDescriptorStride = newS;
     }
 
+    const size_t S = mnDescriptorStride;
+
+    vector<const uint8_t*> vpDescriptors(n+1);
+    for(size_t i=0;i<n;i++)
+        vpDescriptors[i] = mvDescriptorKeys[i].first->mDescriptors.ptr<uint8_t>(mvDescriptorKeys[i].second);
+    vpDescriptors[n] = key.first->mDescriptors.ptr<uint8_t>(key.second);
+
+    vector<int> vDists(n+1);
+    ORBmatcher::DescriptorDistances(vpDescriptors[n],&vpDescriptors[0],n+1,&vDists[0]);
+
+    mvDescriptorDistances[n*S+n] = 0;
+    for(size_t i=0;i<n;i++)
     {
-        unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();
+        // 256 (all bits differ) is stored as 255, it can only tie a median with another saturated one
+        const uint8_t dist = min(vDists[i],255);
+        mvDescriptorDistances[n*S+i] = mvDescriptorDistances[i*S+n] = dist;
+
+        // Insert the new distance in the order statistics of row i
+        uint8_t* pRow = &mvDescriptorSortedDistances[i*S];
+        uint8_t* pos = upper_bound(pRow,pRow+n,dist);
+        copy_backward(pos,pRow+n,pRow+n+1);
+        *pos = dist;
     }
+
+    copy(&mvDescriptorDistances[n*S],&mvDescriptorDistances[n*S]+n+1,&mvDescriptorSortedDistances[n*S]);
+    sort(&mvDescriptorSortedDistances[n*S],&mvDescriptorSortedDistances[n*S]+n+1);
+
+    mvDescriptorKeys.push_back(key);
 }
 
 cv::Mat MapPoint::GetDescriptor()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return mDescriptor.clone();
 }
 
+bool MapPoint::CopyDescriptor(unsigned char* pDesc)
+{
+    unique_lock<StripedMutex> lock(MutexFeatures());
+    if(mbBad || mDescriptor.empty())
+        return false;
+    memcpy(pDesc,mDescriptor.ptr<unsigned char>(),32);
+    return true;
+}
+
 tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     if(mObservations.count(pKF))
         return mObservations[pKF];
     else
@@ -419,7 +634,7 @@ tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 
 bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
+    unique_lock<StripedMutex> lock(MutexFeatures());
     return (mObservations.count(pKF));
 }
 
@@ -429,8 +644,8 @@ void MapPoint::UpdateNormalAndDepth()
     KeyFrame* pRefKF;
     Eigen::Vector3f Pos;
     {
-        unique_lock<mutex> lock1(mMutexFeatures);
-        unique_lock<mutex> lock2(mMutexPos);
+        unique_lock<StripedMutex> lock1(MutexFeatures());
+        unique_lock<StripedMutex> lock2(MutexPos());
         if(mbBad)
             return;
         observations = mObservations;
@@ -486,38 +701,69 @@ void MapPoint::UpdateNormalAndDepth()
     const int nLevels = pRefKF->mnScaleLevels;
 
     {
-        unique_lock<mutex> lock3(mMutexPos);
+        unique_lock<StripedMutex> lock3(MutexPos());
+        mPosSeq.BeginWrite();
         mfMaxDistance = dist*levelScaleFactor;
         mfMinDistance = mfMaxDistance/pRefKF->mvScaleFactors[nLevels-1];
         mNormalVector = no       rmal/n;
+        mPosSeq.EndWrite();
     }
 }
 
 void MapPoint::SetNormalVector(const Eigen::Vector3f& normal)
 {
-    unique_lock<mutex> lock3(mMutexPos);
+    unique_lock<StripedMutex> lock3(MutexPos());
+    mPosSeq.BeginWrite();
     mNormalVector = normal;
+    mPosSeq.EndWrite();
 }
 
 float MapPoint::GetMinDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 0.8f * mfMinDistance;
+    float minDistance;
+    unsigned int seq;
+    do
+    {
+        seq = mPosSeq.BeginRead();
+        minDistance = mfMinDistance;
+    } while(mPosSeq.Retry(seq));
+    return 0.8f * minDistance;
 }
 
 float MapPoint::GetMaxDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 1.2f * mfMaxDistance;
+    float maxDistance;
+    unsigned int seq;
+    do
+    {
+        seq = mPosSeq.BeginRead();
+        maxDistance = mfMaxDistance;
+    } while(mPosSeq.Retry(seq));
+    return 1.2f * maxDistance;
+}
+
+void MapPoint::GetPosNormalDistances(Eigen::Vector3f &pos, Eigen::Vector3f &normal, float &minDistance, float &maxDistance)
+{
+    unsigned int seq;
+    do
+    {
+        seq = mPosSeq.BeginRead();
+        pos = mWorldPos;
+        normal = mNormalVector;
+        minDistance = mfMinDistance;
+        maxDistance = mfMaxDistance;
+    } while(mPosSeq.Retry(seq));
 }
 
 int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 {
     float ratio;
+    unsigned int seq;
+    do
     {
-        unique_lock<mutex> lock(mMutexPos);
+        seq = mPosSeq.BeginRead();
         ratio = mfMaxDistance/currentDist;
-    }
+    } while(mPosSeq.Retry(seq));
 
     int nScale = ceil(log(ratio)/pKF->mfLogScaleFactor);
     if(nScale<0)
@@ -531,10 +777,12 @@ int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 {
     float ratio;
+    unsigned int seq;
+    do
     {
-        unique_lock<mutex> lock(mMutexPos);
+        seq = mPosSeq.BeginRead();
         ratio = mfMaxDistance/currentDist;
-    }
+    } while(mPosSeq.Retry(seq));
 
     int nScale = ceil(log(ratio)/pF->mfLogScaleFactor);
     if(nScale<0)
@@ -559,13 +807,13 @@ void MapPoint::PrintObservations()
 
 Map* MapPoint::GetMap()
 {
-    unique_lock<mutex> lock(mMutexMap);
+    unique_lock<StripedMutex> lock(MutexMap());
     return mpMap;
 }
 
 void MapPoint::UpdateMap(Map* pMap)
 {
-    unique_lock<mutex> lock(mMutexMap);
+    unique_lock<StripedMutex> lock(MutexMap());
     mpMap = pMap;
 }
 
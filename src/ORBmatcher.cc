@@ -24,11 +24,168 @@
 #include<opencv2/core/core.hpp>
 
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
+#include "LocalMapSnapshot.h"
+#include "ThreadPool.h"
 
 #include<stdint-gcc.h>
+#include<string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include<immintrin.h>
+#define ORB_HAMMING_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include<arm_neon.h>
+#define ORB_HAMMING_NEON
+#endif
 
 using namespace std;
 
+namespace
+{
+    // Hamming kernels over 256 bit ORB descriptors (32 bytes per row).
+    // Each kernel computes the distance from pa to every descriptor in ppb[0..n-1].
+    typedef void (*HammingKernel)(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist);
+
+    // Number of candidate rows gathered per kernel call
+    const int HAMMING_BLOCK = 64;
+
+    inline int HammingScalar(const uint8_t* pa, const uint8_t* pb)
+    {
+        uint64_t a[4], b[4];
+        memcpy(a,pa,32);
+        memcpy(b,pb,32);
+        return __builtin_popcountll(a[0]^b[0]) + __builtin_popcountll(a[1]^b[1]) +
+               __builtin_popcountll(a[2]^b[2]) + __builtin_popcountll(a[3]^b[3]);
+    }
+
+    void HammingBatchScalar(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist)
+    {
+        for(int i=0; i<n; i++)
+            pDist[i] = HammingScalar(pa,ppb[i]);
+    }
+
+#ifdef ORB_HAMMING_X86
+    // Sum of the four 64 bit lanes
+    __attribute__((target("avx2")))
+    inline int HorizontalSum64(const __m256i v)
+    {
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+        s = _mm_add_epi64(s,_mm_unpackhi_epi64(s,s));
+        return _mm_cvtsi128_si32(s);
+    }
+
+    // Nibble lookup popcount (vpshufb) followed by a byte sum per 64 bit lane (vpsadbw)
+    __attribute__((target("avx2")))
+    void HammingBatchAVX2(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist)
+    {
+        const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                                0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const __m256i lowMask = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa));
+
+        for(int i=0; i<n; i++)
+        {
+            const __m256i v = _mm256_xor_si256(a,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ppb[i])));
+            const __m256i lo = _mm256_shuffle_epi8(lookup,_mm256_and_si256(v,lowMask));
+            const __m256i hi = _mm256_shuffle_epi8(lookup,_mm256_and_si256(_mm256_srli_epi16(v,4),lowMask));
+            pDist[i] = HorizontalSum64(_mm256_sad_epu8(_mm256_add_epi8(lo,hi),zero));
+        }
+    }
+
+    __attribute__((target("avx2,avx512f,avx512vl,avx512vpopcntdq")))
+    void HammingBatchAVX512(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa));
+
+        for(int i=0; i<n; i++)
+        {
+            const __m256i v = _mm256_xor_si256(a,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ppb[i])));
+            pDist[i] = HorizontalSum64(_mm256_popcnt_epi64(v));
+        }
+    }
+#endif
+
+#ifdef ORB_HAMMING_NEON
+    void HammingBatchNEON(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist)
+    {
+        const uint8x16_t a0 = vld1q_u8(pa);
+        const uint8x16_t a1 = vld1q_u8(pa+16);
+
+        for(int i=0; i<n; i++)
+        {
+            const uint8x16_t c = vaddq_u8(vcntq_u8(veorq_u8(a0,vld1q_u8(ppb[i]))),
+                                          vcntq_u8(veorq_u8(a1,vld1q_u8(ppb[i]+16))));
+            const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(c)));
+            pDist[i] = static_cast<int>(vgetq_lane_u64(s,0) + vgetq_lane_u64(s,1));
+        }
+    }
+#endif
+
+    HammingKernel SelectHammingKernel()
+    {
+#ifdef ORB_HAMMING_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512vl"))
+            return HammingBatchAVX512;
+        if(__builtin_cpu_supports("avx2"))
+            return HammingBatchAVX2;
+#elif defined(ORB_HAMMING_NEON)
+        return HammingBatchNEON;
+#endif
+        return HammingBatchScalar;
+    }
+
+    // Runtime CPU dispatch, resolved once per process
+    inline HammingKernel GetHammingKernel()
+    {
+        static const HammingKernel kernel = SelectHammingKernel();
+        return kernel;
+    }
+
+    template<typename Index>
+    void DescriptorDistancesToRows(const cv::Mat &a, const cv::Mat &B, const vector<Index> &vIndices, vector<int> &vDist, const size_t offset)
+    {
+        const int n = vIndices.size();
+        vDist.resize(n);
+        if(n==0)
+            return;
+
+        const HammingKernel kernel = GetHammingKernel();
+        const uint8_t* pa = a.ptr<uint8_t>();
+        const uint8_t* ppb[HAMMING_BLOCK];
+
+        for(int i0=0; i0<n; i0+=HAMMING_BLOCK)
+        {
+            const int nb = min(HAMMING_BLOCK,n-i0);
+            for(int j=0; j<nb; j++)
+                ppb[j] = B.ptr<uint8_t>(vIndices[i0+j]+offset);
+            kernel(pa,ppb,nb,&vDist[i0]);
+        }
+    }
+
+    // Map points per block of the parallel pass of SearchByProjection
+    const int PROJECTION_BLOCK = 32;
+
+    // Keypoints that the map points of one block may be matched to. For the k-th point of the block,
+    // entries [vOffsets[2k],vOffsets[2k+1]) are in the left image and [vOffsets[2k+1],vOffsets[2k+2])
+    // in the right one.
+    struct ProjectionCandidates
+    {
+        vector<int> vIdx;
+        vector<int> vDist;
+        vector<int> vLevel;
+        vector<int> vOffsets;
+
+        void Add(const int idx, const int dist, const int level)
+        {
+            vIdx.push_back(idx);
+            vDist.push_back(dist);
+            vLevel.push_back(level);
+        }
+    };
+}
+
 namespace ORB_SLAM3
 {
 
@@ -41,171 +198,241 @@ namespace ORB_SLAM3
     }
 
     int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints)
+    {
+        return SearchByProjection(F,vpMapPoints,static_cast<const cv::Mat*>(NULL),th,bFarPoints,thFarPoints);
+    }
+
+    int ORBmatcher::SearchByProjection(Frame &F, const LocalMapSnapshot &localMap, const float th, const bool bFarPoints, const float thFarPoints)
+    {
+        return SearchByProjection(F,localMap.mvpMapPoints,&localMap.mDescriptors,th,bFarPoints,thFarPoints);
+    }
+
+    int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const cv::Mat* pDescriptors, const float th, const bool bFarPoints, const float thFarPoints)
     {
         int nmatches=0, left = 0, right = 0;
 
         const bool bFactor = th!=1.0;
+        const int nMPs = vpMapPoints.size();
 
-        for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
-        {
-            MapPoint* pMP = vpMapPoints[iMP];
-            if(!pMP->mbTrackInView && !pMP->mbTrackInViewR)
-                continue;
+        // First pass, in parallel over blocks of map points: keypoints in the search window of each point
+        // that are not matched yet, with their descriptor distance and octave. Every block only writes its
+        // own buffer. Keypoints already matched to an observed MapPoint are left out here, the ones matched
+        // during this search are skipped in the second pass.
+        const int nBlocks = (nMPs+PROJECTION_BLOCK-1)/PROJECTION_BLOCK;
+        vector<ProjectionCandidates> vBlocks(nBlocks);
 
-            if(bFarPoints && pMP->mTrackDepth>thFarPoints)
-                continue;
+        auto searchBlock = [&](const int iBlock)
+        {
+            ProjectionCandidates &block = vBlocks[iBlock];
+            const int iBegin = iBlock*PROJECTION_BLOCK;
+            const int iEnd = min(iBegin+PROJECTION_BLOCK,nMPs);
+            block.vOffsets.reserve(2*(iEnd-iBegin)+1);
+            block.vOffsets.push_back(0);
 
-            if(pMP->isBad())
-                continue;
+            // Distances from the map point descriptor to all candidates, computed in one batch
+            vector<int> vDist;
 
-            if(pMP->mbTrackInView)
+            for(int iMP=iBegin; iMP<iEnd; iMP++)
             {
-                const int &nPredictedLevel = pMP->mnTrackScaleLevel;
+                MapPoint* pMP = vpMapPoints[iMP];
+                bool bSearch = pMP->mbTrackInView || pMP->mbTrackInViewR;
+                if(bSearch && bFarPoints && pMP->mTrackDepth>thFarPoints)
+                    bSearch = false;
+                if(bSearch && pMP->isBad())
+                    bSearch = false;
+
+                if(bSearch && pMP->mbTrackInView)
+                {
+                    const int &nPredictedLevel = pMP->mnTrackScaleLevel;
 
-                // The size of the window will depend on the viewing direction
-                float r = RadiusByViewingCos(pMP->mTrackViewCos);
+                    // The size of the window will depend on the viewing direction
+                    float r = RadiusByViewingCos(pMP->mTrackViewCos);
 
-                if(bFactor)
-                    r*=th;
+                    if(bFactor)
+                        r*=th;
 
-                const vector<size_t> vIndices =
-                        F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
+                    const vector<size_t> vIndices =
+                            F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
 
-                if(!vIndices.empty()){
-                    const cv::Mat MPdescriptor = pMP->GetDescriptor();
+                    if(!vIndices.empty()){
+                        const cv::Mat MPdescriptor = pDescriptors ? pDescriptors->row(iMP) : pMP->GetDescriptor();
+                        DescriptorDistances(MPdescriptor,F.mDescriptors,vIndices,vDist);
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
+                        for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
+                        {
+                            const size_t idx = vIndices[iC];
 
-                    // Get best and second matches with near keypoints
-                    for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-                    {
-                        const size_t idx = *vit;
+                            if(F.mvpMapPoints[idx])
+                                if(F.mvpMapPoints[idx]->Observations()>0)
+                                    continue;
 
-                        if(F.mvpMapPoints[idx])
-                            if(F.mvpMapPoints[idx]->Observations()>0)
-                                continue;
+                            if(F.Nleft == -1 && F.mvuRight[idx]>0)
+                            {
+                                const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
+                                if(er>r*F.mvScaleFactors[nPredictedLevel])
+                                    continue;
+                            }
 
-                        if(F.Nleft == -1 && F.mvuRight[idx]>0)
-                        {
-                            const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
-                            if(er>r*F.mvScaleFactors[nPredictedLevel])
-                                continue;
+                            const int level = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
+                                                              : (idx < F.Nleft) ? F.mvKeys[idx].octave
+                                                                                : F.mvKeysRight[idx - F.Nleft].octave;
+                            block.Add(idx,vDist[iC],level);
                         }
+                    }
+                }
+                block.vOffsets.push_back(block.vIdx.size());
 
-                        const cv::Mat &d = F.mDescriptors.row(idx);
+                if(bSearch && F.Nleft != -1 && pMP->mbTrackInViewR){
+                    const int &nPredictedLevel = pMP->mnTrackScaleLevelR;
+                    if(nPredictedLevel != -1){
+                        float r = RadiusByViewingCos(pMP->mTrackViewCosR);
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                        const vector<size_t> vIndices =
+                                F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel,true);
 
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                        : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                          : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                                                         : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                                                           : F.mvKeysRight[idx - F.Nleft].octave;
-                            bestDist2=dist;
-                        }
-                    }
+                        if(!vIndices.empty()){
+                            const cv::Mat MPdescriptor = pDescriptors ? pDescriptors->row(iMP) : pMP->GetDescriptor();
+                            DescriptorDistances(MPdescriptor,F.mDescriptors,vIndices,vDist,F.Nleft);
 
-                    // Apply ratio to second match (only if best and second are in the same scale level)
-                    if(bestDist<=TH_HIGH)
-                    {
-                        if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
-                            continue;
+                            for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
+                            {
+                                const size_t idx = vIndices[iC];
 
-                        if(bestLevel!=bestLevel2 || bestDist<=mfNNratio*bestDist2){
-                            F.mvpMapPoints[bestIdx]=pMP;
+                                if(F.mvpMapPoints[idx + F.Nleft])
+                                    if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
+                                        continue;
 
-                            if(F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
-                                F.mvpMapPoints[F.mvLeftToRightMatch[bestIdx] + F.Nleft] = pMP;
-                                nmatches++;
-                                right++;
+                                block.Add(idx,vDist[iC],F.mvKeysRight[idx].octave);
                             }
-
-                            nmatches++;
-                            left++;
                         }
                     }
                 }
+                block.vOffsets.push_back(block.vIdx.size());
             }
+        };
 
-            if(F.Nleft != -1 && pMP->mbTrackInViewR){
-                const int &nPredictedLevel = pMP->mnTrackScaleLevelR;
-                if(nPredictedLevel != -1){
-                    float r = RadiusByViewingCos(pMP->mTrackViewCosR);
+        ThreadPool* pThreadPool = ThreadPool::GetInstance();
+        if(pThreadPool && nBlocks>1)
+            pThreadPool->ParallelFor(0,nBlocks,searchBlock,true);
+        else
+            for(int iBlock=0; iBlock<nBlocks; iBlock++)
+                searchBlock(iBlock);
 
-                    const vector<size_t> vIndices =
-                            F.GetFeaturesInArea(pMP->mTrackProjXR,pMP->mTrackProjYR,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel,true);
+        // Second pass, sequential in the order of vpMapPoints: best and second best candidates and
+        // assignment, so the matches are the same whatever the number of threads
+        for(int iMP=0; iMP<nMPs; iMP++)
+        {
+            MapPoint* pMP = vpMapPoints[iMP];
+            const ProjectionCandidates &block = vBlocks[iMP/PROJECTION_BLOCK];
+            const int k = iMP%PROJECTION_BLOCK;
 
-                    if(vIndices.empty())
-                        continue;
+            const int iLeftBegin = block.vOffsets[2*k], iLeftEnd = block.vOffsets[2*k+1];
+            if(iLeftBegin<iLeftEnd)
+            {
+                int bestDist=256;
+                int bestLevel= -1;
+                int bestDist2=256;
+                int bestLevel2 = -1;
+                int bestIdx =-1 ;
+
+                // Get best and second matches with near keypoints
+                for(int iC=iLeftBegin; iC<iLeftEnd; iC++)
+                {
+                    const int idx = block.vIdx[iC];
 
-                    const cv::Mat MPdescriptor = pMP->GetDescriptor();
+                    if(F.mvpMapPoints[idx])
+                        if(F.mvpMapPoints[idx]->Observations()>0)
+                            continue;
 
-                    int bestDist=256;
-                    int bestLevel= -1;
-                    int bestDist2=256;
-                    int bestLevel2 = -1;
-                    int bestIdx =-1 ;
+                    const int dist = block.vDist[iC];
 
-                    // Get best and second matches with near keypoints
-                    for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+                    if(dist<bestDist)
                     {
-                        const size_t idx = *vit;
-
-                        if(F.mvpMapPoints[idx + F.Nleft])
-                            if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
-                                continue;
-
+                        bestDist2=bestDist;
+                        bestDist=dist;
+                        bestLevel2 = bestLevel;
+                        bestLevel = block.vLevel[iC];
+                        bestIdx=idx;
+                    }
+                    else if(dist<bestDist2)
+                    {
+                        bestLevel2 = block.vLevel[iC];
+                        bestDist2=dist;
+                    }
+                }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx + F.Nleft);
+                // Apply ratio to second match (only if best and second are in the same scale level)
+                if(bestDist<=TH_HIGH)
+                {
+                    if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+                        continue;
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                    if(bestLevel!=bestLevel2 || bestDist<=mfNNratio*bestDist2){
+                        F.mvpMapPoints[bestIdx]=pMP;
 
-                        if(dist<bestDist)
-                        {
-                            bestDist2=bestDist;
-                            bestDist=dist;
-                            bestLevel2 = bestLevel;
-                            bestLevel = F.mvKeysRight[idx].octave;
-                            bestIdx=idx;
-                        }
-                        else if(dist<bestDist2)
-                        {
-                            bestLevel2 = F.mvKeysRight[idx].octave;
-                            bestDist2=dist;
+                        if(F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
+                            F.mvpMapPoints[F.mvLeftToRightMatch[bestIdx] + F.Nleft] = pMP;
+                            nmatches++;
+                            right++;
                         }
+
+                        nmatches++;
+                        left++;
                     }
+                }
+            }
 
-                    // Apply ratio to second match (only if best and second are in the same scale level)
-                    if(bestDist<=TH_HIGH)
-                    {
-                        if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+            const int iRightBegin = block.vOffsets[2*k+1], iRightEnd = block.vOffsets[2*k+2];
+            if(iRightBegin<iRightEnd)
+            {
+                int bestDist=256;
+                int bestLevel= -1;
+                int bestDist2=256;
+                int bestLevel2 = -1;
+                int bestIdx =-1 ;
+
+                // Get best and second matches with near keypoints
+                for(int iC=iRightBegin; iC<iRightEnd; iC++)
+                {
+                    const int idx = block.vIdx[iC];
+
+                    if(F.mvpMapPoints[idx + F.Nleft])
+                        if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
                             continue;
 
-                        if(F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
-                            F.mvpMapPoints[F.mvRightToLeftMatch[bestIdx]] = pMP;
-                            nmatches++;
-                            left++;
-                        }
+                    const int dist = block.vDist[iC];
 
+                    if(dist<bestDist)
+                    {
+                        bestDist2=bestDist;
+                        bestDist=dist;
+                        bestLevel2 = bestLevel;
+                        bestLevel = block.vLevel[iC];
+                        bestIdx=idx;
+                    }
+                    else if(dist<bestDist2)
+                    {
+                        bestLevel2 = block.vLevel[iC];
+                        bestDist2=dist;
+                    }
+                }
 
-                        F.mvpMapPoints[bestIdx + F.Nleft]=pMP;
+                // Apply ratio to second match (only if best and second are in the same scale level)
+                if(bestDist<=TH_HIGH)
+                {
+                    if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+                        continue;
+
+                    if(F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1){ //Also match with the stereo observation at right camera
+                        F.mvpMapPoints[F.mvRightToLeftMatch[bestIdx]] = pMP;
                         nmatches++;
-                        right++;
+                        left++;
                     }
+
+
+                    F.mvpMapPoints[bestIdx + F.Nleft]=pMP;
+                    nmatches++;
+                    right++;
                 }
             }
         }
@@ -235,6 +462,8 @@ namespace ORB_SLAM3
             rotHist[i].reserve(500);
         const float factor = 1.0f/HISTO_LENGTH;
 
+        vector<int> vDist;
+
         // We perform the matching over ORB that belong to the same vocabulary node (at a certain level)
         DBoW2::FeatureVector::const_iterator KFit = vFeatVecKF.begin();
         DBoW2::FeatureVector::const_iterator Fit = F.mFeatVec.begin();
@@ -261,6 +490,7 @@ namespace ORB_SLAM3
                         continue;
 
                     const cv::Mat &dKF= pKF->mDescriptors.row(realIdxKF);
+                    DescriptorDistances(dKF,F.mDescriptors,vIndicesF,vDist);
 
                     int bestDist1=256;
                     int bestIdxF =-1 ;
@@ -278,9 +508,7 @@ namespace ORB_SLAM3
                             if(vpMapPointMatches[realIdxF])
                                 continue;
 
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
+                            const int dist = vDist[iF];
 
                             if(dist<bestDist1)
                             {
@@ -299,9 +527,7 @@ namespace ORB_SLAM3
                             if(vpMapPointMatches[realIdxF])
                                 continue;
 
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
+                            const int dist = vDist[iF];
 
                             if(realIdxF < F.Nleft && dist<bestDist1){
                                 bestDist2=bestDist1;
@@ -442,6 +668,8 @@ namespace ORB_SLAM3
 
         int nmatches=0;
 
+        vector<int> vDist;
+
         // For each Candidate MapPoint Project and Match
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
@@ -495,12 +723,13 @@ namespace ORB_SLAM3
 
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
+            DescriptorDistances(dMP,pKF->mDescriptors,vIndices,vDist);
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iC];
                 if(vpMatched[idx])
                     continue;
 
@@ -509,9 +738,7 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-                const int dist = DescriptorDistance(dMP,dKF);
+                const int dist = vDist[iC];
 
                 if(dist<bestDist)
                 {
@@ -549,6 +776,8 @@ namespace ORB_SLAM3
 
         int nmatches=0;
 
+        vector<int> vDist;
+
         // For each Candidate MapPoint Project and Match
         for(int iMP=0, iendMP=vpPoints.size(); iMP<iendMP; iMP++)
         {
@@ -608,12 +837,13 @@ namespace ORB_SLAM3
 
             // Match to the most similar keypoint in the radius
             const cv::Mat dMP = pMP->GetDescriptor();
+            DescriptorDistances(dMP,pKF->mDescriptors,vIndices,vDist);
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iC];
                 if(vpMatched[idx])
                     continue;
 
@@ -622,9 +852,7 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-                const int dist = DescriptorDistance(dMP,dKF);
+                const int dist = vDist[iC];
 
                 if(dist<bestDist)
                 {
@@ -657,6 +885,7 @@ namespace ORB_SLAM3
 
         vector<int> vMatchedDistance(F2.mvKeysUn.size(),INT_MAX);
         vector<int> vnMatches21(F2.mvKeysUn.size(),-1);
+        vector<int> vDist;
         // 遍历第一帧的所有特征点
         for(size_t i1=0, iend1=F1.mvKeysUn.size(); i1<iend1; i1++)
         {
@@ -671,18 +900,18 @@ namespace ORB_SLAM3
                 continue;
 
             cv::Mat d1 = F1.mDescriptors.row(i1);
+            DescriptorDistances(d1,F2.mDescriptors,vIndices2,vDist);
 
             int bestDist = INT_MAX;
             int bestDist2 = INT_MAX;
             int bestIdx2 = -1; // bestIdx2就是最优匹配点，加个2应该想表示第2帧
             // 遍历所有候选点
-            for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+            for(size_t iC=0, iendC=vIndices2.size(); iC<iendC; iC++)
             {
-                size_t i2 = *vit;
+                size_t i2 = vIndices2[iC];
 
-                cv::Mat d2 = F2.mDescriptors.row(i2);
                 // 计算距离，找到匹配最好的两个点
-                int dist = DescriptorDistance(d1,d2);
+                int dist = vDist[iC];
 
                 if(vMatchedDistance[i2]<=dist)
                     continue;
@@ -798,6 +1027,7 @@ namespace ORB_SLAM3
         const float factor = 1.0f/HISTO_LENGTH;
 
         int nmatches = 0;
+        vector<int> vDist;
         // 两帧的FeatureVector进行遍历匹配
         DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
         DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
@@ -824,6 +1054,7 @@ namespace ORB_SLAM3
                         continue;
                     // 取描述子
                     const cv::Mat &d1 = Descriptors1.row(idx1);
+                    DescriptorDistances(d1,Descriptors2,f2it->second,vDist);
 
                     int bestDist1=256;
                     int bestIdx2 =-1 ;
@@ -845,10 +1076,8 @@ namespace ORB_SLAM3
 
                         if(pMP2->isBad())
                             continue;
-                        // 取描述子
-                        const cv::Mat &d2 = Descriptors2.row(idx2);
-                        // 计算距离
-                        int dist = DescriptorDistance(d1,d2);
+                        // 取距离
+                        int dist = vDist[i2];
 
                         if(dist<bestDist1)
                         {
@@ -967,6 +1196,7 @@ namespace ORB_SLAM3
         int nmatches=0;
         vector<bool> vbMatched2(pKF2->N,false);
         vector<int> vMatches12(pKF1->N,-1);
+        vector<int> vDist;
 
         vector<int> rotHist[HISTO_LENGTH];
         for(int i=0;i<HISTO_LENGTH;i++)
@@ -1009,6 +1239,7 @@ namespace ORB_SLAM3
                                                                                        : true;
 
                     const cv::Mat &d1 = pKF1->mDescriptors.row(idx1);
+                    DescriptorDistances(d1,pKF2->mDescriptors,f2it->second,vDist);
 
                     int bestDist = TH_LOW;
                     int bestIdx2 = -1;
@@ -1029,9 +1260,7 @@ namespace ORB_SLAM3
                             if(!bStereo2)
                                 continue;
 
-                        const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
-
-                        const int dist = DescriptorDistance(d1,d2);
+                        const int dist = vDist[i2];
 
                         if(dist>TH_LOW || dist>bestDist)
                             continue;
@@ -1165,6 +1394,13 @@ namespace ORB_SLAM3
     }
 
     int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th, const bool bRight)
+    {
+        vector<pair<MapPoint*,size_t> > vFuse;
+        SearchFuse(pKF,vpMapPoints,vFuse,th,bRight);
+        return ApplyFuse(pKF,vFuse);
+    }
+
+    void ORBmatcher::SearchFuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<MapPoint*,size_t> > &vFuse, const float th, const bool bRight)
     {
         GeometricCamera* pCamera;
         Sophus::SE3f Tcw;
@@ -1187,10 +1423,10 @@ namespace ORB_SLAM3
         const float &cy = pKF->cy;
         const float &bf = pKF->mbf;
 
-        int nFused=0;
-
         const int nMPs = vpMapPoints.size();
 
+        vector<int> vDist;
+
         // For debbuging
         int count_notMP = 0, count_bad=0, count_isinKF = 0, count_negdepth = 0, count_notinim = 0, count_dist = 0, count_normal=0, count_notidx = 0, count_thcheck = 0;
         for(int i=0; i<nMPs; i++)
@@ -1273,12 +1509,13 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
 
             const cv::Mat dMP = pMP->GetDescriptor();
+            DescriptorDistances(dMP,pKF->mDescriptors,vIndices,vDist,bRight ? pKF->NLeft : 0);
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
             {
-                size_t idx = *vit;
+                size_t idx = vIndices[iC];
                 const cv::KeyPoint &kp = (pKF -> NLeft == -1) ? pKF->mvKeysUn[idx]
                                                               : (!bRight) ? pKF -> mvKeys[idx]
                                                                           : pKF -> mvKeysRight[idx];
@@ -1316,9 +1553,7 @@ namespace ORB_SLAM3
 
                 if(bRight) idx += pKF->NLeft;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-                const int dist = DescriptorDistance(dMP,dKF);
+                const int dist = vDist[iC];
 
                 if(dist<bestDist)
                 {
@@ -1327,30 +1562,45 @@ namespace ORB_SLAM3
                 }
             }
 
-            // If there is already a MapPoint replace otherwise add new measurement
             if(bestDist<=TH_LOW)
+                vFuse.push_back(make_pair(pMP,static_cast<size_t>(bestIdx)));
+            else
+                count_thcheck++;
+
+        }
+    }
+
+    int ORBmatcher::ApplyFuse(KeyFrame *pKF, const vector<pair<MapPoint*,size_t> > &vFuse)
+    {
+        int nFused=0;
+
+        for(size_t i=0, iend=vFuse.size(); i<iend; i++)
+        {
+            MapPoint* pMP = vFuse[i].first;
+            const size_t bestIdx = vFuse[i].second;
+
+            // An earlier fusion may have replaced the point or added it to the keyframe
+            if(pMP->isBad() || pMP->IsInKeyFrame(pKF))
+                continue;
+
+            // If there is already a MapPoint replace otherwise add new measurement
+            MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+            if(pMPinKF)
             {
-                MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-                if(pMPinKF)
+                if(!pMPinKF->isBad())
                 {
-                    if(!pMPinKF->isBad())
-                    {
-                        if(pMPinKF->Observations()>pMP->Observations())
-                            pMP->Replace(pMPinKF);
-                        else
-                            pMPinKF->Replace(pMP);
-                    }
-                }
-                else
-                {
-                    pMP->AddObservation(pKF,bestIdx);
-                    pKF->AddMapPoint(pMP,bestIdx);
+                    if(pMPinKF->Observations()>pMP->Observations())
+                        pMP->Replace(pMPinKF);
+                    else
+                        pMPinKF->Replace(pMP);
                 }
-                nFused++;
             }
             else
-                count_thcheck++;
-
+            {
+                pMP->AddObservation(pKF,bestIdx);
+                pKF->AddMapPoint(pMP,bestIdx);
+            }
+            nFused++;
         }
 
         return nFused;
@@ -1375,6 +1625,8 @@ namespace ORB_SLAM3
 
         const int nPoints = vpPoints.size();
 
+        vector<int> vDist;
+
         // For each candidate MapPoint project and match
         for(int iMP=0; iMP<nPoints; iMP++)
         {
@@ -1430,20 +1682,19 @@ namespace ORB_SLAM3
             // Match to the most similar keypoint in the radius
 
             const cv::Mat dMP = pMP->GetDescriptor();
+            DescriptorDistances(dMP,pKF->mDescriptors,vIndices,vDist);
 
             int bestDist = INT_MAX;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
+            for(size_t iC=0, iendC=vIndices.size(); iC<iendC; iC++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iC];
                 const int &kpLevel = pKF->mvKeysUn[idx].octave;
 
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-                int dist = DescriptorDistance(dMP,dKF);
+                int dist = vDist[iC];
 
                 if(dist<bestDist)
                 {
@@ -1721,6 +1972,8 @@ namespace ORB_SLAM3
         const bool bForward = tlc(2)>CurrentFrame.mb && !bMono;
         const bool bBackward = -tlc(2)>CurrentFrame.mb && !bMono;
 
+        vector<int> vDist;
+
         for(int i=0; i<LastFrame.N; i++)
         {
             MapPoint* pMP = LastFrame.mvpMapPoints[i];
@@ -1767,13 +2020,14 @@ namespace ORB_SLAM3
                         continue;
                     // 后面是常规匹配，不打注释了
                     const cv::Mat dMP = pMP->GetDescriptor();
+                    DescriptorDistances(dMP,CurrentFrame.mDescriptors,vIndices2,vDist);
 
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
-                    for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                    for(size_t iC=0, iendC=vIndices2.size(); iC<iendC; iC++)
                     {
-                        const size_t i2 = *vit;
+                        const size_t i2 = vIndices2[iC];
 
                         if(CurrentFrame.mvpMapPoints[i2])
                             if(CurrentFrame.mvpMapPoints[i2]->Observations()>0)
@@ -1787,9 +2041,7 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                        const int dist = DescriptorDistance(dMP,d);
+                        const int dist = vDist[iC];
 
                         if(dist<bestDist)
                         {
@@ -1842,20 +2094,19 @@ namespace ORB_SLAM3
                             vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0),uv(1), radius, nLastOctave-1, nLastOctave+1, true);
 
                         const cv::Mat dMP = pMP->GetDescriptor();
+                        DescriptorDistances(dMP,CurrentFrame.mDescriptors,vIndices2,vDist,CurrentFrame.Nleft);
 
                         int bestDist = 256;
                         int bestIdx2 = -1;
 
-                        for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                        for(size_t iC=0, iendC=vIndices2.size(); iC<iendC; iC++)
                         {
-                            const size_t i2 = *vit;
+                            const size_t i2 = vIndices2[iC];
                             if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft])
                                 if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft]->Observations()>0)
                                     continue;
 
-                            const cv::Mat &d = CurrentFrame.mDescriptors.row(i2 + CurrentFrame.Nleft);
-
-                            const int dist = DescriptorDistance(dMP,d);
+                            const int dist = vDist[iC];
 
                             if(dist<bestDist)
                             {
@@ -1932,6 +2183,8 @@ namespace ORB_SLAM3
 
         const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
 
+        vector<int> vDist;
+
         for(size_t i=0, iend=vpMPs.size(); i<iend; i++)
         {
             MapPoint* pMP = vpMPs[i];
@@ -1974,19 +2227,18 @@ namespace ORB_SLAM3
                         continue;
 
                     const cv::Mat dMP = pMP->GetDescriptor();
+                    DescriptorDistances(dMP,CurrentFrame.mDescriptors,vIndices2,vDist);
 
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
-                    for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+                    for(size_t iC=0, iendC=vIndices2.size(); iC<iendC; iC++)
                     {
-                        const size_t i2 = *vit;
+                        const size_t i2 = vIndices2[iC];
                         if(CurrentFrame.mvpMapPoints[i2])
                             continue;
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                        const int dist = DescriptorDistance(dMP,d);
+                        const int dist = vDist[iC];
 
                         if(dist<bestDist)
                         {
@@ -2085,24 +2337,45 @@ namespace ORB_SLAM3
     }
 
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
     int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
     {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
+        const uint8_t* pb = b.ptr<uint8_t>();
+        int dist;
+        GetHammingKernel()(a.ptr<uint8_t>(),&pb,1,&dist);
+        return dist;
+    }
 
-        int dist=0;
+    void ORBmatcher::DescriptorDistances(const cv::Mat &a, const cv::Mat &B, const vector<size_t> &vIndices, vector<int> &vDist, const size_t offset)
+    {
+        DescriptorDistancesToRows(a,B,vIndices,vDist,offset);
+    }
 
-        for(int i=0; i<8; i++, pa++, pb++)
+    void ORBmatcher::DescriptorDistances(const cv::Mat &a, const cv::Mat &B, const vector<unsigned int> &vIndices, vector<int> &vDist)
+    {
+        DescriptorDistancesToRows(a,B,vIndices,vDist,0);
+    }
+
+    void ORBmatcher::DescriptorDistances(const cv::Mat &A, const cv::Mat &B, cv::Mat &D)
+    {
+        D.create(A.rows,B.rows,CV_32S);
+
+        const HammingKernel kernel = GetHammingKernel();
+        const uint8_t* ppb[HAMMING_BLOCK];
+
+        for(int j0=0; j0<B.rows; j0+=HAMMING_BLOCK)
         {
-            unsigned  int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+            const int nb = min(HAMMING_BLOCK,B.rows-j0);
+            for(int j=0; j<nb; j++)
+                ppb[j] = B.ptr<uint8_t>(j0+j);
+
+            for(int i=0; i<A.rows; i++)
+                kernel(A.ptr<uint8_t>(i),ppb,nb,D.ptr<int>(i)+j0);
         }
+    }
 
-        return dist;
+    void ORBmatcher::DescriptorDistances(const uint8_t* pa, const uint8_t* const* ppb, const int n, int* pDist)
+    {
+        GetHammingKernel()(pa,ppb,n,pDist);
     }
 
 } //namespace ORB_SLAM
@@ -0,0 +1,107 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObjectPool.h"
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+ObjectPool::ObjectPool(const string &name, const size_t nObjectSize, const size_t nSlotsPerSlab):
+    mName(name), mnSlotSize(((max(nObjectSize,sizeof(void*))+mnAlignment-1)/mnAlignment)*mnAlignment),
+    mnSlotsPerSlab(max(nSlotsPerSlab,(size_t)1)), mpFreeList(NULL), mnFree(0), mnAllocated(0), mnReleased(0)
+{
+}
+
+ObjectPool::~ObjectPool()
+{
+    for(size_t i=0; i<mvpSlabs.size(); i++)
+        free(mvpSlabs[i]);
+}
+
+void* ObjectPool::Allocate(const size_t nSize)
+{
+    // Derived classes would not fit in the slots
+    assert(nSize<=mnSlotSize);
+    if(nSize>mnSlotSize)
+        throw bad_alloc();
+
+    unique_lock<mutex> lock(mMutex);
+    if(!mpFreeList)
+        AddSlab();
+
+    void* p = mpFreeList;
+    mpFreeList = *static_cast<void**>(p);
+    mnFree--;
+    mnAllocated++;
+    return p;
+}
+
+void ObjectPool::Deallocate(void* p)
+{
+    if(!p)
+        return;
+
+    unique_lock<mutex> lock(mMutex);
+    *static_cast<void**>(p) = mpFreeList;
+    mpFreeList = p;
+    mnFree++;
+    mnReleased++;
+}
+
+void ObjectPool::AddSlab()
+{
+    void* pSlab = malloc(mnSlotSize*mnSlotsPerSlab+mnAlignment);
+    if(!pSlab)
+        throw bad_alloc();
+    mvpSlabs.push_back(pSlab);
+
+    uintptr_t first = (reinterpret_cast<uintptr_t>(pSlab)+mnAlignment-1) & ~(uintptr_t)(mnAlignment-1);
+    char* pFirst = reinterpret_cast<char*>(first);
+
+    // Chain the slots in address order, so that consecutive allocations are contiguous
+    for(size_t i=mnSlotsPerSlab; i>0; i--)
+    {
+        void* pSlot = pFirst+(i-1)*mnSlotSize;
+        *static_cast<void**>(pSlot) = mpFreeList;
+        mpFreeList = pSlot;
+    }
+    mnFree += mnSlotsPerSlab;
+}
+
+ObjectPool::Stats ObjectPool::GetStats()
+{
+    unique_lock<mutex> lock(mMutex);
+    Stats stats;
+    stats.name = mName;
+    stats.nSlotSize = mnSlotSize;
+    stats.nSlabs = mvpSlabs.size();
+    stats.nFree = mnFree;
+    stats.nLive = mvpSlabs.size()*mnSlotsPerSlab-mnFree;
+    stats.nBytes = mvpSlabs.size()*(mnSlotSize*mnSlotsPerSlab+mnAlignment);
+    stats.nAllocated = mnAllocated;
+    stats.nReleased = mnReleased;
+    return stats;
+}
+
+} //namespace ORB_SLAM3
@@ -31,6 +31,7 @@
 #include "Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h"
 #include "Thirdparty/g2o/g2o/core/optimization_algorithm_gauss_newton.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_supernodal.h"
 #include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
 #include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_dense.h"
@@ -40,6 +41,7 @@
 #include<mutex>
 
 #include "OptimizableTypes.h"
+#include "ThreadPool.h"
 
 
 namespace ORB_SLAM3
@@ -49,15 +51,29 @@ bool sortByVal(const pair<MapPoint*, int> &a, const pair<MapPoint*, int> &b)
     return (a.second < b.second);
 }
 
-void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+// Linearization and Schur complement on the worker pool. Only for graphs whose edges have analytic
+// Jacobians, the numeric ones (essential graph, Sim3) modify the vertices while differentiating.
+static void SetParallelLinearization(g2o::SparseOptimizer &optimizer)
+{
+    ThreadPool* pThreadPool = ThreadPool::GetInstance();
+    if(!pThreadPool || pThreadPool->GetNumThreads()==0)
+        return;
+
+    optimizer.setParallelFor([pThreadPool](int begin, int end, const function<void(int)> &f)
+    {
+        pThreadPool->ParallelFor(begin,end,f);
+    });
+}
+
+int Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
 {
     vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
     vector<MapPoint*> vpMP = pMap->GetAllMapPoints();
-    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
+    return BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
 }
 
 
-void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
+int Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
                                  int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
 {
     vector<bool> vbNotIncludedMP;
@@ -68,13 +84,14 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+    linearSolver = new g2o::LinearSolverSupernodal<g2o::BlockSolver_6_3::PoseMatrixType>();
 
     g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
 
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelLinearization(optimizer);
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -277,7 +294,7 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
     // Optimize!
     optimizer.setVerbose(false);
     optimizer.initializeOptimization();
-    optimizer.optimize(nIterations);
+    const int nIterationsDone = optimizer.optimize(nIterations);
     Verbose::PrintMess("BA: End of the optimization", Verbose::VERBOSITY_NORMAL);
 
     // Recover optimized data
@@ -387,9 +404,12 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
             pMP->mnBAGlobalForKF = nLoopKF;
         }
     }
+
+    return nIterationsDone;
 }
 
-void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess)
+int Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess,
+                              const unsigned long nFirstFreeKFid, const Eigen::MatrixXd *pInertialPrior)
 {
     long unsigned int maxKFid = pMap->GetMaxKFid();
     const vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
@@ -399,7 +419,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+    linearSolver = new g2o::LinearSolverSupernodal<g2o::BlockSolverX::PoseMatrixType>();
 
     g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
 
@@ -407,6 +427,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     solver->setUserLambdaInit(1e-5);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelLinearization(optimizer);
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -431,6 +452,11 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
                 nNonFixed++;
             VP->setFixed(bFixed);
         }
+        else if(pKFi->mnId<nFirstFreeKFid)
+        {
+            bFixed = true;
+            VP->setFixed(true);
+        }
         optimizer.addVertex(VP);
 
         if(pKFi->bImu)
@@ -468,7 +494,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     if(bFixLocal)
     {
         if(nNonFixed<3)
-            return;
+            return 0;
     }
 
     // IMU links
@@ -486,6 +512,9 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
         {
             if(pKFi->isBad() || pKFi->mPrevKF->mnId>maxKFid)
                 continue;
+            // Summarized by the prior
+            if(pKFi->mnId<nFirstFreeKFid)
+                continue;
             if(pKFi->bImu && pKFi->mPrevKF->bImu)
             {
                 pKFi->mpImuPreintegrated->SetNewBias(pKFi->mPrevKF->GetImuBias());
@@ -587,6 +616,23 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
         double infoPriorG = priorG; //
         epg->setInformation(infoPriorG*Eigen::Matrix3d::Identity());
         optimizer.addEdge(epg);
+
+        // Biases seen by the fixed keyframes, centered on the current estimate. Gravity and scale are
+        // marginalized, the gyro-acc cross terms are dropped as the two biases are separate vertices.
+        if(pInertialPrior && pInertialPrior->rows()==9 && !pInertialPrior->isZero())
+        {
+            const Eigen::MatrixXd Hb = Marginalize(*pInertialPrior,0,2);
+
+            EdgePriorGyro* epgi = new EdgePriorGyro(static_cast<VertexGyroBias*>(VG)->estimate().cast<float>());
+            epgi->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG));
+            epgi->setInformation(Hb.block<3,3>(3,3));
+            optimizer.addEdge(epgi);
+
+            EdgePriorAcc* epai = new EdgePriorAcc(static_cast<VertexAccBias*>(VA)->estimate().cast<float>());
+            epai->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA));
+            epai->setInformation(Hb.block<3,3>(6,6));
+            optimizer.addEdge(epai);
+        }
     }
 
     const float thHuberMono = sqrt(5.991);
@@ -599,6 +645,25 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     for(size_t i=0; i<vpMPs.size(); i++)
     {
         MapPoint* pMP = vpMPs[i];
+
+        // Points seen only by fixed keyframes would be removed below, skip them before building their edges
+        if(nFirstFreeKFid>0)
+        {
+            const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+            bool bSeenByFree = false;
+            for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+                if(mit->first->mnId>=nFirstFreeKFid && mit->first->mnId<=maxKFid)
+                {
+                    bSeenByFree = true;
+                    break;
+                }
+            if(!bSeenByFree)
+            {
+                vbNotIncludedMP[i]=true;
+                continue;
+            }
+        }
+
         g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
         vPoint->setEstimate(pMP->GetWorldPos().cast<double>());
         unsigned long id = pMP->mnId+iniMPid+1;
@@ -720,11 +785,11 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
 
     if(pbStopFlag)
         if(*pbStopFlag)
-            return;
+            return 0;
 
 
     optimizer.initializeOptimization();
-    optimizer.optimize(its);
+    const int nIterationsDone = optimizer.optimize(its);
 
 
     // Recover optimized data
@@ -808,6 +873,8 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     }
 
     pMap->IncreaseChangeIndex();
+
+    return nIterationsDone;
 }
 
 
@@ -1123,7 +1190,8 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     return nInitialCorrespondences-nBad;
 }
 
-void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges)
+void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges,
+                                      g2o::SparseOptimizer* pOptimizer)
 {
     // Local KeyFrames: First Breath Search from Current Keyframe
     list<KeyFrame*> lLocalKeyFrames;
@@ -1195,23 +1263,31 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         return;
     }
 
-    // Setup optimizer
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
+    // Setup optimizer. A workspace from the caller keeps its solver from the previous call,
+    // only the graph of the previous window is dropped
+    g2o::SparseOptimizer localOptimizer;
+    g2o::SparseOptimizer& optimizer = pOptimizer ? *pOptimizer : localOptimizer;
+    optimizer.clear();
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+    g2o::OptimizationAlgorithmLevenberg* solver = static_cast<g2o::OptimizationAlgorithmLevenberg*>(optimizer.solver());
+    if(!solver)
+    {
+        g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
 
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+        linearSolver = new g2o::LinearSolverSupernodal<g2o::BlockSolver_6_3::PoseMatrixType>();
 
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    if (pMap->IsInertial())
-        solver->setUserLambdaInit(100.0);
+        g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+
+        solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+        optimizer.setAlgorithm(solver);
+    }
+    // 0 lets the algorithm compute the initial lambda
+    solver->setUserLambdaInit(pMap->IsInertial() ? 100.0 : 0.0);
 
-    optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelLinearization(optimizer);
 
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+    optimizer.setForceStopFlag(pbStopFlag);
 
     unsigned long maxKFid = 0;
 
@@ -1517,7 +1593,7 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
     g2o::BlockSolver_7_3::LinearSolverType * linearSolver =
-           new g2o::LinearSolverEigen<g2o::BlockSolver_7_3::PoseMatrixType>();
+           new g2o::LinearSolverSupernodal<g2o::BlockSolver_7_3::PoseMatrixType>();
     g2o::BlockSolver_7_3 * solver_ptr= new g2o::BlockSolver_7_3(linearSolver);
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
 
@@ -1803,7 +1879,7 @@ void Optimizer::OptimizeEssentialGraph(KeyFrame* pCurKF, vector<KeyFrame*> &vpFi
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
     g2o::BlockSolver_7_3::LinearSolverType * linearSolver =
-           new g2o::LinearSolverEigen<g2o::BlockSolver_7_3::PoseMatrixType>();
+           new g2o::LinearSolverSupernodal<g2o::BlockSolver_7_3::PoseMatrixType>();
     g2o::BlockSolver_7_3 * solver_ptr= new g2o::BlockSolver_7_3(linearSolver);
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
 
@@ -2532,6 +2608,7 @@ void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int&
         solver->setUserLambdaInit(1e0);
         optimizer.setAlgorithm(solver);
     }
+    SetParallelLinearization(optimizer);
 
 
     // Set Local temporal KeyFrame vertices
@@ -3220,16 +3297,9 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &sc
         Eigen::Vector3d Vw = VV->estimate(); // Velocity is scaled after
         pKFi->SetVelocity(Vw.cast<float>());
 
-        if ((pKFi->GetGyroBias() - bg.cast<float>()).norm() > 0.01)
-        {
-            pKFi->SetNewBias(b);
-            if (pKFi->mpImuPreintegrated)
-                pKFi->mpImuPreintegrated->Reintegrate();
-        }
-        else
-            pKFi->SetNewBias(b);
-
-
+        pKFi->SetNewBias(b);
+        if (pKFi->mpImuPreintegrated)
+            pKFi->mpImuPreintegrated->ReintegrateIfNeeded();
     }
 }
 
@@ -3385,14 +3455,9 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Vector3d &bg, Eigen::Vect
         Eigen::Vector3d Vw = VV->estimate();
         pKFi->SetVelocity(Vw.cast<float>());
 
-        if ((pKFi->GetGyroBias() - bg.cast<float>()).norm() > 0.01)
-        {
-            pKFi->SetNewBias(b);
-            if (pKFi->mpImuPreintegrated)
-                pKFi->mpImuPreintegrated->Reintegrate();
-        }
-        else
-            pKFi->SetNewBias(b);
+        pKFi->SetNewBias(b);
+        if (pKFi->mpImuPreintegrated)
+            pKFi->mpImuPreintegrated->ReintegrateIfNeeded();
     }
 }
 
@@ -3505,6 +3570,297 @@ void Optimizer::InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &sc
     Rwg = VGDir->estimate().Rwg;
 }
 
+void Optimizer::FixedLagInertialOptimization(Map *pMap, const vector<KeyFrame*> &vpKFs, Eigen::Matrix3d &Rwg, double &scale, Eigen::Vector3d &bg, Eigen::Vector3d &ba, bool bMono, Eigen::MatrixXd &infoPrior, float priorG, float priorA)
+{
+    Verbose::PrintMess("fixed-lag inertial optimization", Verbose::VERBOSITY_NORMAL);
+    int its = 200;
+    const int N = vpKFs.size();
+    const bool bPrior = infoPrior.rows()==9 && !infoPrior.isZero();
+
+    // Setup optimizer
+    g2o::SparseOptimizer optimizer;
+    g2o::BlockSolverX::LinearSolverType * linearSolver;
+
+    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+
+    g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
+
+    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+
+    if (priorG!=0.f)
+        solver->setUserLambdaInit(1e3);
+
+    optimizer.setAlgorithm(solver);
+
+    // Set KeyFrame vertices (fixed poses and optimizable velocities), indexed by position in the window
+    for(int i=0; i<N; i++)
+    {
+        KeyFrame* pKFi = vpKFs[i];
+        VertexPose * VP = new VertexPose(pKFi);
+        VP->setId(i);
+        VP->setFixed(true);
+        optimizer.addVertex(VP);
+
+        VertexVelocity* VV = new VertexVelocity(pKFi);
+        VV->setId(N+i);
+        VV->setFixed(i==0 && bPrior);
+        optimizer.addVertex(VV);
+    }
+
+    // Biases
+    VertexGyroBias* VG = new VertexGyroBias(vpKFs.front());
+    VG->setId(2*N);
+    VG->setFixed(false);
+    optimizer.addVertex(VG);
+    VertexAccBias* VA = new VertexAccBias(vpKFs.front());
+    VA->setId(2*N+1);
+    VA->setFixed(false);
+    optimizer.addVertex(VA);
+
+    // prior acc bias
+    Eigen::Vector3f bprior;
+    bprior.setZero();
+
+    EdgePriorAcc* epa = new EdgePriorAcc(bprior);
+    epa->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA));
+    double infoPriorA = priorA;
+    epa->setInformation(infoPriorA*Eigen::Matrix3d::Identity());
+    optimizer.addEdge(epa);
+    EdgePriorGyro* epg = new EdgePriorGyro(bprior);
+    epg->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG));
+    double infoPriorG = priorG;
+    epg->setInformation(infoPriorG*Eigen::Matrix3d::Identity());
+    optimizer.addEdge(epg);
+
+    // Gravity and scale
+    VertexGDir* VGDir = new VertexGDir(Rwg);
+    VGDir->setId(2*N+2);
+    VGDir->setFixed(false);
+    optimizer.addVertex(VGDir);
+    VertexScale* VS = new VertexScale(scale);
+    VS->setId(2*N+3);
+    VS->setFixed(!bMono); // Fixed for stereo case
+    optimizer.addVertex(VS);
+
+    // Prior from the keyframes before the window
+    EdgePriorInertialGS* epi = NULL;
+    if(bPrior)
+    {
+        epi = new EdgePriorInertialGS(Rwg, scale, bg, ba, infoPrior);
+        epi->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VGDir));
+        epi->setVertex(1,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VS));
+        epi->setVertex(2,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG));
+        epi->setVertex(3,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA));
+        optimizer.addEdge(epi);
+    }
+
+    // IMU links with gravity and scale, vpei[i] links keyframes i-1 and i
+    vector<EdgeInertialGS*> vpei(N,static_cast<EdgeInertialGS*>(NULL));
+    for(int i=1; i<N; i++)
+    {
+        KeyFrame* pKFi = vpKFs[i];
+        if(pKFi->isBad() || pKFi->mPrevKF!=vpKFs[i-1])
+            continue;
+        if(!pKFi->mpImuPreintegrated)
+        {
+            std::cout << "Not preintegrated measurement" << std::endl;
+            continue;
+        }
+
+        pKFi->mpImuPreintegrated->SetNewBias(pKFi->mPrevKF->GetImuBias());
+        EdgeInertialGS* ei = new EdgeInertialGS(pKFi->mpImuPreintegrated);
+        ei->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(i-1)));
+        ei->setVertex(1,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(N+i-1)));
+        ei->setVertex(2,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG));
+        ei->setVertex(3,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA));
+        ei->setVertex(4,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(i)));
+        ei->setVertex(5,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(N+i)));
+        ei->setVertex(6,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VGDir));
+        ei->setVertex(7,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VS));
+
+        vpei[i] = ei;
+        optimizer.addEdge(ei);
+    }
+
+    optimizer.setVerbose(false);
+    optimizer.initializeOptimization();
+    optimizer.optimize(its);
+
+    // New prior: marginalize the velocities along the chain, one keyframe at a time. The running information
+    // is on (gravity direction, scale, gyro bias, acc bias, velocity of the last keyframe). The bias priors
+    // are left out, every call sets its own.
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(12,12);
+    if(epi)
+        H.block<9,9>(0,0) = epi->GetHessian();
+
+    // Blocks of EdgeInertialGS::GetHessian: gravity direction, scale, gyro bias, acc bias, velocity 1, velocity 2
+    const int src[6] = {24, 26, 9, 12, 6, 21};
+    const int dst[6] = {0, 2, 3, 6, 9, 12};
+    const int dim[6] = {2, 1, 3, 3, 3, 3};
+    for(int i=1; i<N; i++)
+    {
+        Eigen::MatrixXd Hi = Eigen::MatrixXd::Zero(15,15);
+        Hi.block(0,0,12,12) = H;
+        if(vpei[i])
+        {
+            const Eigen::Matrix<double,27,27> He = vpei[i]->GetHessian();
+            // A fixed velocity is not a variable
+            const bool bFixedV1 = (i==1 && bPrior);
+            for(int a=0; a<6; a++)
+                for(int b=0; b<6; b++)
+                {
+                    if(bFixedV1 && (a==4 || b==4))
+                        continue;
+                    Hi.block(dst[a],dst[b],dim[a],dim[b]) += He.block(src[a],src[b],dim[a],dim[b]);
+                }
+        }
+
+        Hi = Marginalize(Hi,9,11);
+        H.block(0,0,9,9) = Hi.block(0,0,9,9);
+        H.block(0,9,9,3) = Hi.block(0,12,9,3);
+        H.block(9,0,3,9) = Hi.block(12,0,3,9);
+        H.block(9,9,3,3) = Hi.block(12,12,3,3);
+    }
+    if(N>1)
+        infoPrior = Marginalize(H,9,11).block(0,0,9,9);
+
+    // Recover optimized data
+    // Biases
+    Vector6d vb;
+    vb << VG->estimate(), VA->estimate();
+    bg << VG->estimate();
+    ba << VA->estimate();
+    scale = VS->estimate();
+
+    IMU::Bias b (vb[3],vb[4],vb[5],vb[0],vb[1],vb[2]);
+    Rwg = VGDir->estimate().Rwg;
+
+    // Keyframe velocities in the window
+    for(int i=0; i<N; i++)
+    {
+        VertexVelocity* VV = static_cast<VertexVelocity*>(optimizer.vertex(N+i));
+        if(!VV->fixed())
+            vpKFs[i]->SetVelocity(VV->estimate().cast<float>());
+    }
+
+    // Biases are shared by the whole map
+    long unsigned int maxKFid = pMap->GetMaxKFid();
+    const vector<KeyFrame*> vpMapKFs = pMap->GetAllKeyFrames();
+    for(size_t i=0; i<vpMapKFs.size(); i++)
+    {
+        KeyFrame* pKFi = vpMapKFs[i];
+        if(pKFi->mnId>maxKFid)
+            continue;
+
+        pKFi->SetNewBias(b);
+        if (pKFi->mpImuPreintegrated)
+            pKFi->mpImuPreintegrated->ReintegrateIfNeeded();
+    }
+}
+
+void Optimizer::FixedLagInertialOptimization(const vector<KeyFrame*> &vpKFs, Eigen::Matrix3d &Rwg, double &scale, Eigen::MatrixXd &infoPrior)
+{
+    int its = 10;
+    const int N = vpKFs.size();
+
+    // Setup optimizer
+    g2o::SparseOptimizer optimizer;
+    g2o::BlockSolverX::LinearSolverType * linearSolver;
+
+    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+
+    g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
+
+    g2o::OptimizationAlgorithmGaussNewton* solver = new g2o::OptimizationAlgorithmGaussNewton(solver_ptr);
+    optimizer.setAlgorithm(solver);
+
+    // Set KeyFrame vertices (all variables are fixed)
+    for(int i=0; i<N; i++)
+    {
+        KeyFrame* pKFi = vpKFs[i];
+        VertexPose * VP = new VertexPose(pKFi);
+        VP->setId(i);
+        VP->setFixed(true);
+        optimizer.addVertex(VP);
+
+        VertexVelocity* VV = new VertexVelocity(pKFi);
+        VV->setId(N+i);
+        VV->setFixed(true);
+        optimizer.addVertex(VV);
+
+        VertexGyroBias* VG = new VertexGyroBias(pKFi);
+        VG->setId(2*N+i);
+        VG->setFixed(true);
+        optimizer.addVertex(VG);
+        VertexAccBias* VA = new VertexAccBias(pKFi);
+        VA->setId(3*N+i);
+        VA->setFixed(true);
+        optimizer.addVertex(VA);
+    }
+
+    // Gravity and scale
+    VertexGDir* VGDir = new VertexGDir(Rwg);
+    VGDir->setId(4*N);
+    VGDir->setFixed(false);
+    optimizer.addVertex(VGDir);
+    VertexScale* VS = new VertexScale(scale);
+    VS->setId(4*N+1);
+    VS->setFixed(false);
+    optimizer.addVertex(VS);
+
+    // Prior from the keyframes before the window, biases are fixed at the current values
+    if(infoPrior.rows()==9 && !infoPrior.isZero())
+    {
+        VertexGyroBias* VG = static_cast<VertexGyroBias*>(optimizer.vertex(3*N-1));
+        VertexAccBias* VA = static_cast<VertexAccBias*>(optimizer.vertex(4*N-1));
+        EdgePriorInertialGS* epi = new EdgePriorInertialGS(Rwg, scale, VG->estimate(), VA->estimate(), infoPrior);
+        epi->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VGDir));
+        epi->setVertex(1,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VS));
+        epi->setVertex(2,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG));
+        epi->setVertex(3,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA));
+        optimizer.addEdge(epi);
+    }
+
+    // Graph edges
+    vector<EdgeInertialGS*> vpei;
+    vpei.reserve(N);
+    for(int i=1; i<N; i++)
+    {
+        KeyFrame* pKFi = vpKFs[i];
+        if(pKFi->isBad() || pKFi->mPrevKF!=vpKFs[i-1] || !pKFi->mpImuPreintegrated)
+            continue;
+
+        EdgeInertialGS* ei = new EdgeInertialGS(pKFi->mpImuPreintegrated);
+        ei->setVertex(0,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(i-1)));
+        ei->setVertex(1,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(N+i-1)));
+        ei->setVertex(2,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(2*N+i-1)));
+        ei->setVertex(3,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(3*N+i-1)));
+        ei->setVertex(4,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(i)));
+        ei->setVertex(5,dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(N+i)));
+        ei->setVertex(6,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VGDir));
+        ei->setVertex(7,dynamic_cast<g2o::OptimizableGraph::Vertex*>(VS));
+        g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+        ei->setRobustKernel(rk);
+        rk->setDelta(1.f);
+        vpei.push_back(ei);
+        optimizer.addEdge(ei);
+    }
+
+    optimizer.setVerbose(false);
+    optimizer.initializeOptimization();
+    optimizer.optimize(its);
+
+    // Velocities and biases are fixed, the new information on gravity direction and scale just adds up
+    if(infoPrior.rows()!=9)
+        infoPrior = Eigen::MatrixXd::Zero(9,9);
+    for(size_t i=0; i<vpei.size(); i++)
+        infoPrior.block(0,0,3,3) += vpei[i]->GetHessian().block<3,3>(24,24);
+
+    // Recover optimized data
+    scale = VS->estimate();
+    Rwg = VGDir->estimate().Rwg;
+}
+
 void Optimizer::LocalBundleAdjustment(KeyFrame* pMainKF,vector<KeyFrame*> vpAdjustKF, vector<KeyFrame*> vpFixedKF, bool *pbStopFlag)
 {
     bool bShowImages = false;
@@ -5310,7 +5666,7 @@ void Optimizer::OptimizeEssentialGraph4DoF(Map* pMap, KeyFrame* pLoopKF, KeyFram
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
     g2o::BlockSolverX::LinearSolverType * linearSolver =
-            new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+            new g2o::LinearSolverSupernodal<g2o::BlockSolverX::PoseMatrixType>();
     g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
 
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
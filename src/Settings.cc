@@ -125,7 +125,8 @@ namespace ORB_SLAM3 {
     }
 
     Settings::Settings(const std::string &configFile, const int& sensor) :
-    bNeedToUndistort_(false), bNeedToRectify_(false), bNeedToResize1_(false), bNeedToResize2_(false) {
+    bNeedToUndistort_(false), bNeedToRectify_(false), bNeedToResize1_(false), bNeedToResize2_(false),
+    imuWaitTimeout_(0.f), imuReintegrationTh_(0.01f), fixedLagImuInit_(false) {
         sensor_ = sensor;
 
         //Open settings file
@@ -409,6 +410,11 @@ namespace ORB_SLAM3 {
 
         fps_ = readParameter<int>(fSettings,"Camera.fps",found);
         bRGB_ = (bool) readParameter<int>(fSettings,"Camera.RGB",found);
+
+        // Grid step in pixels of the precomputed undistortion maps of the cameras, 0 disables them
+        undistortionLUTStep_ = readParameter<float>(fSettings,"Camera.undistortionLUTStep",found,false);
+        if(!found)
+            undistortionLUTStep_ = 0.f;
     }
 
     void Settings::readIMU(cv::FileStorage &fSettings) {
@@ -429,6 +435,22 @@ namespace ORB_SLAM3 {
         else{
             insertKFsWhenLost_ = true;
         }
+
+        // Only useful when the IMU is fed from its own thread
+        imuWaitTimeout_ = readParameter<float>(fSettings,"IMU.WaitTimeout",found,false);
+        if(!found){
+            imuWaitTimeout_ = 0.f;
+        }
+
+        imuReintegrationTh_ = readParameter<float>(fSettings,"IMU.ReintegrationThreshold",found,false);
+        if(!found){
+            imuReintegrationTh_ = 0.01f;
+        }
+
+        fixedLagImuInit_ = (bool) readParameter<int>(fSettings,"IMU.FixedLagInit",found,false);
+        if(!found){
+            fixedLagImuInit_ = false;
+        }
     }
 
     void Settings::readRGBD(cv::FileStorage& fSettings) {
@@ -448,6 +470,10 @@ namespace ORB_SLAM3 {
         nLevels_ = readParameter<int>(fSettings,"ORBextractor.nLevels",found);
         initThFAST_ = readParameter<int>(fSettings,"ORBextractor.iniThFAST",found);
         minThFAST_ = readParameter<int>(fSettings,"ORBextractor.minThFAST",found);
+
+        bParallelExtraction_ = (bool) readParameter<int>(fSettings,"ORBextractor.parallel",found,false);
+        if(!found)
+            bParallelExtraction_ = false;
     }
 
     void Settings::readViewer(cv::FileStorage &fSettings) {
@@ -480,6 +506,15 @@ namespace ORB_SLAM3 {
         bool found;
 
         thFarPoints_ = readParameter<float>(fSettings,"System.thFarPoints",found,false);
+
+        // Worker threads of the shared task pool, 0 selects one per core (minus the tracking thread)
+        nThreads_ = readParameter<int>(fSettings,"System.nThreads",found,false);
+        if(!found)
+            nThreads_ = 0;
+
+        // Delete culled map points once no thread can reach them (off by default)
+        int reclaimMemory = readParameter<int>(fSettings,"System.ReclaimMemory",found,false);
+        bReclaimMemory_ = found && reclaimMemory != 0;
     }
 
     void Settings::precomputeRectificationMaps() {
@@ -575,6 +610,8 @@ namespace ORB_SLAM3 {
 
         output << "\t-Original image size: [ " << settings.originalImSize_.width << " , " << settings.originalImSize_.height << " ]" << endl;
         output << "\t-Current image size: [ " << settings.newImSize_.width << " , " << settings.newImSize_.height << " ]" << endl;
+        if(settings.undistortionLUTStep_ > 0)
+            output << "\t-Undistortion LUT step: " << settings.undistortionLUTStep_ << " px" << endl;
 
         if(settings.bNeedToRectify_){
             output << "\t-Camera 1 parameters after rectification: [ ";
@@ -621,6 +658,9 @@ namespace ORB_SLAM3 {
             output << "\t-Gyro walk: " << settings.gyroWalk_ << endl;
             output << "\t-Accelerometer walk: " << settings.accWalk_ << endl;
             output << "\t-IMU frequency: " << settings.imuFrequency_ << endl;
+            output << "\t-IMU wait timeout: " << settings.imuWaitTimeout_ << endl;
+            output << "\t-IMU reintegration threshold: " << settings.imuReintegrationTh_ << endl;
+            output << "\t-Fixed-lag IMU initialization: " << (int)settings.fixedLagImuInit_ << endl;
         }
 
         if(settings.sensor_ == System::RGBD || settings.sensor_ == System::IMU_RGBD){
@@ -632,6 +672,9 @@ namespace ORB_SLAM3 {
         output << "\t-ORB number of scales: " << settings.nLevels_ << endl;
         output << "\t-Initial FAST threshold: " << settings.initThFAST_ << endl;
         output << "\t-Min FAST threshold: " << settings.minThFAST_ << endl;
+        output << "\t-Parallel extraction: " << settings.bParallelExtraction_ << endl;
+        output << "\t-Worker threads: " << settings.nThreads_ << endl;
+        output << "\t-Reclaim memory: " << settings.bReclaimMemory_ << endl;
 
         return output;
     }
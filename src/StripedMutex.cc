@@ -0,0 +1,36 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StripedMutex.h"
+
+namespace ORB_SLAM3
+{
+
+std::atomic<unsigned long> StripedMutex::mnContended(0);
+
+unsigned long StripedMutex::GetContentionCount()
+{
+    return mnContended.load(std::memory_order_relaxed);
+}
+
+void StripedMutex::ResetContentionCount()
+{
+    mnContended.store(0,std::memory_order_relaxed);
+}
+
+} //namespace ORB_SLAM
@@ -38,6 +38,15 @@ namespace ORB_SLAM3
 
 Verbose::eLevel Verbose::th = Verbose::VERBOSITY_NORMAL;
 
+// Vocabularies ending in .bin are memory-mapped (see Examples/Vocabulary/bin_vocabulary), any other is parsed as text
+static bool LoadVocabulary(ORBVocabulary* pVocabulary, const string &strVocFile)
+{
+    const string strBinExt = ".bin";
+    if(strVocFile.size()>=strBinExt.size() && strVocFile.compare(strVocFile.size()-strBinExt.size(),strBinExt.size(),strBinExt)==0)
+        return pVocabulary->loadFromBinaryFile(strVocFile);
+    return pVocabulary->loadFromTextFile(strVocFile);
+}
+
 System::System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor,
                const bool bUseViewer, const int initFr, const string &strSequence):
     mSensor(sensor), mpViewer(static_cast<Viewer*>(NULL)), mbReset(false), mbResetActiveMap(false),
@@ -107,6 +116,42 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
 
     mStrVocabularyFilePath = strVocFile;
 
+    //Create the shared worker pool
+    int nThreads = 0;
+    if(settings_)
+        nThreads = settings_->nThreads();
+    else
+    {
+        node = fsSettings["System.nThreads"];
+        if(!node.empty() && node.isInt())
+            nThreads = node.operator int();
+    }
+    if(nThreads<=0)
+        nThreads = max(1,(int)thread::hardware_concurrency()-1);
+
+    mpThreadPool = new ThreadPool(nThreads);
+    ThreadPool::SetInstance(mpThreadPool);
+    cout << "Worker pool with " << nThreads << " threads" << endl;
+
+    //Create the reclaimer of culled points before any thread registers with it
+    bool bReclaimMemory = false;
+    if(settings_)
+        bReclaimMemory = settings_->reclaimMemory();
+    else
+    {
+        node = fsSettings["System.ReclaimMemory"];
+        if(!node.empty() && node.isInt())
+            bReclaimMemory = node.operator int() != 0;
+    }
+
+    mpReclaimer = static_cast<EpochReclaimer*>(NULL);
+    if(bReclaimMemory)
+    {
+        mpReclaimer = new EpochReclaimer();
+        EpochReclaimer::SetInstance(mpReclaimer);
+        cout << "Culled map points will be deleted" << endl;
+    }
+
     bool loadedAtlas = false;
 
     if(mStrLoadAtlasFromFile.empty())
@@ -115,7 +160,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
         cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
 
         mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(mpVocabulary,strVocFile);
         if(!bVocLoad)
         {
             cerr << "Wrong path to vocabulary. " << endl;
@@ -137,7 +182,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
         cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
 
         mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(mpVocabulary,strVocFile);
         if(!bVocLoad)
         {
             cerr << "Wrong path to vocabulary. " << endl;
@@ -208,6 +253,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     else
         mpLocalMapper->mbFarPoints = false;
 
+    if(settings_)
+        mpLocalMapper->mbFixedLagInertialInit = settings_->fixedLagImuInit();
+    else if(!fsSettings["IMU.FixedLagInit"].empty())
+        mpLocalMapper->mbFixedLagInertialInit = (int)fsSettings["IMU.FixedLagInit"];
+
     //Initialize the Loop Closing thread and launch
     // mSensor!=MONOCULAR && mSensor!=IMU_MONOCULAR
     mpLoopCloser = new LoopClosing(mpAtlas, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, activeLC); // mSensor!=MONOCULAR);
@@ -276,10 +326,7 @@ Sophus::SE3f System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight,
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -351,10 +398,7 @@ Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -426,10 +470,7 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -0,0 +1,171 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+    // Shared by the caller and the helper tasks of one ParallelFor call. Helpers that start
+    // after all iterations were claimed return without touching the loop body.
+    struct LoopState
+    {
+        atomic<int> next;
+        atomic<int> pending;
+        int end;
+        const function<void(int)>* pF;
+
+        mutex mMutex;
+        condition_variable mcvDone;
+
+        void Work()
+        {
+            int i;
+            while((i = next.fetch_add(1)) < end)
+            {
+                (*pF)(i);
+                if(pending.fetch_sub(1)==1)
+                {
+                    unique_lock<mutex> lock(mMutex);
+                    mcvDone.notify_all();
+                }
+            }
+        }
+    };
+}
+
+ThreadPool* ThreadPool::mpInstance = static_cast<ThreadPool*>(NULL);
+
+ThreadPool::ThreadPool(const int nThreads): mbFinish(false)
+{
+    mvWorkers.reserve(nThreads);
+    for(int i=0; i<nThreads; i++)
+        mvWorkers.push_back(thread(&ThreadPool::Run,this,nThreads>1 && i==0));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        mbFinish = true;
+    }
+    mcvQueue.notify_all();
+    mcvPriority.notify_all();
+
+    for(size_t i=0; i<mvWorkers.size(); i++)
+        mvWorkers[i].join();
+}
+
+void ThreadPool::Run(const bool bReserved)
+{
+    while(1)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mMutexQueue);
+            if(bReserved)
+                mcvPriority.wait(lock, [this]{ return mbFinish || !mqPriorityTasks.empty(); });
+            else
+                mcvQueue.wait(lock, [this]{ return mbFinish || !mqPriorityTasks.empty() || !mqTasks.empty(); });
+
+            if(!mqPriorityTasks.empty())
+            {
+                task = std::move(mqPriorityTasks.front());
+                mqPriorityTasks.pop_front();
+            }
+            else if(!bReserved && !mqTasks.empty())
+            {
+                task = std::move(mqTasks.front());
+                mqTasks.pop_front();
+            }
+            else
+                return;
+        }
+        task();
+    }
+}
+
+future<void> ThreadPool::Submit(const function<void()> &task)
+{
+    shared_ptr<packaged_task<void()> > pTask = make_shared<packaged_task<void()> >(task);
+    future<void> result = pTask->get_future();
+
+    if(mvWorkers.empty())
+    {
+        (*pTask)();
+        return result;
+    }
+
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        mqPriorityTasks.push_back([pTask]{ (*pTask)(); });
+    }
+    mcvPriority.notify_one();
+    mcvQueue.notify_one();
+
+    return result;
+}
+
+void ThreadPool::ParallelFor(const int begin, const int end, const function<void(int)> &f, const bool bHighPriority)
+{
+    const int n = end-begin;
+    if(n<=0)
+        return;
+
+    if(n==1 || mvWorkers.empty())
+    {
+        for(int i=begin; i<end; i++)
+            f(i);
+        return;
+    }
+
+    shared_ptr<LoopState> pState = make_shared<LoopState>();
+    pState->next = begin;
+    pState->pending = n;
+    pState->end = end;
+    pState->pF = &f;
+
+    const int nHelpers = min(n-1,(int)mvWorkers.size());
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        deque<function<void()> > &qTasks = bHighPriority ? mqPriorityTasks : mqTasks;
+        for(int i=0; i<nHelpers; i++)
+            qTasks.push_back([pState]{ pState->Work(); });
+    }
+    if(nHelpers==1)
+        mcvQueue.notify_one();
+    else
+        mcvQueue.notify_all();
+    if(bHighPriority)
+        mcvPriority.notify_one();
+
+    pState->Work();
+
+    unique_lock<mutex> lock(pState->mMutex);
+    pState->mcvDone.wait(lock, [&pState]{ return pState->pending.load()==0; });
+}
+
+} //namespace ORB_SLAM3
@@ -46,7 +46,8 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     mbOnlyTracking(false), mbMapUpdated(false), mbVO(false), mpORBVocabulary(pVoc), mpKeyFrameDB(pKFDB),
     mbReadyToInitializate(false), mpSystem(pSys), mpViewer(NULL), bStepByStep(false),
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpAtlas(pAtlas), mnLastRelocFrameId(0), time_recently_lost(5.0),
-    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL))
+    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL)),
+    mpORBextractorRight(static_cast<ORBextractor*>(NULL)), mpIniORBextractor(static_cast<ORBextractor*>(NULL)), mImuWaitTimeout(0.0)
 {
     // Load camera parameters from settings file
     if(settings){
@@ -98,6 +99,11 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     mbInitWith3KFs = false;
     mnNumDataset = 0;
 
+    mpReclaimer = EpochReclaimer::GetInstance();
+    mnReclaimerId = -1;
+    if(mpReclaimer)
+        mnReclaimerId = mpReclaimer->Register("Tracking");
+
     vector<GeometricCamera*> vpCams = mpAtlas->GetAllCameras();
     std::cout << "There are " << vpCams.size() << " cameras in the atlas" << std::endl;
     for(GeometricCamera* pCam : vpCams)
@@ -422,6 +428,29 @@ void Tracking::PrintTimeStats()
 
     f << "KFs in map: " << pBestMap->GetAllKeyFrames().size() << std::endl;
     f << "MPs in map: " << pBestMap->GetAllMapPoints().size() << std::endl;
+    f << "Contended MP locks: " << StripedMutex::GetContentionCount() << std::endl;
+    std::cout << "Contended MP locks: " << StripedMutex::GetContentionCount() << std::endl;
+
+    ObjectPool::Stats vPoolStats[2] = {MapPoint::mPool.GetStats(), KeyFrame::mPool.GetStats()};
+    for(int i=0; i<2; i++)
+    {
+        f << vPoolStats[i].name << " pool: " << vPoolStats[i].nLive << " live, " << vPoolStats[i].nFree << " free, "
+          << vPoolStats[i].nBytes/(1024*1024) << " MB in " << vPoolStats[i].nSlabs << " slabs" << std::endl;
+        std::cout << vPoolStats[i].name << " pool: " << vPoolStats[i].nLive << " live, " << vPoolStats[i].nFree << " free, "
+                  << vPoolStats[i].nBytes/(1024*1024) << " MB in " << vPoolStats[i].nSlabs << " slabs" << std::endl;
+    }
+    if(mpReclaimer)
+    {
+        f << "Reclaimed MPs: " << mpReclaimer->GetNumReclaimed() << ", waiting: " << mpReclaimer->GetNumRetired() << std::endl;
+        std::cout << "Reclaimed MPs: " << mpReclaimer->GetNumReclaimed() << ", waiting: " << mpReclaimer->GetNumRetired() << std::endl;
+    }
+    if(mSensor==System::IMU_MONOCULAR || mSensor==System::IMU_STEREO || mSensor==System::IMU_RGBD)
+    {
+        f << "IMU bias updates: " << IMU::Preintegrated::GetNumReintegrations() << " reintegrated, "
+          << IMU::Preintegrated::GetNumFirstOrderUpdates() << " first order" << std::endl;
+        std::cout << "IMU bias updates: " << IMU::Preintegrated::GetNumReintegrations() << " reintegrated, "
+                  << IMU::Preintegrated::GetNumFirstOrderUpdates() << " first order" << std::endl;
+    }
 
     f << "---------------------------" << std::endl;
     f << std::endl << "Place Recognition (mean$\\pm$std)" << std::endl;
@@ -511,6 +540,10 @@ void Tracking::PrintTimeStats()
     std::cout << "Num exec: " << mpLoopClosing->nFGBA_exec << std::endl;
     f << "Numb abort: " << mpLoopClosing->nFGBA_abort << std::endl;
     std::cout << "Num abort: " << mpLoopClosing->nFGBA_abort << std::endl;
+    f << "Numb applied finished: " << mpLoopClosing->nFGBA_applied << std::endl;
+    std::cout << "Num applied finished: " << mpLoopClosing->nFGBA_applied << std::endl;
+    f << "Numb applied aborted: " << mpLoopClosing->nFGBA_appliedAborted << std::endl;
+    std::cout << "Num applied aborted: " << mpLoopClosing->nFGBA_appliedAborted << std::endl;
     average = calcAverage(mpLoopClosing->vnGBAKFs);
     deviation = calcDeviation(mpLoopClosing->vnGBAKFs, average);
     f << "Number of KFs: " << average << "$\\pm$" << deviation << std::endl;
@@ -568,6 +601,21 @@ void Tracking::newParameterLoader(Settings *settings) {
         mpFrameDrawer->both = true;
     }
 
+    // Precomputed undistortion maps, built once for the fixed calibration
+    const float fLUTStep = settings->undistortionLUTStep();
+    if(fLUTStep > 0){
+        const cv::Size imSize = settings->newImSize();
+        if(mpCamera->GetType() == GeometricCamera::CAM_PINHOLE){
+            if(settings->needToUndistort())
+                static_cast<Pinhole*>(mpCamera)->SetUndistortionLUT(mDistCoef,imSize.width,imSize.height,fLUTStep);
+        }
+        else{
+            static_cast<KannalaBrandt8*>(mpCamera)->SetUnprojectionLUT(imSize.width,imSize.height,fLUTStep);
+            if(mpCamera2)
+                static_cast<KannalaBrandt8*>(mpCamera2)->SetUnprojectionLUT(imSize.width,imSize.height,fLUTStep);
+        }
+    }
+
     if(mSensor==System::STEREO || mSensor==System::RGBD || mSensor==System::IMU_STEREO || mSensor==System::IMU_RGBD ){
         mbf = settings->bf();
         mThDepth = settings->b() * settings->thDepth();
@@ -600,11 +648,16 @@ void Tracking::newParameterLoader(Settings *settings) {
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    if(settings->parallelExtraction())
+        EnableParallelExtraction();
+
     //IMU parameters
     Sophus::SE3f Tbc = settings->Tbc();
     mInsertKFsLost = settings->insertKFsWhenLost();
     mImuFreq = settings->imuFrequency();
     mImuPer = 0.001; //1.0 / (double) mImuFreq;     //TODO: ESTO ESTA BIEN?
+    mImuWaitTimeout = settings->imuWaitTimeout();
+    IMU::Preintegrated::SetReintegrationThreshold(settings->imuReintegrationThreshold());
     float Ng = settings->noiseGyro();
     float Na = settings->noiseAcc();
     float Ngw = settings->gyroWalk();
@@ -1288,6 +1341,11 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    // Optional: run the extraction passes on a worker pool
+    node = fSettings["ORBextractor.parallel"];
+    if(!node.empty() && node.isInt() && node.operator int())
+        EnableParallelExtraction();
+
     cout << endl << "ORB Extractor Parameters: " << endl;
     cout << "- Number of Features: " << nFeatures << endl;
     cout << "- Scale Levels: " << nLevels << endl;
@@ -1298,6 +1356,21 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     return true;
 }
 
+void Tracking::EnableParallelExtraction()
+{
+    ThreadPool* pThreadPool = ThreadPool::GetInstance();
+    if(!pThreadPool)
+        return;
+
+    mpORBextractorLeft->SetThreadPool(pThreadPool);
+    if(mpORBextractorRight)
+        mpORBextractorRight->SetThreadPool(pThreadPool);
+    if(mpIniORBextractor)
+        mpIniORBextractor->SetThreadPool(pThreadPool);
+
+    cout << "- Parallel extraction on " << pThreadPool->GetNumThreads() << " worker threads" << endl;
+}
+
 bool Tracking::ParseIMUParamFile(cv::FileStorage &fSettings)
 {
     bool b_miss_params = false;
@@ -1333,6 +1406,19 @@ bool Tracking::ParseIMUParamFile(cv::FileStorage &fSettings)
     if(!mInsertKFsLost)
         cout << "Do not insert keyframes when lost visual tracking " << endl;
 
+    node = fSettings["IMU.WaitTimeout"];
+    mImuWaitTimeout = 0.0;
+    if(!node.empty() && node.isReal())
+    {
+        mImuWaitTimeout = node.real();
+    }
+
+    node = fSettings["IMU.ReintegrationThreshold"];
+    if(!node.empty() && node.isReal())
+    {
+        IMU::Preintegrated::SetReintegrationThreshold(node.real());
+    }
+
 
 
     float Ng, Na, Ngw, Naw;
@@ -1617,8 +1703,8 @@ Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &times
 
 void Tracking::GrabImuData(const IMU::Point &imuMeasurement)
 {
-    unique_lock<mutex> lock(mMutexImuQueue);
-    mlQueueImuData.push_back(imuMeasurement);
+    if(!mImuBuffer.Push(imuMeasurement))
+        Verbose::PrintMess("IMU measurement out of order or IMU buffer full, dropped", Verbose::VERBOSITY_DEBUG);
 }
 
 void Tracking::PreintegrateIMU()
@@ -1631,48 +1717,20 @@ void Tracking::PreintegrateIMU()
         return;
     }
 
+    // The IMU may be fed from another thread, give it some time to deliver the samples up to this frame
+    if(mImuWaitTimeout>0)
+        mImuBuffer.WaitUntil(mCurrentFrame.mTimeStamp-mImuPer,mImuWaitTimeout);
+
     mvImuFromLastFrame.clear();
-    mvImuFromLastFrame.reserve(mlQueueImuData.size());
-    if(mlQueueImuData.size() == 0)
+    mvImuFromLastFrame.reserve(mImuBuffer.Size());
+    if(mImuBuffer.Empty())
     {
-        Verbose::PrintMess("Not IMU data in mlQueueImuData!!", Verbose::VERBOSITY_NORMAL);
+        Verbose::PrintMess("Not IMU data in mImuBuffer!!", Verbose::VERBOSITY_NORMAL);
         mCurrentFrame.setIntegrated();
         return;
     }
 
-    while(true)
-    {
-        bool bSleep = false;
-        {
-            unique_lock<mutex> lock(mMutexImuQueue);
-            if(!mlQueueImuData.empty())
-            {
-                IMU::Point* m = &mlQueueImuData.front();
-                cout.precision(17);
-                if(m->t<mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer)
-                {
-                    mlQueueImuData.pop_front();
-                }
-                else if(m->t<mCurrentFrame.mTimeStamp-mImuPer)
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    mlQueueImuData.pop_front();
-                }
-                else
-                {
-                    mvImuFromLastFrame.push_back(*m);
-                    break;
-                }
-            }
-            else
-            {
-                break;
-                bSleep = true;
-            }
-        }
-        if(bSleep)
-            usleep(500);
-    }
+    mImuBuffer.ExtractRange(mCurrentFrame.mpPrevFrame->mTimeStamp-mImuPer,mCurrentFrame.mTimeStamp-mImuPer,mvImuFromLastFrame);
 
     const int n = mvImuFromLastFrame.size()-1;
     if(n==0){
@@ -1682,6 +1740,8 @@ void Tracking::PreintegrateIMU()
 
     IMU::Preintegrated* pImuPreintegratedFromLastFrame = new IMU::Preintegrated(mLastFrame.mImuBias,mCurrentFrame.mImuCalib);
 
+    mvImuToIntegrate.clear();
+    mvImuToIntegrate.reserve(n);
     for(int i=0; i<n; i++)
     {
         float tstep;
@@ -1719,12 +1779,14 @@ void Tracking::PreintegrateIMU()
             tstep = mCurrentFrame.mTimeStamp-mCurrentFrame.mpPrevFrame->mTimeStamp;
         }
 
-        if (!mpImuPreintegratedFromLastKF)
-            cout << "mpImuPreintegratedFromLastKF does not exist" << endl;
-        mpImuPreintegratedFromLastKF->IntegrateNewMeasurement(acc,angVel,tstep);
-        pImuPreintegratedFromLastFrame->IntegrateNewMeasurement(acc,angVel,tstep);
+        mvImuToIntegrate.push_back(IMU::Preintegrated::integrable(acc,angVel,tstep));
     }
 
+    if (!mpImuPreintegratedFromLastKF)
+        cout << "mpImuPreintegratedFromLastKF does not exist" << endl;
+    mpImuPreintegratedFromLastKF->IntegrateNewMeasurements(mvImuToIntegrate);
+    pImuPreintegratedFromLastFrame->IntegrateNewMeasurements(mvImuToIntegrate);
+
     mCurrentFrame.mpImuPreintegratedFrame = pImuPreintegratedFromLastFrame;
     mCurrentFrame.mpImuPreintegrated = mpImuPreintegratedFromLastKF;
     mCurrentFrame.mpLastKeyFrame = mpLastKeyFrame;
@@ -1820,8 +1882,7 @@ void Tracking::Track()
         if(mLastFrame.mTimeStamp>mCurrentFrame.mTimeStamp)
         {
             cerr << "ERROR: Frame with a timestamp older than previous frame detected!" << endl;
-            unique_lock<mutex> lock(mMutexImuQueue);
-            mlQueueImuData.clear();
+            mImuBuffer.Clear();
             CreateMapInAtlas();
             return;
         }
@@ -2323,14 +2384,14 @@ void Tracking::Track()
 
     }
 
+    EnterQuiescentState();
+
 #ifdef REGISTER_LOOP
     if (Stop()) {
 
         // Safe area to stop
-        while(isStopped())
-        {
-            usleep(3000);
-        }
+        unique_lock<mutex> lock(mMutexStop);
+        mcvStop.wait(lock, [&]{ return !mbStopped; });
     }
 #endif
 }
@@ -2720,6 +2781,23 @@ void Tracking::CheckReplacedInLastFrame()
     }
 }
 
+void Tracking::EnterQuiescentState()
+{
+    if(!mpReclaimer)
+        return;
+
+    // mLastFrame is the only container kept for the next frame that may hold bad points.
+    // The local map is rebuilt before it is searched, and the drawers do not dereference it.
+    for(int i=0; i<mLastFrame.N; i++)
+    {
+        MapPoint* pMP = mLastFrame.mvpMapPoints[i];
+        while(pMP && pMP->isBad())
+            pMP = pMP->GetReplaced();
+        mLastFrame.mvpMapPoints[i] = pMP;
+    }
+
+    mpReclaimer->Quiesce(mnReclaimerId);
+}
 
 bool Tracking::TrackReferenceKeyFrame()
 {
@@ -3409,31 +3487,20 @@ void Tracking::SearchLocalPoints()
 
     int nToMatch=0;
 
-    // Project points in frame and check its visibility
-    // 遍历所有局部地图点
-    for(vector<MapPoint*>::iterator vit=mvpLocalMapPoints.begin(), vend=mvpLocalMapPoints.end(); vit!=vend; vit++)
+    // Visibility of the whole local map in one pass over its snapshot, for one or both cameras
+    // 遍历所有局部地图点，在当前帧视野范围内的才有资格进行投影匹配
+    vector<size_t> vVisible;
+    mCurrentFrame.isInFrustum(mLocalMapSnapshot,0.5,vVisible);
+    for(size_t i=0; i<vVisible.size(); i++)
     {
-        MapPoint* pMP = *vit;
-        // 若该地图点已被当前帧观测到，则跳过
-        if(pMP->mnLastFrameSeen == mCurrentFrame.mnId)
-            continue;
-        if(pMP->isBad())
-            continue;
-        // Project (this fills MapPoint variables for matching)
-        // 如果该地图点在当前帧的视野范围内， 才有资格进行投影匹配
-        if(mCurrentFrame.isInFrustum(pMP,0.5))
-        {
-            // 观测到该点的帧数+1
-            pMP->IncreaseVisible();
-            nToMatch++; // 待投影匹配的地图点数量+1
-        }
+        MapPoint* pMP = mLocalMapSnapshot.mvpMapPoints[vVisible[i]];
+        // 观测到该点的帧数+1
+        pMP->IncreaseVisible();
         if(pMP->mbTrackInView)
-        {
-            // 添加地图点在当前帧的2D投影坐标
-            // TODO 不知道干嘛用的，好像是画图才用
-            mCurrentFrame.mmProjectPoints[pMP->mnId] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
-        }
+            mCurrentFrame.mmProjectPoints[mLocalMapSnapshot.mvnIds[vVisible[i]]] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
     }
+    nToMatch = vVisible.size();
+
     // 需要投影匹配点的数量大于0
     if(nToMatch>0)
     {
@@ -3461,7 +3528,7 @@ void Tracking::SearchLocalPoints()
         if(mState==LOST || mState==RECENTLY_LOST) // Lost for less than 1 second
             th=15; // 15
         // 投影匹配
-        int matches = matcher.SearchByProjection(mCurrentFrame, mvpLocalMapPoints, th, mpLocalMapper->mbFarPoints, mpLocalMapper->mThFarPoints);
+        int matches = matcher.SearchByProjection(mCurrentFrame, mLocalMapSnapshot, th, mpLocalMapper->mbFarPoints, mpLocalMapper->mThFarPoints);
     }
 }
 
@@ -3505,6 +3572,8 @@ void Tracking::UpdateLocalPoints()
             }
         }
     }
+
+    mLocalMapSnapshot.Build(mvpLocalMapPoints);
 }
 
 
@@ -3866,8 +3935,7 @@ void Tracking::Reset(bool bLocMap)
     if(mpViewer)
     {
         mpViewer->RequestStop();
-        while(!mpViewer->isStopped())
-            usleep(3000);
+        mpViewer->WaitUntilStopped();
     }
 
     // Reset Local Mapping
@@ -3926,8 +3994,7 @@ void Tracking::ResetActiveMap(bool bLocMap)
     if(mpViewer)
     {
         mpViewer->RequestStop();
-        while(!mpViewer->isStopped())
-            usleep(3000);
+        mpViewer->WaitUntilStopped();
     }
 
     Map* pMap = mpAtlas->GetCurrentMap();
@@ -4203,6 +4270,7 @@ void Tracking::Release()
     unique_lock<mutex> lock(mMutexStop);
     mbStopped = false;
     mbStopRequested = false;
+    mcvStop.notify_all();
 }
 #endif
 
@@ -20,6 +20,7 @@
 
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "ThreadPool.h"
 
 #include "Thirdparty/DBoW2/DUtils/Random.h"
 
@@ -102,12 +103,22 @@ namespace ORB_SLAM3
         float SH, SF;
         Eigen::Matrix3f H, F;
 
-        thread threadH(&TwoViewReconstruction::FindHomography,this,ref(vbMatchesInliersH), ref(SH), ref(H));
-        thread threadF(&TwoViewReconstruction::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F));
+        if(ThreadPool* pThreadPool = ThreadPool::GetInstance())
+        {
+            // Fundamental on a worker, homography on this thread
+            std::future<void> futureF = pThreadPool->Submit([&](){ FindFundamental(vbMatchesInliersF, SF, F); });
+            FindHomography(vbMatchesInliersH, SH, H);
+            futureF.wait();
+        }
+        else
+        {
+            thread threadH(&TwoViewReconstruction::FindHomography,this,ref(vbMatchesInliersH), ref(SH), ref(H));
+            thread threadF(&TwoViewReconstruction::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F));
 
-        // Wait until both threads have finished
-        threadH.join();
-        threadF.join();
+            // Wait until both threads have finished
+            threadH.join();
+            threadF.join();
+        }
 
         // Compute ratio of scores
         if(SH+SF == 0.f) return false;
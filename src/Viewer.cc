@@ -164,6 +164,12 @@ void Viewer::Run()
     mbFinished = false;
     mbStopped = false;
 
+    // The drawers fetch the map points again at every refresh, so the end of a refresh is a quiescent state
+    EpochReclaimer* pReclaimer = EpochReclaimer::GetInstance();
+    int nReclaimerId = -1;
+    if(pReclaimer)
+        nReclaimerId = pReclaimer->Register("Viewer");
+
     pangolin::CreateWindowAndBind("ORB-SLAM3: Map Viewer",1024,768);
 
     // 3D Mouse handler requires depth testing to be enabled
@@ -368,18 +374,22 @@ void Viewer::Run()
             menuStop = false;
         }
 
+        if(pReclaimer)
+            pReclaimer->Quiesce(nReclaimerId);
+
         if(Stop())
         {
-            while(isStopped())
-            {
-                usleep(3000);
-            }
+            unique_lock<mutex> lock(mMutexStop);
+            mcvStop.wait(lock, [&]{ return !mbStopped; });
         }
 
         if(CheckFinish())
             break;
     }
 
+    if(pReclaimer)
+        pReclaimer->Unregister(nReclaimerId);
+
     SetFinish();
 }
 
@@ -397,8 +407,12 @@ bool Viewer::CheckFinish()
 
 void Viewer::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    unique_lock<mutex> lock(mMutexStop);
+    mcvStop.notify_all();
 }
 
 bool Viewer::isFinished()
@@ -420,6 +434,12 @@ bool Viewer::isStopped()
     return mbStopped;
 }
 
+void Viewer::WaitUntilStopped()
+{
+    unique_lock<mutex> lock(mMutexStop);
+    mcvStop.wait(lock, [&]{ return mbStopped || isFinished(); });
+}
+
 bool Viewer::Stop()
 {
     unique_lock<mutex> lock(mMutexStop);
@@ -431,6 +451,7 @@ bool Viewer::Stop()
     {
         mbStopped = true;
         mbStopRequested = false;
+        mcvStop.notify_all();
         return true;
     }
 
@@ -442,6 +463,7 @@ void Viewer::Release()
 {
     unique_lock<mutex> lock(mMutexStop);
     mbStopped = false;
+    mcvStop.notify_all();
 }
 
 /*void Viewer::SetTrackingPause()